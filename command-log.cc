@@ -0,0 +1,312 @@
+#include "command-log.h"
+#include <algorithm>
+#include "note.h"
+#include "project.h"
+
+void Command::Do(vector<Task*>* changed) {
+  DoCommand(changed);
+  done_ = true;
+}
+
+void Command::Undo(vector<Task*>* changed) {
+  UndoCommand(changed);
+  done_ = false;
+}
+
+AddTaskCommand::AddTaskCommand(Project* project, Task* parent,
+                               const string& title)
+    : project_(project), parent_(parent), task_(new Task(title, "")) {
+  index_ = parent == NULL ? project->NumRootTasks() : parent->NumChildren();
+}
+
+AddTaskCommand::AddTaskCommand(Project* project, Task* parent, int index,
+                               Task* task)
+    : project_(project), parent_(parent), task_(task), index_(index) {}
+
+AddTaskCommand::~AddTaskCommand() {
+  // Once undone, the task belongs to us rather than to the project.
+  if (!Done()) {
+    delete task_;
+  }
+}
+
+size_t AddTaskCommand::MemoryUsage() {
+  return sizeof(*this) + (Done() ? 0 : task_->MemoryUsage());
+}
+
+void AddTaskCommand::DoCommand(vector<Task*>* changed) {
+  changed->push_back(project_->AttachTask(task_, parent_, index_));
+}
+
+void AddTaskCommand::UndoCommand(vector<Task*>* changed) {
+  changed->push_back(project_->DetachTask(task_, &parent_, &index_));
+}
+
+DeleteTaskCommand::DeleteTaskCommand(Project* project, Task* task)
+    : project_(project),
+      task_(task),
+      parent_(NULL),
+      index_(0),
+      memory_usage_(0) {}
+
+DeleteTaskCommand::~DeleteTaskCommand() {
+  if (Done()) {
+    delete task_;
+  }
+}
+
+size_t DeleteTaskCommand::MemoryUsage() {
+  return sizeof(*this) + (Done() ? memory_usage_ : 0);
+}
+
+void DeleteTaskCommand::DoCommand(vector<Task*>* changed) {
+  changed->push_back(project_->DetachTask(task_, &parent_, &index_));
+  memory_usage_ = task_->MemoryUsage();
+}
+
+void DeleteTaskCommand::UndoCommand(vector<Task*>* changed) {
+  changed->push_back(project_->AttachTask(task_, parent_, index_));
+}
+
+MoveTaskCommand::MoveTaskCommand(Project* project, Task* task, Task* parent,
+                                 int index)
+    : project_(project),
+      task_(task),
+      from_parent_(NULL),
+      from_index_(0),
+      to_parent_(parent),
+      to_index_(index) {}
+
+void MoveTaskCommand::DoCommand(vector<Task*>* changed) {
+  project_->MoveTask(task_, to_parent_, to_index_, &from_parent_, &from_index_,
+                     changed);
+}
+
+void MoveTaskCommand::UndoCommand(vector<Task*>* changed) {
+  project_->MoveTask(task_, from_parent_, from_index_, &to_parent_, &to_index_,
+                     changed);
+}
+
+SetStatusCommand::SetStatusCommand(Project* project, Task* task,
+                                   TaskStatus status)
+    : project_(project), task_(task), status_(status) {}
+
+void SetStatusCommand::DoCommand(vector<Task*>* changed) {
+  old_state_ = task_->SaveStatusState();
+  task_->SetStatus(status_);
+  changed->push_back(project_->TaskEdited(task_));
+}
+
+void SetStatusCommand::UndoCommand(vector<Task*>* changed) {
+  task_->RestoreStatusState(old_state_);
+  changed->push_back(project_->TaskEdited(task_));
+}
+
+SetTextCommand::SetTextCommand(Project* project, Task* task,
+                               const string& text)
+    : project_(project), task_(task), text_(text) {}
+
+size_t SetTextCommand::MemoryUsage() {
+  return sizeof(*this) + text_.capacity() + old_text_.capacity();
+}
+
+void SetTextCommand::DoCommand(vector<Task*>* changed) {
+  old_text_ = task_->Title();
+  task_->SetListText(text_);
+  changed->push_back(project_->TaskEdited(task_));
+}
+
+void SetTextCommand::UndoCommand(vector<Task*>* changed) {
+  task_->SetListText(old_text_);
+  changed->push_back(project_->TaskEdited(task_));
+}
+
+AddNoteCommand::AddNoteCommand(Project* project, Task* task,
+                               const string& text)
+    : project_(project), task_(task), text_(text), note_(NULL) {}
+
+AddNoteCommand::~AddNoteCommand() {
+  if (!Done()) {
+    delete note_;
+  }
+}
+
+size_t AddNoteCommand::MemoryUsage() {
+  return sizeof(*this) + sizeof(Note) + 2 * text_.capacity();
+}
+
+void AddNoteCommand::DoCommand(vector<Task*>* changed) {
+  if (note_ == NULL) {
+    task_->AddNote(text_);
+  } else {
+    // Put back the very note we took out, so it keeps its date.
+    task_->AttachNote(task_->NumNotes(), note_);
+  }
+  changed->push_back(project_->TaskEdited(task_));
+}
+
+void AddNoteCommand::UndoCommand(vector<Task*>* changed) {
+  note_ = task_->DetachNote(task_->NumNotes() - 1);
+  changed->push_back(project_->TaskEdited(task_));
+}
+
+DeleteNoteCommand::DeleteNoteCommand(Project* project, Task* task,
+                                     const string& text)
+    : project_(project), task_(task), text_(text), note_(NULL), index_(-1) {}
+
+DeleteNoteCommand::~DeleteNoteCommand() {
+  if (Done()) {
+    delete note_;
+  }
+}
+
+size_t DeleteNoteCommand::MemoryUsage() {
+  return sizeof(*this) + sizeof(Note) + 2 * text_.capacity();
+}
+
+void DeleteNoteCommand::DoCommand(vector<Task*>* changed) {
+  index_ = task_->FindNote(text_);
+  if (index_ >= 0) {
+    note_ = task_->DetachNote(index_);
+    changed->push_back(project_->TaskEdited(task_));
+  }
+}
+
+void DeleteNoteCommand::UndoCommand(vector<Task*>* changed) {
+  if (index_ >= 0) {
+    task_->AttachNote(index_, note_);
+    note_ = NULL;
+    changed->push_back(project_->TaskEdited(task_));
+  }
+}
+
+CompoundCommand::~CompoundCommand() {
+  for (int i = 0; i < commands_.size(); ++i) {
+    delete commands_[i];
+  }
+}
+
+size_t CompoundCommand::MemoryUsage() {
+  size_t usage = sizeof(*this);
+  for (int i = 0; i < commands_.size(); ++i) {
+    usage += commands_[i]->MemoryUsage();
+  }
+  return usage;
+}
+
+void CompoundCommand::DoCommand(vector<Task*>* changed) {
+  for (int i = 0; i < commands_.size(); ++i) {
+    commands_[i]->Do(changed);
+  }
+}
+
+void CompoundCommand::UndoCommand(vector<Task*>* changed) {
+  for (int i = commands_.size() - 1; i >= 0; --i) {
+    commands_[i]->Undo(changed);
+  }
+}
+
+void BatchCommand::AddProject(Project* project) {
+  if (find(projects_.begin(), projects_.end(), project) == projects_.end()) {
+    projects_.push_back(project);
+  }
+}
+
+// The commands only report changes once the projects end their batches.
+void BatchCommand::DoCommand(vector<Task*>* changed) {
+  vector<Task*> ignored;
+  BeginBatches();
+  CompoundCommand::DoCommand(&ignored);
+  EndBatches(changed);
+}
+
+void BatchCommand::UndoCommand(vector<Task*>* changed) {
+  vector<Task*> ignored;
+  BeginBatches();
+  CompoundCommand::UndoCommand(&ignored);
+  EndBatches(changed);
+}
+
+void BatchCommand::BeginBatches() {
+  for (int i = 0; i < projects_.size(); ++i) {
+    projects_[i]->BeginBatch();
+  }
+}
+
+void BatchCommand::EndBatches(vector<Task*>* changed) {
+  for (int i = 0; i < projects_.size(); ++i) {
+    projects_[i]->EndBatch(changed);
+  }
+}
+
+CommandLog::CommandLog(size_t memory_budget)
+    : memory_usage_(0), memory_budget_(memory_budget) {}
+
+CommandLog::~CommandLog() { Clear(); }
+
+void CommandLog::Execute(Command* c, vector<Task*>* changed) {
+  ClearRedo();
+  c->Do(changed);
+  done_.push_back(c);
+  memory_usage_ += c->MemoryUsage();
+  EnforceBudget();
+}
+
+void CommandLog::Undo(vector<Task*>* changed) {
+  if (!CanUndo()) {
+    return;
+  }
+  Command* c = done_.back();
+  done_.pop_back();
+  // What a command holds on to only changes as it's done and undone, so
+  // that's when the total has to take it into account again.
+  memory_usage_ -= c->MemoryUsage();
+  c->Undo(changed);
+  memory_usage_ += c->MemoryUsage();
+  undone_.push_back(c);
+  EnforceBudget();
+}
+
+void CommandLog::Redo(vector<Task*>* changed) {
+  if (!CanRedo()) {
+    return;
+  }
+  Command* c = undone_.back();
+  undone_.pop_back();
+  memory_usage_ -= c->MemoryUsage();
+  c->Do(changed);
+  memory_usage_ += c->MemoryUsage();
+  done_.push_back(c);
+  EnforceBudget();
+}
+
+void CommandLog::Clear() {
+  ClearRedo();
+  for (int i = 0; i < done_.size(); ++i) {
+    delete done_[i];
+  }
+  done_.clear();
+  memory_usage_ = 0;
+}
+
+void CommandLog::ClearRedo() {
+  for (int i = 0; i < undone_.size(); ++i) {
+    memory_usage_ -= undone_[i]->MemoryUsage();
+    delete undone_[i];
+  }
+  undone_.clear();
+}
+
+void CommandLog::EnforceBudget() {
+  // Redoing is the first thing to go, then the oldest undo.
+  while (memory_usage_ > memory_budget_ && !undone_.empty()) {
+    memory_usage_ -= undone_.front()->MemoryUsage();
+    delete undone_.front();
+    undone_.erase(undone_.begin());
+  }
+  while (memory_usage_ > memory_budget_ && done_.size() > 1) {
+    memory_usage_ -= done_.front()->MemoryUsage();
+    delete done_.front();
+    done_.pop_front();
+  }
+}
@@ -0,0 +1,253 @@
+#ifndef COMMAND_LOG_H_
+#define COMMAND_LOG_H_
+
+// Reversible editing commands and the undo/redo log that records them.  All
+// edits the user makes go through a Command so that they can be undone:
+//
+//   vector<Task*> changed;
+//   log->Execute(new SetStatusCommand(project, task, COMPLETED), &changed);
+//   ...
+//   log->Undo(&changed);
+//   for (int i = 0; i < changed.size(); ++i) list->UpdateItem(changed[i]);
+//
+// Commands keep node statuses and filter results up to date themselves, only
+// looking at the tasks involved and their ancestors, and report the tasks whose
+// lines in a HierarchicalList need updating.  A NULL among them means the whole
+// list needs updating.  Deleted tasks are detached from
+// the tree and held by the command rather than copied, and are only freed once
+// the command falls out of the log.
+
+#include <deque>
+#include <string>
+#include <vector>
+#include "task.h"
+
+using std::deque;
+using std::string;
+using std::vector;
+
+class Note;
+class Project;
+
+class Command {
+ public:
+  Command() : done_(false) {}
+  virtual ~Command() {}
+
+  // Both append the tasks whose lines in a list need updating to |changed|.
+  void Do(vector<Task*>* changed);
+  void Undo(vector<Task*>* changed);
+  bool Done() { return done_; }
+
+  // Roughly how many bytes of memory this command keeps alive.
+  virtual size_t MemoryUsage() { return sizeof(*this); }
+
+ protected:
+  virtual void DoCommand(vector<Task*>* changed) = 0;
+  virtual void UndoCommand(vector<Task*>* changed) = 0;
+
+ private:
+  bool done_;
+};
+
+// Adds a new task named |title| at the end of |parent|'s subtasks, or as a new
+// root task if parent is NULL.  The second form adds |task|, which may have
+// offspring of its own, at position |index| and takes ownership of it.
+class AddTaskCommand : public Command {
+ public:
+  AddTaskCommand(Project* project, Task* parent, const string& title);
+  AddTaskCommand(Project* project, Task* parent, int index, Task* task);
+  virtual ~AddTaskCommand();
+  virtual size_t MemoryUsage();
+  Task* AddedTask() { return task_; }
+
+ protected:
+  virtual void DoCommand(vector<Task*>* changed);
+  virtual void UndoCommand(vector<Task*>* changed);
+
+ private:
+  Project* project_;
+  Task* parent_;
+  Task* task_;
+  int index_;
+};
+
+class DeleteTaskCommand : public Command {
+ public:
+  DeleteTaskCommand(Project* project, Task* task);
+  virtual ~DeleteTaskCommand();
+  virtual size_t MemoryUsage();
+
+ protected:
+  virtual void DoCommand(vector<Task*>* changed);
+  virtual void UndoCommand(vector<Task*>* changed);
+
+ private:
+  Project* project_;
+  Task* task_;
+  Task* parent_;
+  int index_;
+  size_t memory_usage_;
+};
+
+// Moves a task and all of its offspring to position |index| among the subtasks
+// of |parent| (or the root tasks, if parent is NULL).  The index is counted
+// after the task has been taken out of its current spot.
+class MoveTaskCommand : public Command {
+ public:
+  MoveTaskCommand(Project* project, Task* task, Task* parent, int index);
+
+ protected:
+  virtual void DoCommand(vector<Task*>* changed);
+  virtual void UndoCommand(vector<Task*>* changed);
+
+ private:
+  Project* project_;
+  Task* task_;
+  Task* from_parent_;
+  int from_index_;
+  Task* to_parent_;
+  int to_index_;
+};
+
+class SetStatusCommand : public Command {
+ public:
+  SetStatusCommand(Project* project, Task* task, TaskStatus status);
+
+ protected:
+  virtual void DoCommand(vector<Task*>* changed);
+  virtual void UndoCommand(vector<Task*>* changed);
+
+ private:
+  Project* project_;
+  Task* task_;
+  TaskStatus status_;
+  Task::StatusState old_state_;
+};
+
+class SetTextCommand : public Command {
+ public:
+  SetTextCommand(Project* project, Task* task, const string& text);
+  virtual size_t MemoryUsage();
+
+ protected:
+  virtual void DoCommand(vector<Task*>* changed);
+  virtual void UndoCommand(vector<Task*>* changed);
+
+ private:
+  Project* project_;
+  Task* task_;
+  string text_;
+  string old_text_;
+};
+
+class AddNoteCommand : public Command {
+ public:
+  AddNoteCommand(Project* project, Task* task, const string& text);
+  virtual ~AddNoteCommand();
+  virtual size_t MemoryUsage();
+
+ protected:
+  virtual void DoCommand(vector<Task*>* changed);
+  virtual void UndoCommand(vector<Task*>* changed);
+
+ private:
+  Project* project_;
+  Task* task_;
+  string text_;
+  Note* note_;
+};
+
+class DeleteNoteCommand : public Command {
+ public:
+  DeleteNoteCommand(Project* project, Task* task, const string& text);
+  virtual ~DeleteNoteCommand();
+  virtual size_t MemoryUsage();
+
+ protected:
+  virtual void DoCommand(vector<Task*>* changed);
+  virtual void UndoCommand(vector<Task*>* changed);
+
+ private:
+  Project* project_;
+  Task* task_;
+  string text_;
+  Note* note_;
+  int index_;
+};
+
+// Runs several commands as one.  They are undone in reverse order.
+class CompoundCommand : public Command {
+ public:
+  CompoundCommand() {}
+  virtual ~CompoundCommand();
+  virtual size_t MemoryUsage();
+
+  // Takes ownership of c.
+  void AddCommand(Command* c) { commands_.push_back(c); }
+  bool Empty() { return commands_.empty(); }
+
+ protected:
+  virtual void DoCommand(vector<Task*>* changed);
+  virtual void UndoCommand(vector<Task*>* changed);
+
+ private:
+  vector<Command*> commands_;
+};
+
+// Runs several commands as one Project batch, so statuses and filter results
+// are brought up to date once at the end rather than after every command, and
+// the list is updated once as a whole.  Commands on other projects' tasks can
+// be added too, as long as those projects are added as well.
+class BatchCommand : public CompoundCommand {
+ public:
+  explicit BatchCommand(Project* project) { AddProject(project); }
+
+  void AddProject(Project* project);
+
+ protected:
+  virtual void DoCommand(vector<Task*>* changed);
+  virtual void UndoCommand(vector<Task*>* changed);
+
+ private:
+  void BeginBatches();
+  void EndBatches(vector<Task*>* changed);
+
+  vector<Project*> projects_;
+};
+
+class CommandLog {
+ public:
+  // The log drops its oldest commands once they keep more than memory_budget
+  // bytes alive.  The most recent command is always kept so the last edit can
+  // be undone.
+  explicit CommandLog(size_t memory_budget);
+  ~CommandLog();
+
+  // Runs c and records it for undoing.  Takes ownership of c, and forgets
+  // anything that could have been redone.
+  void Execute(Command* c, vector<Task*>* changed);
+
+  bool CanUndo() { return !done_.empty(); }
+  bool CanRedo() { return !undone_.empty(); }
+  void Undo(vector<Task*>* changed);
+  void Redo(vector<Task*>* changed);
+
+  // Forgets every command.  Needed whenever the project they refer to goes
+  // away.
+  void Clear();
+
+  size_t MemoryUsage() { return memory_usage_; }
+
+ private:
+  void ClearRedo();
+  void EnforceBudget();
+
+  deque<Command*> done_;
+  vector<Command*> undone_;
+  // What every command in done_ and undone_ keeps alive, in all.
+  size_t memory_usage_;
+  size_t memory_budget_;
+};
+
+#endif  // COMMAND_LOG_H_
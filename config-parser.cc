@@ -1,19 +1,15 @@
 #include "config-parser.h"
-#include <assert.h>
 #include <fstream>
 #include <iostream>
 
-// Returns a new string that has all padding whitespace removed.
+// Returns a new string that has all padding whitespace removed.  Single
+// letters are kept too, since view names and queries can be that short.
 static string StripWhiteSpace(const string& s) {
-  size_t start_pos = 0;
-  size_t end_pos = s.length() - 1;
-  while (s[start_pos] == ' ' && start_pos < s.length()) {
-    ++start_pos;
+  size_t start_pos = s.find_first_not_of(' ');
+  if (start_pos == string::npos) {
+    return "";
   }
-  while (s[end_pos] == ' ' && end_pos >= 0) {
-    --end_pos;
-  }
-  assert(start_pos < end_pos);
+  size_t end_pos = s.find_last_not_of(' ');
   return s.substr(start_pos, end_pos - start_pos + 1);
 }
 
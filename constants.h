@@ -8,6 +8,50 @@ class Constants {
 
   // How large to draw the notes view.
   static const int kNoteViewSize = 40;
+
+  // The most places a task can be moved with one keystroke.
+  static const int kMaxMoveCount = 100000;
+
+  // The most tasks offered to choose from when jumping by title.
+  static const int kMaxJumpChoices = 20;
+
+  // Projects with fewer tasks than this are filtered on a single thread.
+  static const int kMinTasksToFilterInParallel = 20000;
+
+  // How many sibling tasks (with their offspring) are filtered as one piece of
+  // work when filtering in parallel.  Tasks with more subtasks than this have
+  // them split up in turn.
+  static const int kFilterChunkSize = 256;
+
+  // How many tasks are fuzzy matched as one piece of work.
+  static const int kFuzzyFindChunkSize = 4096;
+
+  // The most tasks a fuzzy find offers to choose from.
+  static const int kMaxFuzzyFindChoices = 20;
+
+  // A search or query that matches more than one in this many of a project's
+  // tasks refilters all of them, rather than only showing the matches.
+  static const int kTasksPerSearchMatchToShowMatches = 16;
+
+  // How many of a project's tasks a query is tried on to plan which of its
+  // tests to run first.
+  static const int kQueryPlanSampleSize = 256;
+
+  // A query only looks text up in the search index if fewer than one in this
+  // many tasks can have it.  Otherwise scanning every task is quicker.
+  static const int kTasksPerIndexedQueryMatch = 8;
+
+  // Projects keep a table of their tasks by id, so a file with ids past this
+  // is taken to be broken and its tasks are numbered again.
+  static const int kMaxTaskId = 1 << 24;
+
+  // Roughly how many bytes of filtered lists a project keeps for the views
+  // left since it last changed, so that going back to one is instant.
+  static const int kMaxSavedViewBytes = 32 << 20;
+
+  // Queries count times ago from the start of the minute, so that a query's
+  // view can be saved and shown again for the rest of it.
+  static const int kQueryTimeResolution = 60;
 };
 
 #endif  // CONSTANTS_H_
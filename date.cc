@@ -23,7 +23,7 @@ string Date::ToString() {
   return string(buf);
 }
 
-void Date::Serialize(Serializer* s) {
+void Date::Serialize(Serializer* s) const {
   s->WriteInt32(static_cast<int32>(time_));
 }
 
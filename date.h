@@ -15,9 +15,9 @@ class Date {
 
   void SetToNow();
   void SetToEmptyTime();
-  time_t Time() { return time_; }
+  time_t Time() const { return time_; }
 
-  void Serialize(Serializer* s);
+  void Serialize(Serializer* s) const;
   void ReadFromSerializer(Serializer* s);
 
   string ToString();
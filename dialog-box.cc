@@ -4,8 +4,24 @@
 #include <ncurses.h>
 #include "utils.h"
 
+// The text in field, without the spaces the field pads it with.
+static string FieldText(FORM* form, FIELD* field) {
+  // Without calling this the output doesn't actually get put in the buffer.
+  form_driver(form, REQ_VALIDATION);
+
+  // Get whatever they wrote:
+  string answer(field_buffer(field, 0));
+
+  // trim trailing whitespace
+  int notwhite = answer.find_last_not_of(" \t\n");
+  answer.erase(notwhite + 1);
+  StrUtils::trim_multiple_spaces(answer);
+  return answer;
+}
+
 string DialogBox::RunMultiLine(const string& title, const string& default_text,
-                               int width, int height) {
+                               int width, int height,
+                               const EditCallback& on_edit) {
   // Create the text field
   FIELD* field = new_field(height, width, 0, 0, 0, 0);
 
@@ -72,8 +88,23 @@ string DialogBox::RunMultiLine(const string& title, const string& default_text,
 
   bool done = false;
   bool hit_escape = false;
+  // Whether the text changed since on_edit was last called, and whether it
+  // ever has been.
+  bool edited = false;
+  bool called_on_edit = false;
   while (!done) {
+    // Waits for a key only once on_edit has seen the text.
+    wtimeout(form_win, edited ? 0 : -1);
     int ch = wgetch(form_win);
+    if (ch == ERR && edited) {
+      on_edit(FieldText(form, field));
+      edited = false;
+      called_on_edit = true;
+      // on_edit will have drawn over the dialog.
+      touchwin(form_win);
+      wrefresh(form_win);
+      continue;
+    }
     switch (ch) {
       case 27:  // escape
         hit_escape = true;
@@ -94,6 +125,7 @@ string DialogBox::RunMultiLine(const string& title, const string& default_text,
       case 263:  // delete
       case 127:  // also delete
         form_driver(form, REQ_DEL_PREV);
+        edited = static_cast<bool>(on_edit);
         break;
       case '\r':
         done = true;
@@ -101,19 +133,11 @@ string DialogBox::RunMultiLine(const string& title, const string& default_text,
         break;
       default:
         form_driver(form, ch);
+        edited = static_cast<bool>(on_edit);
     }
   }
 
-  // Without calling this the output doesn't actually get put in the buffer.
-  form_driver(form, REQ_VALIDATION);
-
-  // Get whatever they wrote:
-  string answer(field_buffer(field, 0));
-
-  // trim trailing whitespace
-  int notwhite = answer.find_last_not_of(" \t\n");
-  answer.erase(notwhite + 1);
-  StrUtils::trim_multiple_spaces(answer);
+  string answer = FieldText(form, field);
 
   // Free up our memory
   unpost_form(form);
@@ -126,6 +150,9 @@ string DialogBox::RunMultiLine(const string& title, const string& default_text,
     // Clear out whatever was in the box if they hit escape.
     answer = "";
   }
+  if (hit_escape ? called_on_edit : edited) {
+    on_edit(answer);
+  }
   return answer;
 }
 
@@ -138,3 +165,8 @@ string DialogBox::RunCenteredWithWidth(const string& title,
                                        const int width) {
   return DialogBox::RunMultiLine(title, default_text, width, 1);
 }
+
+string DialogBox::RunCenteredLive(const string& title, const int width,
+                                  const EditCallback& on_edit) {
+  return DialogBox::RunMultiLine(title, "", width, 1, on_edit);
+}
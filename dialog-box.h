@@ -1,20 +1,33 @@
 #ifndef DIALOG_BOX_H_
 #define DIALOG_BOX_H_
 
+#include <functional>
 #include <string>
 
+using std::function;
 using std::string;
 
 class DialogBox {
  public:
+  // Called with the text as it's typed.
+  typedef function<void(const string&)> EditCallback;
+
+  // If on_edit is given, it's called each time the text changes, once no more
+  // keys are waiting, so typing isn't held up by text that's already out of
+  // date.  It has been called with the final text by the time this returns,
+  // or with "" if escape was hit.
   static string RunMultiLine(const string& title, const string& default_text,
-                             int width, int height);
+                             int width, int height,
+                             const EditCallback& on_edit = EditCallback());
 
   static string RunCentered(const string& title, const string& default_text);
 
   static string RunCenteredWithWidth(const string& title,
                                      const string& default_text,
                                      const int width);
+
+  static string RunCenteredLive(const string& title, const int width,
+                                const EditCallback& on_edit);
 };
 
 #endif  // DIALOG_BOX_H_
@@ -1,8 +1,11 @@
 #include "doneyet-config.h"
 #include <ncurses.h>
+#include <limits.h>
+#include <stdlib.h>
 #include <cctype>
 #include "config-parser.h"
 #include "file-manager.h"
+#include "task-query.h"
 
 static const short kColorError = -2;
 
@@ -10,6 +13,7 @@ static const char* kGeneralSection = "GENERAL";
 static const char* kForegroundColor = "foreground_color";
 static const char* kBackgroundColor = "background_color";
 static const char* kHeaderTextColor = "header_text_color";
+static const char* kUndoMemoryKb = "undo_memory_kb";
 
 static const char* kTasksSection = "TASKS";
 static const char* kUnstartedTaskColor = "unstarted_color";
@@ -30,6 +34,8 @@ static const char* kSelectedMenuItemForegroundColor =
 static const char* kSelectedMenuItemBackgroundColor =
     "selected_item_background_color";
 
+static const char* kViewsSection = "VIEWS";
+
 bool DoneyetConfig::Parse() {
   FileManager* file_manager = FileManager::DefaultFileManager();
 
@@ -38,6 +44,7 @@ bool DoneyetConfig::Parse() {
   general[kForegroundColor] = "white";
   general[kBackgroundColor] = "black";
   general[kHeaderTextColor] = "red";
+  general[kUndoMemoryKb] = "16384";
 
   map<string, string>& tasks = config_[kTasksSection];
   tasks[kUnstartedTaskColor] = "terminal";
@@ -58,8 +65,13 @@ bool DoneyetConfig::Parse() {
       !ConfigParser::ParseConfig(file_manager->ConfigFilePath(), &config_)) {
     return false;
   }
+  if (file_manager->FileExists(file_manager->ViewsFilePath()) &&
+      !ConfigParser::ParseConfig(file_manager->ViewsFilePath(), &config_)) {
+    return false;
+  }
 
-  return ParseGeneralOptions() && ParseTaskOptions() && ParseMenuOptions();
+  return ParseGeneralOptions() && ParseTaskOptions() && ParseMenuOptions() &&
+         ParseViewOptions();
 }
 
 short DoneyetConfig::ForegroundColor() { return foreground_color_; }
@@ -68,6 +80,10 @@ short DoneyetConfig::BackgroundColor() { return background_color_; }
 
 short DoneyetConfig::HeaderTextColor() { return header_text_color_; }
 
+size_t DoneyetConfig::UndoMemoryBudget() {
+  return static_cast<size_t>(undo_memory_kb_) * 1024;
+}
+
 short DoneyetConfig::UnstartedTaskColor() { return unstarted_task_color_; }
 
 short DoneyetConfig::InProgressTaskColor() { return in_progress_task_color_; }
@@ -102,6 +118,10 @@ short DoneyetConfig::SelectedMenuBackgroundColor() {
   return selected_menu_background_color_;
 }
 
+const map<string, string>& DoneyetConfig::Views() {
+  return config_[kViewsSection];
+}
+
 static short ColorForString(string s) {
   // First lowercase.
   for (int i = 0; i < s.length(); ++i) {
@@ -158,13 +178,29 @@ bool DoneyetConfig::ParseBool(map<string, string>& config,
   return true;
 }
 
+bool DoneyetConfig::ParseInt(map<string, string>& config,
+                             const string& to_parse, int* value) {
+  const string& param = config[to_parse];
+  char* end = NULL;
+  long parsed = strtol(param.c_str(), &end, 10);
+  if (param.empty() || *end != '\0' || parsed < 0 || parsed > INT_MAX) {
+    fprintf(stderr, "'%s' is not a valid number for config option %s.\n",
+            param.c_str(), to_parse.c_str());
+    return false;
+  }
+
+  *value = static_cast<int>(parsed);
+  return true;
+}
+
 bool DoneyetConfig::ParseGeneralOptions() {
   // Get the general section.
   map<string, string>& general = config_[kGeneralSection];
 
   return ParseColor(general, kForegroundColor, &foreground_color_) &&
          ParseColor(general, kBackgroundColor, &background_color_) &&
-         ParseColor(general, kHeaderTextColor, &header_text_color_);
+         ParseColor(general, kHeaderTextColor, &header_text_color_) &&
+         ParseInt(general, kUndoMemoryKb, &undo_memory_kb_);
 }
 
 bool DoneyetConfig::ParseTaskOptions() {
@@ -193,3 +229,21 @@ bool DoneyetConfig::ParseMenuOptions() {
          ParseColor(menu, kSelectedMenuItemBackgroundColor,
                     &selected_menu_background_color_);
 }
+
+bool DoneyetConfig::ParseViewOptions() {
+  map<string, string>& views = config_[kViewsSection];
+
+  for (map<string, string>::iterator it = views.begin(); it != views.end();
+       ++it) {
+    string error;
+    FilterPredicate<Task>* parsed = TaskQuery::Parse(
+        it->second, time(NULL), TaskQuery::Indexes(), &error);
+    if (parsed == NULL) {
+      fprintf(stderr, "'%s' is not a valid query for view %s: %s.\n",
+              it->second.c_str(), it->first.c_str(), error.c_str());
+      return false;
+    }
+    delete parsed;
+  }
+  return true;
+}
@@ -6,6 +6,7 @@
 // for example) can be further wrapped before handing off to the rest of the
 // system.
 
+#include <stddef.h>
 #include <map>
 #include <string>
 
@@ -37,6 +38,9 @@ class DoneyetConfig {
   short BackgroundColor();
   short HeaderTextColor();
 
+  // How many bytes the undo log may use to remember edits.
+  size_t UndoMemoryBudget();
+
   // Task related configuration.
   short UnstartedTaskColor();
   short InProgressTaskColor();
@@ -52,6 +56,10 @@ class DoneyetConfig {
   short SelectedMenuForegroundColor();
   short SelectedMenuBackgroundColor();
 
+  // Saved views, as queries by name.  They come from the VIEWS section of the
+  // configuration file and from the file of views saved from the menu.
+  const map<string, string>& Views();
+
  private:
   DoneyetConfig() {}
 
@@ -63,11 +71,14 @@ class DoneyetConfig {
                   short* var_to_set);
   bool ParseBool(map<string, string>& config, const string& to_parse,
                  bool* value);
+  bool ParseInt(map<string, string>& config, const string& to_parse,
+                int* value);
 
   bool ParseGeneralOptions();
   short foreground_color_;
   short background_color_;
   short header_text_color_;
+  int undo_memory_kb_;
   bool prompt_on_delete_task_;
 
   bool ParseTaskOptions();
@@ -76,6 +87,8 @@ class DoneyetConfig {
   short paused_task_color_;
   short finished_task_color_;
 
+  bool ParseViewOptions();
+
   bool ParseMenuOptions();
   short menubar_foreground_color_;
   short menubar_background_color_;
@@ -40,6 +40,13 @@ bool FileManager::Initialize() {
   }
   project_dir_ += "/";
 
+  // And the same for the Templates directory.
+  template_dir_ = data_dir_ + "Templates";
+  if (!CheckDir(template_dir_)) {
+    return false;
+  }
+  template_dir_ += "/";
+
   // See how many projects there are in the project directory
   vector<string> projects;
   if (!DirectoryContents(project_dir_, &projects)) {
@@ -88,6 +95,12 @@ vector<string> FileManager::SavedProjectNames() {
   return projects;
 }
 
+vector<string> FileManager::SavedTemplateNames() {
+  vector<string> templates;
+  DirectoryContents(TemplateDir(), &templates);
+  return templates;
+}
+
 bool FileManager::CheckDir(const string& dir) {
   int edir = mkdir(dir.c_str(), 0755);
   if (edir != 0 && errno != EEXIST) {
@@ -104,3 +117,7 @@ bool FileManager::FileExists(const string& file_path) {
   }
   return true;
 }
+
+bool FileManager::IsPlainFileName(const string& name) {
+  return !name.empty() && name[0] != '.' && name.find('/') == string::npos;
+}
@@ -27,20 +27,35 @@ class FileManager {
   int NumSavedProjects();
   vector<string> SavedProjectNames();
 
+  // Templates are saved like projects, each holding the tasks to copy in.
+  string TemplateDir() { return template_dir_; }
+  vector<string> SavedTemplateNames();
+
   // Return the full path to the configuration file.  Will be empty if there is
   // no configuration file.
   string ConfigFilePath() { return config_file_path_; }
 
+  // Views saved from the menu are kept in a file of their own, in the same
+  // format as the configuration file, which may not exist yet.
+  string ViewsFilePath() { return data_dir_ + "views"; }
+
+  bool FileExists(const string& file_path);
+
+  // Whether name can be saved as a file of its own in one of the directories
+  // above without reaching outside it.  Names starting with a dot are hidden
+  // from the lists of saved files, so they're left out too.
+  static bool IsPlainFileName(const string& name);
+
  private:
   FileManager();
   virtual ~FileManager();
 
   bool CheckDir(const string& dir);
-  bool FileExists(const string& file_path);
 
   string home_dir_;
   string data_dir_;
   string project_dir_;
+  string template_dir_;
   string config_file_path_;
 };
 
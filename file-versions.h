@@ -11,4 +11,7 @@ static const uint64 NOTES_VERSION = 1;
 // Keep track of all status changes to a task.
 static const uint64 TASK_STATUS_VERSION = 2;
 
+// Tasks keep the ids their project gave them.
+static const uint64 TASK_ID_VERSION = 3;
+
 #endif  // FILE_VERSIONS_H_
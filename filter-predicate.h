@@ -14,13 +14,58 @@
 //      success = false;
 //    }
 //  }
+//
+// The getters can be plain functions, as above, or callable types, which get
+// inlined into ObjectPasses():
+//
+//  struct AliveGetter {
+//    bool operator()(TestObj* t) const { return t->Alive(); }
+//  };
+//  BooleanFilterPredicate<TestObj, AliveGetter> bfp((AliveGetter()));
+//
+// Getters of strings may return a const reference or a string_view, so that
+// nothing is copied while filtering.
+//
+// A tree that's run over many objects is best compiled into a FilterProgram
+// first, which evaluates the whole tree without any virtual calls:
+//
+//  FilterProgram<TestObj> program;
+//  program.Compile(&and_filter);
+//  vector<TestObj*> filtered = program.FilterVector(test_objects);
+//
+// Before compiling, a tree can be planned, which reorders the children of its
+// And and Or predicates by what they cost and how often they pass in a sample
+// of the objects, so the tests most likely to settle the answer cheaply go
+// first:
+//
+//  and_filter.Plan(some_test_objects);
+//  program.Compile(&and_filter);
+//
+// Objects that are numbered, such as by id, can instead be filtered all at
+// once into a bitmap of the numbers that pass.  Each leaf then tests only the
+// objects that can still change the answer, and the And and Or predicates
+// combine what their children pass a word at a time:
+//
+//  IdBitmap all(objects_by_number.size());
+//  all.SetAll();
+//  IdBitmap passes;
+//  and_filter.Evaluate(objects_by_number, all, &passes);
 
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <vector>
+#include "id-bitmap.h"
+#include "regex-matcher.h"
+#include "string-search.h"
 
+using std::shared_ptr;
 using std::string;
 using std::vector;
 
+template <class T>
+class FilterProgram;
+
 // Filter Predicate
 template <class T>
 class FilterPredicate {
@@ -39,17 +84,123 @@ class FilterPredicate {
   }
 
   void SetIsNot(bool n) { is_not_ = n; }
+  bool IsNot() { return is_not_; }
+
+  // Roughly what testing one object costs, relative to comparing two numbers.
+  virtual double Cost() { return kCallCost; }
+
+  // Orders the children of the And and Or predicates in the tree by what they
+  // cost for how likely they are to settle the answer, which is measured on
+  // sample.  Whatever was compiled from the tree has to be compiled again.
+  virtual void Plan(const vector<T*>& sample) {}
+
+  // Sets in passes, which gets among's size, the numbers set in among whose
+  // objects pass.  objects[i] is the object numbered i, and is only looked at
+  // if i is in among.
+  virtual void Evaluate(const vector<T*>& objects, const IdBitmap& among,
+                        IdBitmap* passes) {
+    passes->Resize(among.Size());
+    passes->ClearAll();
+    for (int i = among.Next(0); i >= 0; i = among.Next(i + 1)) {
+      if (ObjectPasses(objects[i])) {
+        passes->Set(i);
+      }
+    }
+  }
+
+  // Adds instructions to program that jump to if_true when an object passes
+  // and to if_false when it doesn't.  Predicates that don't override this are
+  // run through ObjectPasses().
+  virtual void CompileInto(FilterProgram<T>* program, int if_true,
+                           int if_false) {
+    program->Emit(CallObjectPasses, this, if_true, if_false);
+  }
 
  protected:
+  // Emits test, which must ignore is_not_: the jumps are swapped instead.
+  void EmitTest(FilterProgram<T>* program,
+                bool (*test)(FilterPredicate<T>*, T*), int if_true,
+                int if_false) {
+    if (is_not_) {
+      std::swap(if_true, if_false);
+    }
+    program->Emit(test, this, if_true, if_false);
+  }
+
+  // Turns passes, which is what passed of among, into what failed if this is
+  // negated.
+  void NegateIfNot(const IdBitmap& among, IdBitmap* passes) {
+    if (is_not_) {
+      IdBitmap failed = among;
+      failed.AndNot(*passes);
+      passes->Swap(&failed);
+    }
+  }
+
+  // Orders children for Plan().  Each child is measured on how often it
+  // passes, if settled_by is true, or fails, if it's false, which settles an
+  // Or or an And respectively.  Returns what testing the children in the new
+  // order is expected to cost.
+  static double OrderChildren(vector<FilterPredicate<T>*>* children,
+                              const vector<T*>& sample, bool settled_by) {
+    vector<PlannedChild> planned(children->size());
+    for (int i = 0; i < children->size(); ++i) {
+      FilterPredicate<T>* child = (*children)[i];
+      child->Plan(sample);
+      int settled = 0;
+      for (int j = 0; j < sample.size(); ++j) {
+        if (child->ObjectPasses(sample[j]) == settled_by) {
+          ++settled;
+        }
+      }
+      // A sample can't rule anything out, so every child gets some chance.
+      PlannedChild& p = planned[i];
+      p.child = child;
+      p.cost = child->Cost();
+      p.settles = (settled + 1.0) / (sample.size() + 2.0);
+      p.rank = p.cost / p.settles;
+    }
+    std::stable_sort(planned.begin(), planned.end());
+    double cost = 0;
+    double reached = 1;
+    for (int i = 0; i < planned.size(); ++i) {
+      (*children)[i] = planned[i].child;
+      cost += reached * planned[i].cost;
+      reached *= 1 - planned[i].settles;
+    }
+    return cost;
+  }
+
+  // Rough costs of tests, relative to comparing two numbers.
+  static const int kCompareCost = 1;
+  static const int kCallCost = 2;
+  static const int kScanCost = 20;
+  static const int kRegexCost = 40;
+
   bool is_not_;
+
+ private:
+  struct PlannedChild {
+    FilterPredicate<T>* child;
+    double cost;
+    double settles;
+    // Lower goes first.
+    double rank;
+    bool operator<(const PlannedChild& other) const {
+      return rank < other.rank;
+    }
+  };
+
+  static bool CallObjectPasses(FilterPredicate<T>* p, T* t) {
+    return p->ObjectPasses(t);
+  }
 };
 
-template <class T>
+template <class T, class Getter = bool (*)(T*)>
 class BooleanFilterPredicate : public FilterPredicate<T> {
  public:
-  explicit BooleanFilterPredicate(bool (*bool_getter_function)(T*)) {
-    bool_getter_function_ = bool_getter_function;
-  }
+  explicit BooleanFilterPredicate(Getter bool_getter_function)
+      : bool_getter_function_(bool_getter_function) {}
 
   virtual ~BooleanFilterPredicate() {}
 
@@ -60,18 +211,26 @@ class BooleanFilterPredicate : public FilterPredicate<T> {
     return bool_getter_function_(t);
   }
 
+  void CompileInto(FilterProgram<T>* program, int if_true, int if_false) {
+    this->EmitTest(program, Test, if_true, if_false);
+  }
+
+  double Cost() { return this->kCompareCost; }
+
  private:
-  bool (*bool_getter_function_)(T*);
+  static bool Test(FilterPredicate<T>* p, T* t) {
+    return static_cast<BooleanFilterPredicate*>(p)->bool_getter_function_(t);
+  }
+
+  Getter bool_getter_function_;
 };
 
 // Equality Filter Predicate
-template <class T1, class T2>
+template <class T1, class T2, class Getter = T2 (*)(T1*)>
 class EqualityFilterPredicate : public FilterPredicate<T1> {
  public:
-  EqualityFilterPredicate(T2 val, T2 (*value_getter_function)(T1*)) {
-    val_ = val;
-    value_getter_function_ = value_getter_function;
-  }
+  EqualityFilterPredicate(T2 val, Getter value_getter_function)
+      : val_(val), value_getter_function_(value_getter_function) {}
   virtual ~EqualityFilterPredicate() {}
 
   bool ObjectPasses(T1* t) {
@@ -81,9 +240,20 @@ class EqualityFilterPredicate : public FilterPredicate<T1> {
     return value_getter_function_(t) == val_;
   }
 
+  void CompileInto(FilterProgram<T1>* program, int if_true, int if_false) {
+    this->EmitTest(program, Test, if_true, if_false);
+  }
+
+  double Cost() { return this->kCompareCost; }
+
  private:
+  static bool Test(FilterPredicate<T1>* p, T1* t) {
+    EqualityFilterPredicate* self = static_cast<EqualityFilterPredicate*>(p);
+    return self->value_getter_function_(t) == self->val_;
+  }
+
   T2 val_;
-  T2 (*value_getter_function_)(T1*);
+  Getter value_getter_function_;
 };
 
 // Greater Than Filter Predicate.  Takes two types.  The first type is the type
@@ -93,13 +263,11 @@ class EqualityFilterPredicate : public FilterPredicate<T1> {
 //   vector<MyObj*> list;
 //   GTFilterPredicate<MyObj, int> gtfp(11, MyObj::StaticValueWrapper);
 //   vector<MyObj*> filtered_list = gtfp.FilterVector(list);
-template <class T1, class T2>
+template <class T1, class T2, class Getter = T2 (*)(T1*)>
 class GTFilterPredicate : public FilterPredicate<T1> {
  public:
-  GTFilterPredicate(T2 val, T2 (*value_getter_function)(T1*)) {
-    val_ = val;
-    value_getter_function_ = value_getter_function;
-  }
+  GTFilterPredicate(T2 val, Getter value_getter_function)
+      : val_(val), value_getter_function_(value_getter_function) {}
   virtual ~GTFilterPredicate() {}
 
   bool ObjectPasses(T1* t) {
@@ -109,19 +277,28 @@ class GTFilterPredicate : public FilterPredicate<T1> {
     return value_getter_function_(t) > val_;
   }
 
+  void CompileInto(FilterProgram<T1>* program, int if_true, int if_false) {
+    this->EmitTest(program, Test, if_true, if_false);
+  }
+
+  double Cost() { return this->kCompareCost; }
+
  private:
+  static bool Test(FilterPredicate<T1>* p, T1* t) {
+    GTFilterPredicate* self = static_cast<GTFilterPredicate*>(p);
+    return self->value_getter_function_(t) > self->val_;
+  }
+
   T2 val_;
-  T2 (*value_getter_function_)(T1*);
+  Getter value_getter_function_;
 };
 
 // Less Than Filter Predicate
-template <class T1, class T2>
+template <class T1, class T2, class Getter = T2 (*)(T1*)>
 class LTFilterPredicate : public FilterPredicate<T1> {
  public:
-  LTFilterPredicate(T2 val, T2 (*value_getter_function)(T1*)) {
-    val_ = val;
-    value_getter_function_ = value_getter_function;
-  }
+  LTFilterPredicate(T2 val, Getter value_getter_function)
+      : val_(val), value_getter_function_(value_getter_function) {}
   virtual ~LTFilterPredicate() {}
 
   bool ObjectPasses(T1* t) {
@@ -131,40 +308,133 @@ class LTFilterPredicate : public FilterPredicate<T1> {
     return value_getter_function_(t) < val_;
   }
 
+  void CompileInto(FilterProgram<T1>* program, int if_true, int if_false) {
+    this->EmitTest(program, Test, if_true, if_false);
+  }
+
+  double Cost() { return this->kCompareCost; }
+
  private:
+  static bool Test(FilterPredicate<T1>* p, T1* t) {
+    LTFilterPredicate* self = static_cast<LTFilterPredicate*>(p);
+    return self->value_getter_function_(t) < self->val_;
+  }
+
   T2 val_;
-  T2 (*value_getter_function_)(T1*);
+  Getter value_getter_function_;
 };
 
-// String Contains Filter Predicate
-template <class T>
+// String Contains Filter Predicate, which ignores case.
+template <class T, class Getter = string (*)(T*)>
 class StringContainsFilterPredicate : public FilterPredicate<T> {
  public:
-  StringContainsFilterPredicate(string needle,
-                                string (*text_getter_function)(T*)) {
-    needle_ = needle;
-    text_getter_function_ = text_getter_function;
-  }
+  StringContainsFilterPredicate(const string& needle,
+                                Getter text_getter_function)
+      : searcher_(needle), text_getter_function_(text_getter_function) {}
   virtual ~StringContainsFilterPredicate() {}
 
   virtual bool ObjectPasses(T* t) {
-    const string text = text_getter_function_(t);
+    // Binds to whatever the getter returns, so a reference isn't copied.
+    const auto& text = text_getter_function_(t);
+    return searcher_.FoundIn(text.data(), text.size()) != this->is_not_;
+  }
+
+  void CompileInto(FilterProgram<T>* program, int if_true, int if_false) {
+    this->EmitTest(program, Test, if_true, if_false);
+  }
+
+  double Cost() { return this->kScanCost; }
+
+ private:
+  static bool Test(FilterPredicate<T>* p, T* t) {
+    StringContainsFilterPredicate* self =
+        static_cast<StringContainsFilterPredicate*>(p);
+    const auto& text = self->text_getter_function_(t);
+    return self->searcher_.FoundIn(text.data(), text.size());
+  }
+
+  CaselessSearcher searcher_;
+  Getter text_getter_function_;
+};
+
+// Regex Filter Predicate, which passes objects whose text contains a match
+// for a compiled pattern.  Every predicate for a pattern shares its matcher.
+template <class T, class Getter = string (*)(T*)>
+class RegexFilterPredicate : public FilterPredicate<T> {
+ public:
+  RegexFilterPredicate(const shared_ptr<const RegexMatcher>& regex,
+                       Getter text_getter_function)
+      : regex_(regex), text_getter_function_(text_getter_function) {}
+  virtual ~RegexFilterPredicate() {}
+
+  virtual bool ObjectPasses(T* t) {
+    const auto& text = text_getter_function_(t);
+    return regex_->FoundIn(text.data(), text.size()) != this->is_not_;
+  }
+
+  void CompileInto(FilterProgram<T>* program, int if_true, int if_false) {
+    this->EmitTest(program, Test, if_true, if_false);
+  }
+
+  double Cost() { return this->kRegexCost; }
+
+ private:
+  static bool Test(FilterPredicate<T>* p, T* t) {
+    RegexFilterPredicate* self = static_cast<RegexFilterPredicate*>(p);
+    const auto& text = self->text_getter_function_(t);
+    return self->regex_->FoundIn(text.data(), text.size());
+  }
+
+  shared_ptr<const RegexMatcher> regex_;
+  Getter text_getter_function_;
+};
+
+// Bitmap Filter Predicate, which passes the objects whose numbers, as
+// IdGetter gets them, are set in a bitmap.  Its Evaluate() is just a word-wide
+// AND, so objects must be numbered the same way there.
+template <class T, class IdGetter = int (*)(T*)>
+class BitmapFilterPredicate : public FilterPredicate<T> {
+ public:
+  BitmapFilterPredicate(const shared_ptr<const IdBitmap>& bits,
+                        IdGetter id_getter_function)
+      : bits_(bits), id_getter_function_(id_getter_function) {}
+  virtual ~BitmapFilterPredicate() {}
+
+  bool ObjectPasses(T* t) {
+    return bits_->Test(id_getter_function_(t)) != this->is_not_;
+  }
+
+  void CompileInto(FilterProgram<T>* program, int if_true, int if_false) {
+    this->EmitTest(program, Test, if_true, if_false);
+  }
+
+  double Cost() { return this->kCompareCost; }
+
+  void Evaluate(const vector<T*>& objects, const IdBitmap& among,
+                IdBitmap* passes) {
+    *passes = among;
     if (this->is_not_) {
-      return (text.find(needle_) == string::npos);
+      passes->AndNot(*bits_);
+    } else {
+      passes->And(*bits_);
     }
-    return (text.find(needle_) != string::npos);
   }
 
  private:
-  string needle_;
-  string (*text_getter_function_)(T*);
+  static bool Test(FilterPredicate<T>* p, T* t) {
+    BitmapFilterPredicate* self = static_cast<BitmapFilterPredicate*>(p);
+    return self->bits_->Test(self->id_getter_function_(t));
+  }
+
+  shared_ptr<const IdBitmap> bits_;
+  IdGetter id_getter_function_;
 };
 
 // AND Filter Predicate
 template <class T>
 class AndFilterPredicate : public FilterPredicate<T> {
  public:
-  AndFilterPredicate() {}
+  AndFilterPredicate() : cost_(-1) {}
   ~AndFilterPredicate() {
     for (int i = 0; i < children_.size(); ++i) {
       delete children_[i];
@@ -181,24 +451,75 @@ class AndFilterPredicate : public FilterPredicate<T> {
     return true;
   }
 
-  virtual void AddChild(FilterPredicate<T>* f) { children_.push_back(f); }
+  virtual void AddChild(FilterPredicate<T>* f) {
+    children_.push_back(f);
+    cost_ = -1;
+  }
+
+  virtual void CompileInto(FilterProgram<T>* program, int if_true,
+                           int if_false) {
+    if (this->is_not_) {
+      std::swap(if_true, if_false);
+    }
+    if (children_.empty()) {
+      program->EmitJump(if_true);
+      return;
+    }
+    // Each child but the last goes on to the next one when it passes.
+    for (int i = 0; i + 1 < children_.size(); ++i) {
+      int next = program->NewLabel();
+      children_[i]->CompileInto(program, next, if_false);
+      program->BindLabel(next);
+    }
+    children_.back()->CompileInto(program, if_true, if_false);
+  }
 
   virtual void Clear() {
     for (int i = 0; i < children_.size(); ++i) {
       delete children_[i];
     }
     children_.clear();
+    cost_ = -1;
+  }
+
+  // Until the children are planned, the cost of testing all of them.
+  double Cost() {
+    if (cost_ < 0) {
+      cost_ = 0;
+      for (int i = 0; i < children_.size(); ++i) {
+        cost_ += children_[i]->Cost();
+      }
+    }
+    return cost_;
+  }
+
+  void Plan(const vector<T*>& sample) {
+    cost_ = this->OrderChildren(&children_, sample, false);
+  }
+
+  // Each child only tests what passed the ones before it, so what it passes
+  // is what passes them all.
+  void Evaluate(const vector<T*>& objects, const IdBitmap& among,
+                IdBitmap* passes) {
+    *passes = among;
+    IdBitmap child_passes;
+    for (int i = 0; i < children_.size() && passes->Any(); ++i) {
+      children_[i]->Evaluate(objects, *passes, &child_passes);
+      passes->Swap(&child_passes);
+    }
+    this->NegateIfNot(among, passes);
   }
 
  private:
   vector<FilterPredicate<T>*> children_;
+  double cost_;
 };
 
 // OR Filter Predicate
 template <class T>
 class OrFilterPredicate : public FilterPredicate<T> {
  public:
-  OrFilterPredicate() {}
+  OrFilterPredicate() : cost_(-1) {}
   ~OrFilterPredicate() {
     for (int i = 0; i < children_.size(); ++i) {
       delete children_[i];
@@ -215,17 +536,144 @@ class OrFilterPredicate : public FilterPredicate<T> {
     return false;
   }
 
-  virtual void AddChild(FilterPredicate<T>* f) { children_.push_back(f); }
+  virtual void AddChild(FilterPredicate<T>* f) {
+    children_.push_back(f);
+    cost_ = -1;
+  }
+
+  virtual void CompileInto(FilterProgram<T>* program, int if_true,
+                           int if_false) {
+    if (this->is_not_) {
+      std::swap(if_true, if_false);
+    }
+    if (children_.empty()) {
+      program->EmitJump(if_false);
+      return;
+    }
+    // Each child but the last goes on to the next one when it fails.
+    for (int i = 0; i + 1 < children_.size(); ++i) {
+      int next = program->NewLabel();
+      children_[i]->CompileInto(program, if_true, next);
+      program->BindLabel(next);
+    }
+    children_.back()->CompileInto(program, if_true, if_false);
+  }
 
   virtual void Clear() {
     for (int i = 0; i < children_.size(); ++i) {
       delete children_[i];
     }
     children_.clear();
+    cost_ = -1;
+  }
+
+  // Until the children are planned, the cost of testing all of them.
+  double Cost() {
+    if (cost_ < 0) {
+      cost_ = 0;
+      for (int i = 0; i < children_.size(); ++i) {
+        cost_ += children_[i]->Cost();
+      }
+    }
+    return cost_;
+  }
+
+  void Plan(const vector<T*>& sample) {
+    cost_ = this->OrderChildren(&children_, sample, true);
+  }
+
+  // Each child only tests what failed the ones before it.
+  void Evaluate(const vector<T*>& objects, const IdBitmap& among,
+                IdBitmap* passes) {
+    passes->Resize(among.Size());
+    passes->ClearAll();
+    IdBitmap left = among;
+    IdBitmap child_passes;
+    for (int i = 0; i < children_.size() && left.Any(); ++i) {
+      children_[i]->Evaluate(objects, left, &child_passes);
+      passes->Or(child_passes);
+      left.AndNot(child_passes);
+    }
+    this->NegateIfNot(among, passes);
   }
 
  private:
   vector<FilterPredicate<T>*> children_;
+  double cost_;
+};
+
+// A predicate tree flattened into a list of tests, each of which says where to
+// jump when it passes and when it fails, so And and Or short circuit without
+// any calls of their own.  The program points into the tree it was compiled
+// from, so it must be recompiled whenever the tree changes.
+template <class T>
+class FilterProgram {
+ public:
+  // Where a test can jump to besides another instruction.
+  static const int kPass = -1;
+  static const int kFail = -2;
+
+  // Passes everything until something is compiled.
+  FilterProgram() : num_labels_(0) {}
+
+  void Compile(FilterPredicate<T>* root) {
+    code_.clear();
+    num_labels_ = 0;
+    root->CompileInto(this, kPass, kFail);
+  }
+
+  bool ObjectPasses(T* t) const {
+    if (code_.empty()) {
+      return true;
+    }
+    int pc = 0;
+    do {
+      const Instruction& in = code_[pc];
+      pc = in.test(in.predicate, t) ? in.if_true : in.if_false;
+    } while (pc >= 0);
+    return pc == kPass;
+  }
+
+  vector<T*> FilterVector(const vector<T*>& list) const {
+    vector<T*> out;
+    for (int i = 0; i < list.size(); ++i) {
+      if (ObjectPasses(list[i])) {
+        out.push_back(list[i]);
+      }
+    }
+    return out;
+  }
+
+  int NumInstructions() const { return code_.size(); }
+
+  // For predicates' CompileInto().  A label stands in for an instruction that
+  // hasn't been emitted yet, and BindLabel() points it at the next one.
+  void Emit(bool (*test)(FilterPredicate<T>*, T*), FilterPredicate<T>* p,
+            int if_true, int if_false) {
+    Instruction in = {test, p, if_true, if_false};
+    code_.push_back(in);
+  }
+  void EmitJump(int target) { Emit(Always, NULL, target, target); }
+  int NewLabel() { return kFail - ++num_labels_; }
+  void BindLabel(int label) {
+    for (int i = 0; i < code_.size(); ++i) {
+      if (code_[i].if_true == label) code_[i].if_true = code_.size();
+      if (code_[i].if_false == label) code_[i].if_false = code_.size();
+    }
+  }
+
+ private:
+  struct Instruction {
+    bool (*test)(FilterPredicate<T>*, T*);
+    FilterPredicate<T>* predicate;
+    int if_true;
+    int if_false;
+  };
+
+  static bool Always(FilterPredicate<T>* p, T* t) { return true; }
+
+  vector<Instruction> code_;
+  int num_labels_;
 };
 
 #endif  // FILTER_PREDICATE_H_
@@ -0,0 +1,118 @@
+/* Times the project's filters run as predicate trees against the same filters
+   compiled into FilterPrograms.  Build it like the tests, with -O3:
+
+     g++ -O3 -pthread -I. -o filter-predicate_benchmark \
+         filter-predicate_benchmark.cc task.o date.o note.o snapshot.o \
+         serializer.o utils.o hierarchical-list.o dialog-box.o \
+         filter-predicate.o thread-pool.o trigram-index.o string-search.o \
+         filtered-lists.o id-bitmap.o regex-matcher.o \
+         -lform -lmenu -lpanel -lncurses
+     ./filter-predicate_benchmark [num_tasks] */
+
+#include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "filter-predicate.h"
+#include "task.h"
+
+using namespace std;
+
+// Keeps the compiler from throwing the results away.
+static int total_passed = 0;
+
+double SecondsToFilter(FilterPredicate<Task>* tree, const vector<Task*>& tasks,
+                       bool compiled) {
+  FilterProgram<Task> program;
+  program.Compile(tree);
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  int passed = 0;
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    if (compiled ? program.ObjectPasses(tasks[i])
+                 : tree->ObjectPasses(tasks[i])) {
+      ++passed;
+    }
+  }
+  total_passed += passed;
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// The filters Project::RunSearchFilter(), ArchiveCompletedTasks() and
+// ShowCompletedLastWeek() build.
+FilterPredicate<Task>* SearchFilter(const string& needle) {
+  OrFilterPredicate<Task>* or_filter = new OrFilterPredicate<Task>();
+  or_filter->AddChild(
+      new StringContainsFilterPredicate<Task, Task::TitleGetter>(
+          needle, Task::TitleGetter()));
+  or_filter->AddChild(
+      new StringContainsFilterPredicate<Task, Task::DescriptionGetter>(
+          needle, Task::DescriptionGetter()));
+  or_filter->AddChild(
+      new BooleanFilterPredicate<Task, Task::HasFilteredSubtasksGetter>(
+          Task::HasFilteredSubtasksGetter()));
+  AndFilterPredicate<Task>* base = new AndFilterPredicate<Task>();
+  base->AddChild(or_filter);
+  return base;
+}
+
+FilterPredicate<Task>* ArchiveFilter() {
+  EqualityFilterPredicate<Task, TaskStatus, Task::StatusGetter>* efp =
+      new EqualityFilterPredicate<Task, TaskStatus, Task::StatusGetter>(
+          COMPLETED, Task::StatusGetter());
+  efp->SetIsNot(true);
+  AndFilterPredicate<Task>* base = new AndFilterPredicate<Task>();
+  base->AddChild(efp);
+  return base;
+}
+
+FilterPredicate<Task>* CompletedLastWeekFilter() {
+  OrFilterPredicate<Task>* or_filter = new OrFilterPredicate<Task>();
+  or_filter->AddChild(
+      new GTFilterPredicate<Task, time_t, Task::CompletionTimeGetter>(
+          time(NULL) - 60 * 60 * 24 * 7, Task::CompletionTimeGetter()));
+  or_filter->AddChild(
+      new BooleanFilterPredicate<Task, Task::HasFilteredSubtasksGetter>(
+          Task::HasFilteredSubtasksGetter()));
+  AndFilterPredicate<Task>* base = new AndFilterPredicate<Task>();
+  base->AddChild(or_filter);
+  return base;
+}
+
+void Benchmark(const string& name, FilterPredicate<Task>* tree,
+               const vector<Task*>& tasks) {
+  // Best of a few runs, alternating so neither gets a warmer cache.
+  double tree_seconds = 1e9;
+  double program_seconds = 1e9;
+  for (int run = 0; run < 5; ++run) {
+    tree_seconds = min(tree_seconds, SecondsToFilter(tree, tasks, false));
+    program_seconds = min(program_seconds, SecondsToFilter(tree, tasks, true));
+  }
+  cout << name << ": tree " << tree_seconds * 1000 << " ms, program "
+       << program_seconds * 1000 << " ms, " << tree_seconds / program_seconds
+       << "x" << endl;
+  delete tree;
+}
+
+int main(int argc, char** argv) {
+  int num_tasks = argc > 1 ? atoi(argv[1]) : 1000000;
+  vector<Task*> tasks;
+  for (int i = 0; i < num_tasks; ++i) {
+    Task* t = new Task("Task number " + to_string(i), "Described at length");
+    if (i % 3 == 0) {
+      t->SetStatus(COMPLETED);
+    }
+    tasks.push_back(t);
+  }
+
+  cout << "Filtering " << num_tasks << " tasks" << endl;
+  Benchmark("Search", SearchFilter("number 7"), tasks);
+  Benchmark("Archive completed", ArchiveFilter(), tasks);
+  Benchmark("Completed last week", CompletedLastWeekFilter(), tasks);
+  cout << "(" << total_passed << " passed in all)" << endl;
+
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    delete tasks[i];
+  }
+  return 0;
+}
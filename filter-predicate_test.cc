@@ -1,6 +1,9 @@
 #include "filter-predicate.h"
+#include <assert.h>
+#include <stdlib.h>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using namespace std;
@@ -27,6 +30,25 @@ class TestObj {
   string Str() { return str_; }
   static string StrWrapper(TestObj* t) { return t->Str(); }
 
+  struct StrRefGetter {
+    const string& operator()(TestObj* t) const { return t->str_; }
+  };
+  struct StrViewGetter {
+    std::string_view operator()(TestObj* t) const { return t->str_; }
+  };
+  struct ValGetter {
+    int operator()(TestObj* t) const { return t->val_; }
+  };
+  // Counts how many times it's called.
+  struct CountingStrGetter {
+    explicit CountingStrGetter(int* calls) : calls(calls) {}
+    const string& operator()(TestObj* t) const {
+      ++*calls;
+      return t->str_;
+    }
+    int* calls;
+  };
+
  private:
   int val_;
   string str_;
@@ -221,10 +243,245 @@ bool TestStringContainsFilterPredicate() {
   return success;
 }
 
+bool TestCallableGetters() {
+  bool success = true;
+  cout << "Testing filter predicates with callable getters" << endl;
+
+  vector<TestObj*> test_objects;
+  for (int i = 0; i < 20; ++i) {
+    test_objects.push_back(new TestObj(i));
+  }
+  test_objects[4]->SetStr("gabe");
+  test_objects[7]->SetStr("not gabe");
+
+  StringContainsFilterPredicate<TestObj, TestObj::StrRefGetter> ref_filter(
+      "gabe", TestObj::StrRefGetter());
+  if (ref_filter.FilterVector(test_objects).size() != 2) {
+    ERROR("A getter returning a reference filtered wrong.");
+    success = false;
+  }
+
+  StringContainsFilterPredicate<TestObj, TestObj::StrViewGetter> view_filter(
+      "gabe", TestObj::StrViewGetter());
+  view_filter.SetIsNot(true);
+  if (view_filter.FilterVector(test_objects).size() != 18) {
+    ERROR("A getter returning a string_view filtered wrong.");
+    success = false;
+  }
+
+  GTFilterPredicate<TestObj, int, TestObj::ValGetter> gtfp(
+      14, TestObj::ValGetter());
+  if (gtfp.FilterVector(test_objects).size() != 5) {
+    ERROR("A callable int getter filtered wrong.");
+    success = false;
+  }
+
+  for (int i = 0; i < test_objects.size(); ++i) {
+    delete test_objects[i];
+  }
+  return success;
+}
+
+bool TestRegexFilterPredicate() {
+  bool success = true;
+  cout << "Testing RegexFilterPredicate" << endl;
+
+  vector<TestObj*> test_objects;
+  for (int i = 0; i < 20; ++i) {
+    test_objects.push_back(new TestObj(i));
+  }
+  test_objects[3]->SetStr("Fix OPS-12 first");
+  test_objects[5]->SetStr("ops-12 is lower case");
+  test_objects[8]->SetStr("WEB-7");
+
+  string error;
+  RegexFilterPredicate<TestObj, TestObj::StrRefGetter> filter(
+      RegexMatcher::Compiled("[A-Z]+-[0-9]+", &error), TestObj::StrRefGetter());
+  vector<TestObj*> filtered = filter.FilterVector(test_objects);
+  if (filtered.size() != 2 || filtered[0] != test_objects[3] ||
+      filtered[1] != test_objects[8]) {
+    ERROR("The regex filter passed the wrong objects.");
+    success = false;
+  }
+
+  FilterProgram<TestObj> program;
+  filter.SetIsNot(true);
+  program.Compile(&filter);
+  if (program.FilterVector(test_objects).size() != 18) {
+    ERROR("The negated regex filter compiled wrong.");
+    success = false;
+  }
+
+  for (int i = 0; i < test_objects.size(); ++i) {
+    delete test_objects[i];
+  }
+  return success;
+}
+
+// Only has ObjectPasses(), so programs have to call it.
+class EvenFilterPredicate : public FilterPredicate<TestObj> {
+ public:
+  bool ObjectPasses(TestObj* t) { return (t->Val() % 2 == 0) != is_not_; }
+};
+
+// Builds a random tree of And, Or, GT, Even and Bitmap predicates, each maybe
+// negated.  The bitmaps are of values under 20.
+FilterPredicate<TestObj>* RandomPredicate(int depth) {
+  FilterPredicate<TestObj>* p;
+  int kind = depth > 3 ? 2 + rand() % 3 : rand() % 5;
+  if (kind < 2) {
+    int num_children = rand() % 4;
+    if (kind == 0) {
+      AndFilterPredicate<TestObj>* a = new AndFilterPredicate<TestObj>();
+      for (int i = 0; i < num_children; ++i) {
+        a->AddChild(RandomPredicate(depth + 1));
+      }
+      p = a;
+    } else {
+      OrFilterPredicate<TestObj>* o = new OrFilterPredicate<TestObj>();
+      for (int i = 0; i < num_children; ++i) {
+        o->AddChild(RandomPredicate(depth + 1));
+      }
+      p = o;
+    }
+  } else if (kind == 2) {
+    p = new GTFilterPredicate<TestObj, int>(rand() % 20, TestObj::ValWrapper);
+  } else if (kind == 3) {
+    p = new EvenFilterPredicate();
+  } else {
+    shared_ptr<IdBitmap> bits(new IdBitmap(20));
+    for (int i = 0; i < 20; ++i) {
+      bits->Assign(i, rand() % 2);
+    }
+    p = new BitmapFilterPredicate<TestObj, TestObj::ValGetter>(
+        bits, TestObj::ValGetter());
+  }
+  p->SetIsNot(rand() % 2);
+  return p;
+}
+
+bool TestFilterProgram() {
+  bool success = true;
+  cout << "Testing FilterProgram and Evaluate()" << endl;
+
+  vector<TestObj*> test_objects;
+  for (int i = 0; i < 20; ++i) {
+    test_objects.push_back(new TestObj(i));
+  }
+
+  srand(1);
+  for (int trial = 0; trial < 1000 && success; ++trial) {
+    FilterPredicate<TestObj>* tree = RandomPredicate(0);
+    vector<bool> passes;
+    for (int i = 0; i < test_objects.size(); ++i) {
+      passes.push_back(tree->ObjectPasses(test_objects[i]));
+    }
+    // Planning only changes the order things are tested in.
+    if (trial % 2) {
+      vector<TestObj*> sample(test_objects.begin(), test_objects.begin() + 8);
+      tree->Plan(sample);
+    }
+    FilterProgram<TestObj> program;
+    program.Compile(tree);
+    for (int i = 0; i < test_objects.size(); ++i) {
+      if (program.ObjectPasses(test_objects[i]) != passes[i] ||
+          tree->ObjectPasses(test_objects[i]) != passes[i]) {
+        ERROR("A compiled program disagreed with its tree.");
+        success = false;
+        break;
+      }
+    }
+    // Objects are numbered by value, and only some are evaluated.
+    IdBitmap among(test_objects.size());
+    for (int i = 0; i < test_objects.size(); ++i) {
+      among.Assign(i, rand() % 4);
+    }
+    IdBitmap evaluated;
+    tree->Evaluate(test_objects, among, &evaluated);
+    for (int i = 0; i < test_objects.size(); ++i) {
+      if (evaluated.Test(i) != (among.Test(i) && passes[i])) {
+        ERROR("Evaluating a tree into a bitmap disagreed with testing it.");
+        success = false;
+        break;
+      }
+    }
+    delete tree;
+  }
+
+  for (int i = 0; i < test_objects.size(); ++i) {
+    delete test_objects[i];
+  }
+  return success;
+}
+
+bool TestPlan() {
+  bool success = true;
+  cout << "Testing planning the order of tests" << endl;
+
+  vector<TestObj*> test_objects;
+  for (int i = 0; i < 100; ++i) {
+    test_objects.push_back(new TestObj(i));
+    test_objects.back()->SetStr(i % 3 ? "deploy the site" : "write docs");
+  }
+
+  // The scan passes most objects and the comparison very few, so the
+  // comparison should go first, and the scan only see what it passes.
+  int scans = 0;
+  AndFilterPredicate<TestObj> and_filter;
+  and_filter.AddChild(
+      new StringContainsFilterPredicate<TestObj, TestObj::CountingStrGetter>(
+          "deploy", TestObj::CountingStrGetter(&scans)));
+  and_filter.AddChild(new GTFilterPredicate<TestObj, int, TestObj::ValGetter>(
+      95, TestObj::ValGetter()));
+  double unplanned_cost = and_filter.Cost();
+  vector<TestObj*> sample;
+  for (int i = 0; i < test_objects.size(); i += 4) {
+    sample.push_back(test_objects[i]);
+  }
+  and_filter.Plan(sample);
+  if (and_filter.Cost() >= unplanned_cost) {
+    ERROR("Planning didn't make the And cheaper.");
+    success = false;
+  }
+  FilterProgram<TestObj> program;
+  program.Compile(&and_filter);
+  scans = 0;
+  vector<TestObj*> filtered = program.FilterVector(test_objects);
+  if (filtered.size() != 2 || scans != 4) {
+    ERROR("The planned And scanned too much, or passed the wrong objects.");
+    success = false;
+  }
+
+  // Whereas an Or is settled by the first child that passes, so of two scans
+  // the one that passes more should go first.
+  OrFilterPredicate<TestObj> or_filter;
+  or_filter.AddChild(
+      new StringContainsFilterPredicate<TestObj, TestObj::CountingStrGetter>(
+          "docs", TestObj::CountingStrGetter(&scans)));
+  or_filter.AddChild(
+      new StringContainsFilterPredicate<TestObj, TestObj::CountingStrGetter>(
+          "deploy", TestObj::CountingStrGetter(&scans)));
+  or_filter.Plan(sample);
+  program.Compile(&or_filter);
+  scans = 0;
+  filtered = program.FilterVector(test_objects);
+  if (filtered.size() != 100 || scans != 134) {
+    ERROR("The planned Or put the wrong test first.");
+    success = false;
+  }
+
+  for (int i = 0; i < test_objects.size(); ++i) {
+    delete test_objects[i];
+  }
+  return success;
+}
+
 bool RunTests() {
   return TestBooleanFilterPredicate() && TestGTFilterPredicate() &&
          TestLTFilterPredicate() && TestORFilterPredicate() &&
-         TestANDFilterPredicate() && TestStringContainsFilterPredicate();
+         TestANDFilterPredicate() && TestStringContainsFilterPredicate() &&
+         TestCallableGetters() && TestRegexFilterPredicate() &&
+         TestFilterProgram() && TestPlan();
 }
 
 int main() {
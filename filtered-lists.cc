@@ -0,0 +1,178 @@
+#include "filtered-lists.h"
+#include <algorithm>
+
+FilteredLists::FilteredLists() : end_(0), unused_(0) {}
+
+Task** FilteredLists::Begin(int list) {
+  const Run* run = Find(list);
+  return tasks_.data() + (run == NULL ? 0 : run->begin);
+}
+
+int FilteredLists::NextList(int list) const {
+  for (size_t p = list >> kPageBits; p < pages_.size(); ++p) {
+    for (int i = p == list >> kPageBits ? list & (kPageSize - 1) : 0;
+         i < pages_[p].size(); ++i) {
+      if (pages_[p][i].size > 0) {
+        return (p << kPageBits) + i;
+      }
+    }
+  }
+  return -1;
+}
+
+void FilteredLists::Reset(int num_ids, int num_tasks) {
+  int num_pages = (num_ids + kPageSize - 1) / kPageSize;
+  pages_.resize(std::max<size_t>(pages_.size(), num_pages));
+  for (int p = 0; p < pages_.size(); ++p) {
+    if (p < num_pages) {
+      pages_[p].assign(kPageSize, Run());
+    } else {
+      vector<Run>().swap(pages_[p]);
+    }
+  }
+  // Lists that grew one task at a time can leave far more room than a whole
+  // filter needs.
+  if (tasks_.capacity() > 2 * num_tasks) {
+    vector<Task*>(num_tasks).swap(tasks_);
+  } else if (tasks_.size() < num_tasks) {
+    tasks_.resize(num_tasks);
+  }
+  end_ = 0;
+  unused_ = 0;
+}
+
+Task** FilteredLists::Claim(int list, int capacity) {
+  Run* run = Get(list);
+  // Only ever true when there's just one thread.
+  if (run->capacity > 0) {
+    unused_ += run->capacity;
+  }
+  run->begin = end_.fetch_add(capacity);
+  run->size = 0;
+  run->capacity = capacity;
+  if (run->begin + capacity > tasks_.size()) {
+    tasks_.resize(std::max<size_t>(run->begin + capacity, 2 * tasks_.size()));
+  }
+  return tasks_.data() + run->begin;
+}
+
+void FilteredLists::Insert(int list, int i, Task* t) {
+  Run* run = Get(list);
+  if (run->size == run->capacity) {
+    Grow(run, std::max(4, 2 * run->capacity));
+  }
+  Task** begin = tasks_.data() + run->begin;
+  std::copy_backward(begin + i, begin + run->size, begin + run->size + 1);
+  begin[i] = t;
+  ++run->size;
+}
+
+void FilteredLists::Erase(int list, int i) {
+  Run* run = Get(list);
+  Task** begin = tasks_.data() + run->begin;
+  std::copy(begin + i + 1, begin + run->size, begin + i);
+  --run->size;
+}
+
+void FilteredLists::Assign(int list, const vector<Task*>& tasks) {
+  Run* run = Get(list);
+  run->size = 0;
+  if (tasks.size() > run->capacity) {
+    Grow(run, tasks.size());
+  }
+  std::copy(tasks.begin(), tasks.end(), tasks_.begin() + run->begin);
+  run->size = tasks.size();
+}
+
+void FilteredLists::Clear(int list) {
+  if (Find(list) == NULL) {
+    return;
+  }
+  Run* run = Get(list);
+  unused_ += run->capacity;
+  *run = Run();
+}
+
+void FilteredLists::Swap(FilteredLists* other) {
+  pages_.swap(other->pages_);
+  tasks_.swap(other->tasks_);
+  end_ = other->end_.exchange(end_);
+  std::swap(unused_, other->unused_);
+}
+
+size_t FilteredLists::MemoryUsage() const {
+  size_t usage = sizeof(*this) + pages_.capacity() * sizeof(vector<Run>) +
+                 tasks_.capacity() * sizeof(Task*);
+  for (int p = 0; p < pages_.size(); ++p) {
+    usage += pages_[p].capacity() * sizeof(Run);
+  }
+  return usage;
+}
+
+const FilteredLists::Run* FilteredLists::Find(int list) const {
+  size_t page = list >> kPageBits;
+  if (page >= pages_.size() || pages_[page].empty()) {
+    return NULL;
+  }
+  return &pages_[page][list & (kPageSize - 1)];
+}
+
+FilteredLists::Run* FilteredLists::Get(int list) {
+  size_t page = list >> kPageBits;
+  if (page >= pages_.size()) {
+    pages_.resize(page + 1);
+  }
+  if (pages_[page].empty()) {
+    pages_[page].resize(kPageSize);
+  }
+  return &pages_[page][list & (kPageSize - 1)];
+}
+
+// Moves run to the end of tasks_ with room for capacity tasks, unless it's
+// there already and can just be extended.
+void FilteredLists::Grow(Run* run, int capacity) {
+  if (unused_ > end_ - unused_) {
+    Pack();
+  }
+  bool at_end = run->begin + run->capacity == end_;
+  int begin = at_end ? run->begin : end_.load();
+  end_ = begin + capacity;
+  if (end_ > tasks_.size()) {
+    tasks_.resize(std::max<size_t>(end_, 2 * tasks_.size()));
+  }
+  if (!at_end) {
+    std::copy(tasks_.begin() + run->begin,
+              tasks_.begin() + run->begin + run->size, tasks_.begin() + begin);
+    unused_ += run->capacity;
+    run->begin = begin;
+  }
+  run->capacity = capacity;
+}
+
+// Moves every list to the front of tasks_, keeping their room to grow.
+void FilteredLists::Pack() {
+  if (unused_ == end_) {
+    // No list has any room, so none has to move.
+    end_ = 0;
+    unused_ = 0;
+    return;
+  }
+  vector<Task*> packed;
+  packed.reserve(end_ - unused_);
+  for (int p = 0; p < pages_.size(); ++p) {
+    for (int i = 0; i < pages_[p].size(); ++i) {
+      Run* run = &pages_[p][i];
+      if (run->capacity == 0) {
+        continue;
+      }
+      int begin = packed.size();
+      packed.insert(packed.end(), tasks_.begin() + run->begin,
+                    tasks_.begin() + run->begin + run->size);
+      packed.resize(begin + run->capacity);
+      run->begin = begin;
+    }
+  }
+  tasks_.swap(packed);
+  end_ = tasks_.size();
+  unused_ = 0;
+}
@@ -0,0 +1,89 @@
+#ifndef FILTERED_LISTS_H_
+#define FILTERED_LISTS_H_
+
+// The subtasks of every task in a project that passed its filter, in the
+// order they're shown, and the root tasks that did.  Each list is a run of
+// one shared array, found by the id of the task it belongs to, so filtering
+// doesn't allocate a list per task, and the lists of a whole filter can be
+// put aside and back with Swap():
+//
+//   FilteredLists lists;
+//   lists.Reset(num_ids, num_tasks);
+//   Task** filtered = lists.Claim(parent->Id(), parent->NumChildren());
+//   ...
+//   lists.SetSize(parent->Id(), num_filtered);
+//
+// A list that outgrows its run moves to the end of the array, and the array
+// is packed again once more of it is left behind than is in use.  The runs
+// are looked up in pages of ids, so a filter that shows a few tasks only
+// takes a few pages.
+
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+using std::vector;
+
+class Task;
+
+class FilteredLists {
+ public:
+  // The list of the root tasks.  No task has id 0.
+  static const int kRoots = 0;
+
+  FilteredLists();
+
+  int Size(int list) const {
+    const Run* run = Find(list);
+    return run == NULL ? 0 : run->size;
+  }
+  Task* At(int list, int i) const { return tasks_[Find(list)->begin + i]; }
+  // Where a list's tasks are, until the lists next change.
+  Task** Begin(int list);
+  Task** End(int list) { return Begin(list) + Size(list); }
+  // The first list from list on with any tasks, or -1 if there's none.
+  int NextList(int list) const;
+
+  // Empties every list, and makes room for the lists of ids below num_ids to
+  // hold num_tasks tasks in all.  Until they have, Claim() and SetSize() can
+  // be called from several threads at once, for different lists.
+  void Reset(int num_ids, int num_tasks);
+  // Empties list and gives it room for capacity tasks, which the caller fills
+  // before setting its size.
+  Task** Claim(int list, int capacity);
+  void SetSize(int list, int size) { Get(list)->size = size; }
+
+  void Insert(int list, int i, Task* t);
+  void Append(int list, Task* t) { Insert(list, Size(list), t); }
+  void Erase(int list, int i);
+  void Assign(int list, const vector<Task*>& tasks);
+  void Clear(int list);
+
+  void Swap(FilteredLists* other);
+  size_t MemoryUsage() const;
+
+ private:
+  // Where a list is in tasks_, and how far it can grow there.
+  struct Run {
+    int begin;
+    int size;
+    int capacity;
+  };
+  static const int kPageBits = 8;
+  static const int kPageSize = 1 << kPageBits;
+
+  const Run* Find(int list) const;
+  Run* Get(int list);
+  void Grow(Run* run, int capacity);
+  void Pack();
+
+  // Runs by id, in pages that are only allocated once a list is given room.
+  vector<vector<Run> > pages_;
+  vector<Task*> tasks_;
+  // How much of tasks_ has been given to lists, and how much of that no list
+  // has any more.
+  std::atomic<int> end_;
+  int unused_;
+};
+
+#endif  // FILTERED_LISTS_H_
@@ -0,0 +1,150 @@
+#include "filtered-lists.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static int errors = 0;
+
+ostream& ERROR() {
+  ++errors;
+  cout << "Error: ";
+  return cout;
+}
+
+// Tasks are only ever compared, so any pointer will do.
+Task* FakeTask(int n) { return reinterpret_cast<Task*>(intptr_t(n + 1) * 8); }
+
+// Whether lists holds exactly what model does, by every way of looking.
+bool Holds(FilteredLists* lists, const vector<vector<Task*> >& model) {
+  for (int list = 0; list < model.size(); ++list) {
+    if (lists->Size(list) != model[list].size() ||
+        lists->End(list) - lists->Begin(list) != model[list].size()) {
+      return false;
+    }
+    for (int i = 0; i < model[list].size(); ++i) {
+      if (lists->At(list, i) != model[list][i] ||
+          lists->Begin(list)[i] != model[list][i]) {
+        return false;
+      }
+    }
+    int next = list + 1;
+    while (next < model.size() && model[next].empty()) {
+      ++next;
+    }
+    if (lists->NextList(list + 1) != (next < model.size() ? next : -1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TestEditsAgree() {
+  cout << "Testing edits keep every list" << endl;
+  srand(50);
+  for (int round = 0; round < 200; ++round) {
+    // Enough lists to take several pages, with most edits to a few of them so
+    // that they grow and move.
+    int num_lists = 1 + rand() % 700;
+    FilteredLists lists;
+    vector<vector<Task*> > model(num_lists);
+    for (int op = 0; op < 2000; ++op) {
+      int list = rand() % 2 ? rand() % 8 % num_lists : rand() % num_lists;
+      vector<Task*>* expected = &model[list];
+      int kind = rand() % 10;
+      if (kind < 5) {
+        int i = rand() % (expected->size() + 1);
+        Task* t = FakeTask(rand());
+        lists.Insert(list, i, t);
+        expected->insert(expected->begin() + i, t);
+      } else if (kind < 7 && !expected->empty()) {
+        int i = rand() % expected->size();
+        lists.Erase(list, i);
+        expected->erase(expected->begin() + i);
+      } else if (kind == 7) {
+        expected->assign(rand() % 20, FakeTask(op));
+        lists.Assign(list, *expected);
+      } else if (kind == 8) {
+        lists.Clear(list);
+        expected->clear();
+      } else {
+        int capacity = rand() % 10;
+        Task** filled = lists.Claim(list, capacity);
+        int size = rand() % (capacity + 1);
+        expected->clear();
+        for (int i = 0; i < size; ++i) {
+          filled[i] = FakeTask(op + i);
+          expected->push_back(filled[i]);
+        }
+        lists.SetSize(list, size);
+      }
+    }
+    if (!Holds(&lists, model)) {
+      ERROR() << "The lists don't hold what was put in them in round " << round
+              << "." << endl;
+      return false;
+    }
+    // Swapping with empty lists and back changes nothing.
+    FilteredLists other;
+    lists.Swap(&other);
+    if (lists.Size(0) != 0 || !Holds(&other, model)) {
+      ERROR() << "Swapping lost the lists." << endl;
+      return false;
+    }
+    lists.Swap(&other);
+    lists.Reset(num_lists, 0);
+    if (!Holds(&lists, vector<vector<Task*> >(num_lists))) {
+      ERROR() << "Resetting didn't empty the lists." << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Each thread fills every num_threads-th list, as filtering does.
+void FillLists(FilteredLists* lists, int first, int num_lists, int step) {
+  for (int list = first; list < num_lists; list += step) {
+    Task** filled = lists->Claim(list, list % 5);
+    for (int i = 0; i < list % 5; ++i) {
+      filled[i] = FakeTask(list * 10 + i);
+    }
+    lists->SetSize(list, list % 3 == 0 ? 0 : list % 5);
+  }
+}
+
+bool TestClaimFromThreads() {
+  cout << "Testing lists can be claimed from several threads" << endl;
+  const int kNumLists = 20000;
+  const int kNumThreads = 4;
+  vector<vector<Task*> > model(kNumLists);
+  int num_tasks = 0;
+  for (int list = 0; list < kNumLists; ++list) {
+    num_tasks += list % 5;
+    for (int i = 0; i < (list % 3 == 0 ? 0 : list % 5); ++i) {
+      model[list].push_back(FakeTask(list * 10 + i));
+    }
+  }
+  FilteredLists lists;
+  lists.Reset(kNumLists, num_tasks);
+  vector<thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.push_back(thread(FillLists, &lists, t, kNumLists, kNumThreads));
+  }
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads[t].join();
+  }
+  if (!Holds(&lists, model)) {
+    ERROR() << "The lists filled by threads are wrong." << endl;
+    return false;
+  }
+  return true;
+}
+
+int main() {
+  bool success = TestEditsAgree() && TestClaimFromThreads();
+  cout << errors << " errors." << endl;
+  return !success;
+}
@@ -0,0 +1,125 @@
+#include "fuzzy-match.h"
+#include <ctype.h>
+#include <limits.h>
+
+using std::max;
+
+// What's about as bad as a score can be, without overflowing when added to.
+static const int kNoScore = INT_MIN / 2;
+
+// Only ASCII letters are folded, which needs no call into the locale.
+static inline char Lower(char c) {
+  return static_cast<unsigned char>(c - 'A') < 26u ? c + ('a' - 'A') : c;
+}
+
+// The bonus for matching text[i], from what comes before it.
+static int BonusAt(const string& text, int i) {
+  unsigned char c = text[i];
+  if (!isalnum(c)) {
+    return 0;
+  }
+  if (i == 0) {
+    return FuzzyMatcher::kBonusBoundary;
+  }
+  unsigned char prev = text[i - 1];
+  if (!isalnum(prev)) {
+    return FuzzyMatcher::kBonusBoundary;
+  }
+  if ((islower(prev) && isupper(c)) || (isalpha(prev) && isdigit(c))) {
+    return FuzzyMatcher::kBonusCamelCase;
+  }
+  return 0;
+}
+
+FuzzyMatcher::FuzzyMatcher(const string& pattern) : pattern_(pattern) {
+  for (int i = 0; i < pattern_.size(); ++i) {
+    pattern_[i] = Lower(pattern_[i]);
+  }
+}
+
+bool FuzzyMatcher::Match(const string& text, int* score) const {
+  int m = pattern_.size();
+  int n = text.size();
+  *score = 0;
+  if (m == 0) {
+    return true;
+  }
+
+  // Most texts don't contain the pattern at all, which one pass tells.  The
+  // pattern can't start before where it first fits, or end after where it
+  // last fits.
+  int start = -1;
+  int p = 0;
+  for (int j = 0; j < n && p < m; ++j) {
+    if (Lower(text[j]) == pattern_[p]) {
+      if (p == 0) {
+        start = j;
+      }
+      ++p;
+    }
+  }
+  if (p < m) {
+    return false;
+  }
+  int end = n;
+  for (int j = n - 1, q = m - 1; q >= 0; --j) {
+    if (Lower(text[j]) == pattern_[q]) {
+      if (q == m - 1) {
+        end = j + 1;
+      }
+      --q;
+    }
+  }
+
+  // Row i holds the best score of matching the pattern up to its letter i
+  // with that letter at each place in the text, and the bonus the run of
+  // consecutive letters it ends started with.  Only the last row is needed
+  // for the next, so two of each are swapped, all in one allocation.
+  int width = end - start;
+  vector<int> rows(5 * width);
+  int* bonus = &rows[0];
+  int* last = bonus + width;
+  int* row = last + width;
+  int* last_run_bonus = row + width;
+  int* run_bonus = last_run_bonus + width;
+  for (int j = 0; j < width; ++j) {
+    bonus[j] = BonusAt(text, start + j);
+    last[j] = kNoScore;
+  }
+  for (int i = 0; i < m; ++i) {
+    // The best score of the letters before this one followed by a gap that
+    // reaches up to j.
+    int gap = kNoScore;
+    for (int j = 0; j < width; ++j) {
+      if (j >= 2) {
+        gap = max(gap + kScoreGapExtension, last[j - 2] + kScoreGapStart);
+      }
+      row[j] = kNoScore;
+      if (Lower(text[start + j]) != pattern_[i]) {
+        continue;
+      }
+      if (i == 0) {
+        row[j] = kScoreMatch + bonus[j] * kBonusFirstCharMultiplier;
+        run_bonus[j] = bonus[j];
+        continue;
+      }
+      if (j >= 1 && last[j - 1] > kNoScore) {
+        run_bonus[j] = max(last_run_bonus[j - 1], bonus[j]);
+        row[j] = last[j - 1] + kScoreMatch +
+                 max(run_bonus[j], static_cast<int>(kBonusConsecutive));
+      }
+      if (gap > kNoScore && gap + kScoreMatch + bonus[j] > row[j]) {
+        row[j] = gap + kScoreMatch + bonus[j];
+        run_bonus[j] = bonus[j];
+      }
+    }
+    std::swap(last, row);
+    std::swap(last_run_bonus, run_bonus);
+  }
+
+  *score = kNoScore;
+  for (int j = 0; j < width; ++j) {
+    *score = max(*score, last[j]);
+  }
+  return true;
+}
@@ -0,0 +1,101 @@
+#ifndef FUZZY_MATCH_H_
+#define FUZZY_MATCH_H_
+
+// Scores texts against a pattern whose letters they contain in order, not
+// necessarily together, the way fzf does:
+//
+//   FuzzyMatcher matcher("cfgpar");
+//   int score;
+//   if (matcher.Match("config-parser.cc", &score)) ...
+//
+// Case is ignored.  Every matched letter scores, letters at the start of a
+// word or right after the one before score more, and skipped letters cost a
+// little.  Of all the ways the pattern can be laid over a text, the best one
+// counts.
+//
+// TopK keeps the best few of many scored values, and those from several
+// threads can be merged:
+//
+//   TopK<FuzzyResult> best(20);
+//   best.Offer(result);
+//   ...
+//   vector<FuzzyResult> ranked;
+//   best.Sorted(&ranked);
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+class FuzzyMatcher {
+ public:
+  explicit FuzzyMatcher(const string& pattern);
+
+  const string& Pattern() const { return pattern_; }
+
+  // Whether text contains the pattern's letters in order, and if so how well
+  // they fit it.  Higher scores are better.
+  bool Match(const string& text, int* score) const;
+
+  static const int kScoreMatch = 16;
+  static const int kScoreGapStart = -3;
+  static const int kScoreGapExtension = -1;
+  // For a letter after a space or punctuation, or at the very start.
+  static const int kBonusBoundary = 8;
+  // For a capital after a small letter, or a digit after a letter.
+  static const int kBonusCamelCase = 7;
+  // For each letter right after the one matched before it.
+  static const int kBonusConsecutive = 4;
+  // The pattern's first letter counts its bonus this many times.
+  static const int kBonusFirstCharMultiplier = 2;
+
+ private:
+  // The pattern in lower case.
+  string pattern_;
+};
+
+// The k smallest values offered, by operator<, so values should compare less
+// when they're better.
+template <class T>
+class TopK {
+ public:
+  explicit TopK(int k) : k_(k) {}
+
+  void Offer(const T& value) {
+    if (k_ <= 0) {
+      return;
+    }
+    if (heap_.size() < k_) {
+      heap_.push_back(value);
+      push_heap(heap_.begin(), heap_.end());
+    } else if (value < heap_.front()) {
+      // The front is the worst value kept.
+      pop_heap(heap_.begin(), heap_.end());
+      heap_.back() = value;
+      push_heap(heap_.begin(), heap_.end());
+    }
+  }
+
+  void Merge(const TopK& other) {
+    for (int i = 0; i < other.heap_.size(); ++i) {
+      Offer(other.heap_[i]);
+    }
+  }
+
+  int Size() const { return heap_.size(); }
+
+  // What's kept, best first.
+  void Sorted(vector<T>* values) const {
+    values->assign(heap_.begin(), heap_.end());
+    sort(values->begin(), values->end());
+  }
+
+ private:
+  int k_;
+  // A max heap, so the worst value is the one to drop.
+  vector<T> heap_;
+};
+
+#endif  // FUZZY_MATCH_H_
@@ -0,0 +1,84 @@
+#include "fuzzy-match.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static int errors = 0;
+
+ostream& ERROR() {
+  ++errors;
+  cout << "Error: ";
+  return cout;
+}
+
+int ScoreOf(const string& pattern, const string& text) {
+  int score;
+  if (!FuzzyMatcher(pattern).Match(text, &score)) {
+    return -1;
+  }
+  return score;
+}
+
+// Checks pattern matches better_text better than worse_text.
+bool RanksAbove(const string& pattern, const string& better_text,
+                const string& worse_text) {
+  int better = ScoreOf(pattern, better_text);
+  int worse = ScoreOf(pattern, worse_text);
+  if (better <= worse) {
+    ERROR() << "\"" << pattern << "\" scored " << better << " in \""
+            << better_text << "\" but " << worse << " in \"" << worse_text
+            << "\"." << endl;
+    return false;
+  }
+  return true;
+}
+
+bool TestMatching() {
+  cout << "Testing which texts match" << endl;
+  int score;
+  FuzzyMatcher matcher("BkUp");
+  if (!matcher.Match("Back up the laptop", &score) ||
+      !matcher.Match("bkup", &score) || matcher.Match("Backpack", &score) ||
+      matcher.Match("upbk", &score) || !FuzzyMatcher("").Match("", &score)) {
+    ERROR() << "Texts were matched wrong." << endl;
+    return false;
+  }
+  return true;
+}
+
+bool TestRanking() {
+  cout << "Testing ranking matches" << endl;
+  return RanksAbove("milk", "Buy milk", "Make it look nice") &&
+         RanksAbove("bm", "Buy milk", "Submit form") &&
+         RanksAbove("fix", "Fix the bike", "Refix the bike") &&
+         RanksAbove("tp", "Release / Tag the packages", "Release / Tidy up") &&
+         RanksAbove("parser", "ConfigParser", "Config sparser") &&
+         // The best way to lay the pattern over the text counts, not the
+         // first one found.
+         RanksAbove("ab", "a xx ab", "a xx a xx b");
+}
+
+bool TestTopK() {
+  cout << "Testing keeping the best few values" << endl;
+  TopK<int> evens(3);
+  TopK<int> odds(3);
+  for (int i = 20; i > 0; --i) {
+    (i % 2 ? odds : evens).Offer(i);
+  }
+  evens.Merge(odds);
+  vector<int> best;
+  evens.Sorted(&best);
+  if (best.size() != 3 || best[0] != 1 || best[1] != 2 || best[2] != 3) {
+    ERROR() << "Kept the wrong values." << endl;
+    return false;
+  }
+  return true;
+}
+
+int main() {
+  bool success = TestMatching() && TestRanking() && TestTopK();
+  cout << errors << " errors." << endl;
+  return !success;
+}
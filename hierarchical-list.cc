@@ -2,6 +2,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 #include "dialog-box.h"
 #include "utils.h"
 
@@ -27,6 +28,7 @@ HierarchicalList::HierarchicalList(string& name, int height, int width, int y,
   indent_ = 2;
   name_ = name;
   selected_item_ = NULL;
+  last_marked_item_ = NULL;
   prepend_ = "- ";
   flush_left_text_border_ = true;
   draw_column_headers_ = true;
@@ -43,6 +45,7 @@ HierarchicalList::~HierarchicalList() {
 }
 
 void HierarchicalList::SetDatasource(HierarchicalListDataSource* d) {
+  ClearMarks();
   datasource_ = d;
   UpdateFlattenedItems();
 }
@@ -167,16 +170,18 @@ int HierarchicalList::Draw(ListItem* node, int line_num, int indent) {
     int curx = !c ? indent : 0;  // Only indent the first column
     int cury = line_num;
 
-    // If we're selected reverse the text
+    // If we're selected reverse the text, and marked items are bold.
+    int attrs = node->ListColor();
+    if (IsMarked(node)) {
+      attrs |= A_BOLD;
+    }
     if (node == selected_item_) {
-      int attrs = A_UNDERLINE | node->ListColor();
+      attrs |= A_UNDERLINE;
       if (c == selected_column_) {
         attrs |= A_REVERSE;
       }
-      wattron(column, attrs);
-    } else {
-      wattron(column, node->ListColor());
     }
+    wattron(column, attrs);
 
     int lines_used = 1;
     int column_width = CursesUtils::winwidth(column);
@@ -193,16 +198,7 @@ int HierarchicalList::Draw(ListItem* node, int line_num, int indent) {
       mvwaddch(column, cury, curx++, text.c_str()[i]);
     }
 
-    // If we're selected, we're done reversing the text.
-    if (node == selected_item_) {
-      int attrs = A_UNDERLINE | node->ListColor();
-      if (c == selected_column_) {
-        attrs |= A_REVERSE;
-      }
-      wattroff(column, attrs);
-    } else {
-      wattroff(column, node->ListColor());
-    }
+    wattroff(column, attrs);
     if (lines_used > max_lines_used) {
       max_lines_used = lines_used;
     }
@@ -341,14 +337,17 @@ void HierarchicalList::ScrollToBottom() {
   }
 }
 
-int HierarchicalList::NumLinesDownInList(ListItem* item) {
-  int d = 0;
-  for (int i = 0; i < flattened_items_.size(); ++i) {
-    if (item == flattened_items_[i]) break;
-    d += flattened_items_[i]->Height();
+void HierarchicalList::ScrollToItem(ListItem* item) {
+  if (item != NULL && IsFlattened(item)) {
+    SelectItem(item->Index(), SCROLL_TOP);
   }
+}
 
-  return d;
+int HierarchicalList::NumLinesDownInList(ListItem* item) {
+  if (!IsFlattened(item)) {
+    return total_lines_;
+  }
+  return LinesAbove(item->Index());
 }
 
 void HierarchicalList::SelectItem(int item_index, ScrollType type) {
@@ -506,6 +505,46 @@ void HierarchicalList::ToggleExpansionOfSelectedItem() {
   }
 }
 
+void HierarchicalList::ToggleMarkOfSelectedItem() {
+  if (selected_item_ == NULL) return;
+  if (IsMarked(selected_item_)) {
+    marked_items_.erase(selected_item_);
+    last_marked_item_ = NULL;
+  } else {
+    marked_items_.insert(selected_item_);
+    last_marked_item_ = selected_item_;
+  }
+}
+
+void HierarchicalList::MarkToSelectedItem() {
+  if (selected_item_ == NULL) return;
+  if (last_marked_item_ == NULL || !IsFlattened(last_marked_item_)) {
+    ToggleMarkOfSelectedItem();
+    return;
+  }
+  int from = std::min(last_marked_item_->Index(), selected_item_->Index());
+  int to = std::max(last_marked_item_->Index(), selected_item_->Index());
+  for (int i = from; i <= to; ++i) {
+    marked_items_.insert(flattened_items_[i]);
+  }
+  last_marked_item_ = selected_item_;
+}
+
+void HierarchicalList::ClearMarks() {
+  marked_items_.clear();
+  last_marked_item_ = NULL;
+}
+
+vector<ListItem*> HierarchicalList::MarkedItems() {
+  vector<ListItem*> marked;
+  for (int i = 0; i < flattened_items_.size(); ++i) {
+    if (IsMarked(flattened_items_[i])) {
+      marked.push_back(flattened_items_[i]);
+    }
+  }
+  return marked;
+}
+
 void HierarchicalList::UpdateFlattenedItems() {
   // Do a pre-order traversal of the item tree and add them in that order to our
   // vector.
@@ -513,7 +552,7 @@ void HierarchicalList::UpdateFlattenedItems() {
   total_lines_ = 0;
 
   for (int i = 0; i < NumRoots(); ++i) {
-    PreOrderAddToList(Root(i));
+    PreOrderAddToList(Root(i), &flattened_items_);
   }
 
   for (int i = 0; i < flattened_items_.size(); ++i) {
@@ -524,39 +563,132 @@ void HierarchicalList::UpdateFlattenedItems() {
   item_for_line_.clear();
   for (int i = 0; i < flattened_items_.size(); ++i) {
     ListItem* item = flattened_items_[i];
-
-    // Figure out how much space we have for each column this list item will
-    // draw in.  We want the height of the whole list item to be the max of the
-    // heights it takes up in every column.
-    int height = 1;
-    for (int c = 0; c < columns_.size(); ++c) {
-      int testing_width = CursesUtils::winwidth(columns_[c]);
-      int prepend_size = 0;
-      if (!c) {
-        testing_width -= item->Depth() * indent_;
-        prepend_size = prepend_.size();
-      }
-      string text = "";
-      if (!c) {
-        text += prepend_;
-      }
-      text += item->TextForColumn(column_names_[c]);
-      int height_in_col_c =
-          StrUtils::HeightOfTextInWidth(testing_width, text, prepend_size);
-      if (height_in_col_c > height) {
-        height = height_in_col_c;
-      }
-    }
-    item->SetHeight(height);
-    for (int j = 0; j < height; ++j) {
+    item->SetHeight(HeightOfItem(item));
+    for (int j = 0; j < item->Height(); ++j) {
       item_for_line_.push_back(item);
     }
     total_lines_ += item->Height();
   }
 }
 
-void HierarchicalList::PreOrderAddToList(ListItem* l) {
-  flattened_items_.push_back(l);
+void HierarchicalList::UpdateItem(ListItem* item) {
+  // Find the range of flattened items that item's subtree currently takes up,
+  // if it's in the list at all.
+  int old_begin = -1;
+  int old_end = -1;
+  int old_first_line = 0;
+  int old_lines = 0;
+  if (IsFlattened(item)) {
+    old_begin = item->Index();
+    old_end = SubtreeEnd(old_begin);
+    old_first_line = LinesAbove(old_begin);
+    old_lines = LinesAbove(old_end) - old_first_line;
+  }
+  bool should_be_flattened = ShouldBeFlattened(item);
+  if (old_begin < 0 && !should_be_flattened) {
+    return;
+  }
+
+  // The item may have moved, so work out where it belongs now.  That's
+  // computed with the old range still in place, so shift it to account for
+  // the old range going away.
+  int new_begin = 0;
+  int new_first_line = 0;
+  vector<ListItem*> items;
+  vector<ListItem*> lines;
+  if (should_be_flattened) {
+    new_begin = InsertionIndex(item, old_begin, old_end);
+    new_first_line = LinesAbove(new_begin);
+    if (old_begin >= 0 && new_begin >= old_end) {
+      new_begin -= old_end - old_begin;
+      new_first_line -= old_lines;
+    }
+    PreOrderAddToList(item, &items);
+    for (int i = 0; i < items.size(); ++i) {
+      items[i]->SetHeight(HeightOfItem(items[i]));
+      lines.insert(lines.end(), items[i]->Height(), items[i]);
+    }
+  }
+
+  int first_moved = old_begin;
+  if (old_begin >= 0 && should_be_flattened && new_begin == old_begin) {
+    // Still in the same place, as after most edits, so only the range itself
+    // changes.
+    Splice(&flattened_items_, old_begin, old_end - old_begin, items);
+    Splice(&item_for_line_, old_first_line, old_lines, lines);
+  } else {
+    vector<ListItem*> none;
+    if (old_begin >= 0) {
+      Splice(&flattened_items_, old_begin, old_end - old_begin, none);
+      Splice(&item_for_line_, old_first_line, old_lines, none);
+    }
+    if (should_be_flattened) {
+      Splice(&flattened_items_, new_begin, 0, items);
+      Splice(&item_for_line_, new_first_line, 0, lines);
+      first_moved = old_begin < 0 ? new_begin : std::min(old_begin, new_begin);
+    }
+  }
+  total_lines_ += static_cast<int>(lines.size()) - old_lines;
+
+  // Items past both ranges only moved if the list got longer or shorter.
+  int end_moved = flattened_items_.size();
+  if (old_end - old_begin == items.size()) {
+    end_moved = std::max(old_end, new_begin + static_cast<int>(items.size()));
+  }
+  for (int i = first_moved; i < end_moved; ++i) {
+    flattened_items_[i]->SetIndex(i);
+  }
+
+  // The selected item may have moved, possibly out of the window, or be gone
+  // altogether.
+  if (selected_item_ != NULL) {
+    if (IsFlattened(selected_item_)) {
+      selected_line_ = NumLinesDownInList(selected_item_);
+      if (selected_line_ < top_line_) {
+        SelectItem(selected_item_->Index(), SCROLL_TOP);
+      } else if (selected_line_ + selected_item_->Height() >
+                 top_line_ + column_height_) {
+        SelectItem(selected_item_->Index(), SCROLL_BOTTOM);
+      } else {
+        win_rel_selected_line_ = selected_line_ - top_line_;
+      }
+    } else {
+      SelectNoItem();
+    }
+  }
+}
+
+// Replaces the count items of v starting at begin with replacement.  Only when
+// the two differ in size does the rest of v have to move.
+void HierarchicalList::Splice(vector<ListItem*>* v, int begin, int count,
+                              const vector<ListItem*>& replacement) {
+  int common = std::min(count, static_cast<int>(replacement.size()));
+  std::copy(replacement.begin(), replacement.begin() + common,
+            v->begin() + begin);
+  if (count > common) {
+    v->erase(v->begin() + begin + common, v->begin() + begin + count);
+  } else {
+    v->insert(v->begin() + begin + common, replacement.begin() + common,
+              replacement.end());
+  }
+}
+
+static bool IndexBefore(ListItem* line_item, int item_index) {
+  return line_item->Index() < item_index;
+}
+
+// Returns how many lines the items before item_index take up.  item_for_line_
+// is in the same order as flattened_items_, so that's binary searched for by
+// index.
+int HierarchicalList::LinesAbove(int item_index) {
+  return std::lower_bound(item_for_line_.begin(), item_for_line_.end(),
+                          item_index, IndexBefore) -
+         item_for_line_.begin();
+}
+
+void HierarchicalList::PreOrderAddToList(ListItem* l,
+                                         vector<ListItem*>* items) {
+  items->push_back(l);
   if (l->ListParent() != NULL) {
     l->SetDepth(l->ListParent()->Depth() + 1);
   } else {
@@ -565,9 +697,95 @@ void HierarchicalList::PreOrderAddToList(ListItem* l) {
 
   for (int i = 0; i < l->NumListChildren(); ++i) {
     if (l->ShouldExpand()) {
-      PreOrderAddToList(l->ListChild(i));
+      PreOrderAddToList(l->ListChild(i), items);
+    }
+  }
+}
+
+// Figure out how much space we have for each column this list item will draw
+// in.  We want the height of the whole list item to be the max of the heights
+// it takes up in every column.
+int HierarchicalList::HeightOfItem(ListItem* item) {
+  int height = 1;
+  for (int c = 0; c < columns_.size(); ++c) {
+    int testing_width = CursesUtils::winwidth(columns_[c]);
+    int prepend_size = 0;
+    if (!c) {
+      testing_width -= item->Depth() * indent_;
+      prepend_size = prepend_.size();
+    }
+    string text = "";
+    if (!c) {
+      text += prepend_;
+    }
+    text += item->TextForColumn(column_names_[c]);
+    int height_in_col_c =
+        StrUtils::HeightOfTextInWidth(testing_width, text, prepend_size);
+    if (height_in_col_c > height) {
+      height = height_in_col_c;
+    }
+  }
+  return height;
+}
+
+// Whether item is currently in our list of flattened items.
+bool HierarchicalList::IsFlattened(ListItem* item) {
+  int i = item->Index();
+  return i >= 0 && i < flattened_items_.size() && flattened_items_[i] == item;
+}
+
+// Whether item ought to be in the list, given the datasource as it is now.
+bool HierarchicalList::ShouldBeFlattened(ListItem* item) {
+  ListItem* parent = item->ListParent();
+  if (parent == NULL) {
+    for (int i = 0; i < NumRoots(); ++i) {
+      if (Root(i) == item) return true;
+    }
+    return false;
+  }
+
+  if (!IsFlattened(parent) || !parent->ShouldExpand()) {
+    return false;
+  }
+  for (int i = 0; i < parent->NumListChildren(); ++i) {
+    if (parent->ListChild(i) == item) return true;
+  }
+  return false;
+}
+
+// Returns the index just past the last descendant of the item at item_index.
+int HierarchicalList::SubtreeEnd(int item_index) {
+  int depth = flattened_items_[item_index]->Depth();
+  int end = item_index + 1;
+  while (end < flattened_items_.size() &&
+         flattened_items_[end]->Depth() > depth) {
+    ++end;
+  }
+  return end;
+}
+
+// Returns where item belongs: right before its next flattened sibling, or else
+// right after the rest of its parent's subtree.  Flattened items from
+// skip_begin up to skip_end are about to be removed and so don't count, even if
+// a sibling was moved out from among them.
+int HierarchicalList::InsertionIndex(ListItem* item, int skip_begin,
+                                     int skip_end) {
+  ListItem* parent = item->ListParent();
+  int num_siblings = parent == NULL ? NumRoots() : parent->NumListChildren();
+  bool after_item = false;
+  for (int i = 0; i < num_siblings; ++i) {
+    ListItem* sibling = parent == NULL ? Root(i) : parent->ListChild(i);
+    if (sibling == item) {
+      after_item = true;
+    } else if (after_item && IsFlattened(sibling)) {
+      int index = sibling->Index();
+      if (index < skip_begin || index >= skip_end) {
+        return index;
+      }
     }
   }
+  return parent == NULL ? flattened_items_.size()
+                        : SubtreeEnd(parent->Index());
 }
 
 ListItem* HierarchicalList::ItemForLineNumber(int n) {
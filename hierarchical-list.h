@@ -2,6 +2,7 @@
 #define HIERARCHICAL_LIST_H_
 
 #include <ncurses.h>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -17,6 +18,7 @@
 // column, the following will achieve that with in_percent set to false:
 //   "Column One:X,Column Two:8,Column Three:X"
 
+using std::set;
 using std::string;
 using std::vector;
 
@@ -48,6 +50,7 @@ class ListItem {
   virtual void ToggleExpanded() {
     if (NumListChildren()) should_expand_ = !should_expand_;
   }
+  virtual void SetExpanded(bool expand) { should_expand_ = expand; }
 
  private:
   int height_;          // How many lines this entry takes up.
@@ -81,6 +84,11 @@ class HierarchicalList {
 
   void Draw();
   void Update() { UpdateFlattenedItems(); }
+
+  // Updates only the lines of |item| and its children after they changed,
+  // including the item appearing in or disappearing from the list.  The rest
+  // of the list must be unchanged.
+  void UpdateItem(ListItem* item);
   void SelectPrevItem();
   void SelectNextItem();
 
@@ -90,6 +98,8 @@ class HierarchicalList {
   void ScrollToTop();
   void ScrollToBottom();
   void SelectNoItem() { SelectItem(-1); }
+  // Selects item and scrolls it to the top, if it's in the list.
+  void ScrollToItem(ListItem* item);
   void SelectNextColumn() { ++selected_column_ %= columns_.size(); }
 
   void EditSelectedItem();
@@ -102,10 +112,30 @@ class HierarchicalList {
 
   void ToggleExpansionOfSelectedItem();
 
+  // Items can be marked so that one operation can be applied to all of them.
+  // MarkToSelectedItem() marks every item between the last one marked and the
+  // selected one.  Marks don't survive the items they're on going away, so
+  // clear them before that can happen.
+  void ToggleMarkOfSelectedItem();
+  void MarkToSelectedItem();
+  void ClearMarks();
+  bool HasMarks() { return !marked_items_.empty(); }
+  bool IsMarked(ListItem* item) { return marked_items_.count(item) > 0; }
+  // The marked items currently in the list, in list order.
+  vector<ListItem*> MarkedItems();
+
  private:
   int Draw(ListItem* node, int line_num, int indent);
   void UpdateFlattenedItems();
-  void PreOrderAddToList(ListItem* l);
+  void PreOrderAddToList(ListItem* l, vector<ListItem*>* items);
+  int HeightOfItem(ListItem* item);
+  bool IsFlattened(ListItem* item);
+  bool ShouldBeFlattened(ListItem* item);
+  int SubtreeEnd(int item_index);
+  int LinesAbove(int item_index);
+  static void Splice(vector<ListItem*>* v, int begin, int count,
+                     const vector<ListItem*>& replacement);
+  int InsertionIndex(ListItem* item, int skip_begin, int skip_end);
   ListItem* ItemForLineNumber(int n);
   int NumLinesDownInList(ListItem* item);
   void SelectItem(int item_index);
@@ -153,6 +183,9 @@ class HierarchicalList {
 
   ListItem* selected_item_;
 
+  set<ListItem*> marked_items_;
+  ListItem* last_marked_item_;
+
   // The datasource tells us such things as how many roots we have, how many
   // columns to draw and what data corresponds with which column.
   HierarchicalListDataSource* datasource_;
@@ -0,0 +1,166 @@
+#include "id-bitmap.h"
+#include <algorithm>
+
+// As in string-search.cc, the AVX2 kernels are compiled for it one function
+// at a time, so the rest of the program runs on any x86 CPU.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+IdBitmap::IdBitmap(int size)
+    : words_((size + kWordBits - 1) / kWordBits), size_(size) {}
+
+void IdBitmap::Resize(int size) {
+  words_.resize((size + kWordBits - 1) / kWordBits);
+  size_ = size;
+  ClearTail();
+}
+
+void IdBitmap::Swap(IdBitmap* other) {
+  words_.swap(other->words_);
+  std::swap(size_, other->size_);
+}
+
+void IdBitmap::SetAll() {
+  words_.assign(words_.size(), ~static_cast<uint64_t>(0));
+  ClearTail();
+}
+
+void IdBitmap::ClearAll() { words_.assign(words_.size(), 0); }
+
+int IdBitmap::Next(int from) const {
+  if (from >= size_) {
+    return -1;
+  }
+  int w = from / kWordBits;
+  uint64_t word = words_[w] & (~static_cast<uint64_t>(0) << (from % kWordBits));
+  while (word == 0) {
+    if (++w == words_.size()) {
+      return -1;
+    }
+    word = words_[w];
+  }
+  return w * kWordBits + __builtin_ctzll(word);
+}
+
+int IdBitmap::Count() const {
+  int count = 0;
+  for (int w = 0; w < words_.size(); ++w) {
+    count += __builtin_popcountll(words_[w]);
+  }
+  return count;
+}
+
+bool IdBitmap::Any() const {
+  for (int w = 0; w < words_.size(); ++w) {
+    if (words_[w] != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void IdBitmap::ClearTail() {
+  if (size_ % kWordBits != 0) {
+    words_.back() &= Bit(size_) - 1;
+  }
+}
+
+static void AndScalar(uint64_t* words, const uint64_t* other, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    words[i] &= other[i];
+  }
+}
+
+static void OrScalar(uint64_t* words, const uint64_t* other, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    words[i] |= other[i];
+  }
+}
+
+static void AndNotScalar(uint64_t* words, const uint64_t* other, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    words[i] &= ~other[i];
+  }
+}
+
+#ifdef HAVE_X86_KERNELS
+
+// Each does four words at a time, and the rest one at a time.
+__attribute__((target("avx2"))) static void AndAvx2(uint64_t* words,
+                                                     const uint64_t* other,
+                                                     size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i* out = reinterpret_cast<__m256i*>(words + i);
+    __m256i a = _mm256_loadu_si256(out);
+    __m256i b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(other + i));
+    _mm256_storeu_si256(out, _mm256_and_si256(a, b));
+  }
+  AndScalar(words + i, other + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void OrAvx2(uint64_t* words,
+                                                    const uint64_t* other,
+                                                    size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i* out = reinterpret_cast<__m256i*>(words + i);
+    __m256i a = _mm256_loadu_si256(out);
+    __m256i b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(other + i));
+    _mm256_storeu_si256(out, _mm256_or_si256(a, b));
+  }
+  OrScalar(words + i, other + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void AndNotAvx2(uint64_t* words,
+                                                        const uint64_t* other,
+                                                        size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i* out = reinterpret_cast<__m256i*>(words + i);
+    __m256i a = _mm256_loadu_si256(out);
+    __m256i b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(other + i));
+    // _mm256_andnot_si256(x, y) is ~x & y.
+    _mm256_storeu_si256(out, _mm256_andnot_si256(b, a));
+  }
+  AndNotScalar(words + i, other + i, n - i);
+}
+
+#endif  // HAVE_X86_KERNELS
+
+IdBitmap::Kernel IdBitmap::BestKernel() {
+#ifdef HAVE_X86_KERNELS
+  static const Kernel best = __builtin_cpu_supports("avx2") ? AVX2 : SCALAR;
+  return best;
+#else
+  return SCALAR;
+#endif
+}
+
+bool IdBitmap::Supports(Kernel kernel) { return kernel <= BestKernel(); }
+
+IdBitmap::WordFunction IdBitmap::FunctionFor(Kernel kernel, Op op) {
+  static const WordFunction kScalar[NUM_OPS] = {AndScalar, OrScalar,
+                                                AndNotScalar};
+#ifdef HAVE_X86_KERNELS
+  static const WordFunction kAvx2[NUM_OPS] = {AndAvx2, OrAvx2, AndNotAvx2};
+  if (kernel == AVX2) {
+    return kAvx2[op];
+  }
+#endif
+  return kScalar[op];
+}
+
+void IdBitmap::CombineWith(Kernel kernel, Op op, const IdBitmap& other) {
+  size_t shared = std::min(words_.size(), other.words_.size());
+  FunctionFor(kernel, op)(words_.data(), other.words_.data(), shared);
+  if (op == AND) {
+    std::fill(words_.begin() + shared, words_.end(), 0);
+  }
+  ClearTail();
+}
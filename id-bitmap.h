@@ -0,0 +1,90 @@
+#ifndef ID_BITMAP_H_
+#define ID_BITMAP_H_
+
+// A set of small ids, such as task ids, as one bit each.  Sets are combined a
+// word at a time, or four with AVX2 where the CPU has it:
+//
+//   IdBitmap open(num_tasks);
+//   ...
+//   open.And(recent);
+//   for (int id = open.Next(0); id >= 0; id = open.Next(id + 1)) {
+//     ...
+//   }
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+using std::vector;
+
+class IdBitmap {
+ public:
+  // How words are combined.  Later ones are faster.
+  enum Kernel { SCALAR, AVX2, NUM_KERNELS };
+
+  IdBitmap() : size_(0) {}
+  // Holds ids 0 to size - 1, none of them set.
+  explicit IdBitmap(int size);
+
+  int Size() const { return size_; }
+  // Ids added are clear, and ids taken away are forgotten.
+  void Resize(int size);
+  void Swap(IdBitmap* other);
+
+  // Ids past the end are never set.
+  bool Test(int id) const {
+    return id < size_ && (words_[id / kWordBits] >> (id % kWordBits)) & 1;
+  }
+  void Set(int id) { words_[id / kWordBits] |= Bit(id); }
+  void Clear(int id) { words_[id / kWordBits] &= ~Bit(id); }
+  void Assign(int id, bool set) {
+    if (set) {
+      Set(id);
+    } else {
+      Clear(id);
+    }
+  }
+  void SetAll();
+  void ClearAll();
+
+  // The first id set at or after from, or -1 if there isn't one.
+  int Next(int from) const;
+  int Count() const;
+  bool Any() const;
+
+  // Combine this with other, keeping this's size.  Ids past the end of other
+  // count as clear in it.
+  void And(const IdBitmap& other) { CombineWith(BestKernel(), AND, other); }
+  void Or(const IdBitmap& other) { CombineWith(BestKernel(), OR, other); }
+  void AndNot(const IdBitmap& other) {
+    CombineWith(BestKernel(), AND_NOT, other);
+  }
+
+  size_t MemoryUsage() const { return words_.capacity() * sizeof(uint64_t); }
+
+  // The fastest kernel this CPU can run, and whether it can run kernel.
+  static Kernel BestKernel();
+  static bool Supports(Kernel kernel);
+
+  enum Op { AND, OR, AND_NOT, NUM_OPS };
+  void CombineWith(Kernel kernel, Op op, const IdBitmap& other);
+
+ private:
+  typedef void (*WordFunction)(uint64_t* words, const uint64_t* other,
+                               size_t n);
+  static WordFunction FunctionFor(Kernel kernel, Op op);
+
+  static const int kWordBits = 64;
+
+  static uint64_t Bit(int id) {
+    return static_cast<uint64_t>(1) << (id % kWordBits);
+  }
+  // Keeps the bits past size_ in the last word clear, so whole words can be
+  // counted and searched.
+  void ClearTail();
+
+  vector<uint64_t> words_;
+  int size_;
+};
+
+#endif  // ID_BITMAP_H_
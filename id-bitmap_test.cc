@@ -0,0 +1,117 @@
+#include "id-bitmap.h"
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+static int errors = 0;
+
+ostream& ERROR() {
+  ++errors;
+  cout << "Error: ";
+  return cout;
+}
+
+// Sets each id with odds one in every.
+IdBitmap RandomBitmap(int size, int every, vector<bool>* flags) {
+  IdBitmap bits(size);
+  flags->assign(size, false);
+  for (int id = 0; id < size; ++id) {
+    if (rand() % every == 0) {
+      bits.Set(id);
+      (*flags)[id] = true;
+    }
+  }
+  return bits;
+}
+
+// Whether bits has exactly the ids flagged, by every way of looking.
+bool Holds(const IdBitmap& bits, const vector<bool>& flags) {
+  if (bits.Size() != flags.size()) {
+    return false;
+  }
+  int count = 0;
+  int next = bits.Next(0);
+  for (int id = 0; id < flags.size(); ++id) {
+    if (bits.Test(id) != flags[id]) {
+      return false;
+    }
+    if (flags[id]) {
+      if (next != id) {
+        return false;
+      }
+      next = bits.Next(id + 1);
+      ++count;
+    }
+  }
+  return next == -1 && bits.Count() == count && bits.Any() == (count > 0) &&
+         !bits.Test(flags.size());
+}
+
+bool TestSetAndFind() {
+  cout << "Testing setting and finding ids" << endl;
+  IdBitmap bits(130);
+  bits.Set(0);
+  bits.Set(64);
+  bits.Set(129);
+  bits.Assign(64, false);
+  if (bits.Next(0) != 0 || bits.Next(1) != 129 || bits.Next(130) != -1 ||
+      bits.Count() != 2 || bits.Test(64) || bits.Test(1000)) {
+    ERROR() << "The wrong ids were set." << endl;
+    return false;
+  }
+  // Shrinking forgets ids, and growing doesn't bring them back.
+  bits.Resize(100);
+  bits.Resize(200);
+  bits.SetAll();
+  bits.Resize(65);
+  if (bits.Count() != 65 || bits.Next(64) != 64) {
+    ERROR() << "Resizing kept the wrong ids." << endl;
+    return false;
+  }
+  return true;
+}
+
+bool TestKernelsAgree() {
+  cout << "Testing every kernel combines the same way" << endl;
+  srand(46);
+  for (int round = 0; round < 2000; ++round) {
+    // Sizes that leave a tail of words, and of bits, and that differ.
+    int size = rand() % 700;
+    int other_size = rand() % 2 ? size : rand() % 700;
+    vector<bool> flags;
+    vector<bool> other_flags;
+    IdBitmap bits = RandomBitmap(size, 1 + rand() % 4, &flags);
+    IdBitmap other = RandomBitmap(other_size, 1 + rand() % 4, &other_flags);
+    for (int op = 0; op < IdBitmap::NUM_OPS; ++op) {
+      vector<bool> expected(size);
+      for (int id = 0; id < size; ++id) {
+        bool in_other = id < other_size && other_flags[id];
+        expected[id] = op == IdBitmap::AND  ? flags[id] && in_other
+                       : op == IdBitmap::OR ? flags[id] || in_other
+                                            : flags[id] && !in_other;
+      }
+      for (int k = 0; k < IdBitmap::NUM_KERNELS; ++k) {
+        IdBitmap::Kernel kernel = static_cast<IdBitmap::Kernel>(k);
+        if (!IdBitmap::Supports(kernel)) {
+          continue;
+        }
+        IdBitmap combined = bits;
+        combined.CombineWith(kernel, static_cast<IdBitmap::Op>(op), other);
+        if (!Holds(combined, expected)) {
+          ERROR() << "Kernel " << k << " got op " << op << " of " << size
+                  << " and " << other_size << " ids wrong." << endl;
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+int main() {
+  bool success = TestSetAndFind() && TestKernelsAgree();
+  cout << errors << " errors." << endl;
+  return !success;
+}
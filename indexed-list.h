@@ -0,0 +1,224 @@
+#ifndef INDEXED_LIST_H_
+#define INDEXED_LIST_H_
+
+// An ordered list that supports finding, inserting, removing and moving items
+// by position in O(log n) time.  It is kept as a treap ordered by position, and
+// every item lives in a node that stays put for as long as the item is in the
+// list, so holding on to an item's node is enough to find out where it is:
+//
+//   IndexedList<Task*> tasks;
+//   IndexedList<Task*>::Node* n = tasks.Insert(0, t);
+//   tasks.Move(n, tasks.Size() - 1);
+//   int where = IndexedList<Task*>::IndexOf(n);
+//
+// Walking the whole list in order is linear:
+//
+//   for (Node* n = tasks.First(); n != NULL; n = IndexedList<Task*>::Next(n))
+
+#include <stddef.h>
+#include <vector>
+
+using std::vector;
+
+template <class T>
+class IndexedList {
+ public:
+  class Node {
+   public:
+    T Value() const { return value_; }
+
+   private:
+    friend class IndexedList<T>;
+    Node(T value, unsigned int priority)
+        : value_(value),
+          left_(NULL),
+          right_(NULL),
+          parent_(NULL),
+          size_(1),
+          priority_(priority) {}
+
+    T value_;
+    Node* left_;
+    Node* right_;
+    Node* parent_;
+    int size_;
+    unsigned int priority_;
+  };
+
+  IndexedList() : root_(NULL), seed_(2463534242u) {}
+  ~IndexedList() { Clear(); }
+
+  int Size() const { return SizeOf(root_); }
+  bool Empty() const { return root_ == NULL; }
+  T At(int i) const { return NodeAt(i)->value_; }
+
+  Node* NodeAt(int i) const {
+    Node* n = root_;
+    while (SizeOf(n->left_) != i) {
+      if (i < SizeOf(n->left_)) {
+        n = n->left_;
+      } else {
+        i -= SizeOf(n->left_) + 1;
+        n = n->right_;
+      }
+    }
+    return n;
+  }
+
+  // Puts value at position i and returns the node that holds it.
+  Node* Insert(int i, T value) {
+    Node* n = new Node(value, NextPriority());
+    Link(n, i);
+    return n;
+  }
+  Node* PushBack(T value) { return Insert(Size(), value); }
+
+  // n must be a node of this list.
+  void Erase(Node* n) {
+    Unlink(n);
+    delete n;
+  }
+
+  // Moves n to position i, counted after n has been taken out.
+  void Move(Node* n, int i) {
+    Unlink(n);
+    Link(n, i);
+  }
+
+  static int IndexOf(const Node* n) {
+    int index = SizeOf(n->left_);
+    for (const Node* c = n; c->parent_ != NULL; c = c->parent_) {
+      if (c == c->parent_->right_) {
+        index += SizeOf(c->parent_->left_) + 1;
+      }
+    }
+    return index;
+  }
+
+  Node* First() const {
+    Node* n = root_;
+    while (n != NULL && n->left_ != NULL) {
+      n = n->left_;
+    }
+    return n;
+  }
+
+  static Node* Next(const Node* n) {
+    if (n->right_ != NULL) {
+      Node* next = n->right_;
+      while (next->left_ != NULL) {
+        next = next->left_;
+      }
+      return next;
+    }
+    while (n->parent_ != NULL && n == n->parent_->right_) {
+      n = n->parent_;
+    }
+    return n->parent_;
+  }
+
+  vector<T> ToVector() const {
+    vector<T> out;
+    out.reserve(Size());
+    for (Node* n = First(); n != NULL; n = Next(n)) {
+      out.push_back(n->value_);
+    }
+    return out;
+  }
+
+  // Frees every node, but not what the values point to.
+  void Clear() {
+    DeleteNodes(root_);
+    root_ = NULL;
+  }
+
+ private:
+  // Not copyable, since nodes are handed out.
+  IndexedList(const IndexedList&);
+  IndexedList& operator=(const IndexedList&);
+
+  static int SizeOf(const Node* n) { return n == NULL ? 0 : n->size_; }
+
+  static void Update(Node* n) {
+    n->size_ = 1 + SizeOf(n->left_) + SizeOf(n->right_);
+    if (n->left_ != NULL) n->left_->parent_ = n;
+    if (n->right_ != NULL) n->right_->parent_ = n;
+  }
+
+  // Splits t into its first k items and the rest.
+  static void Split(Node* t, int k, Node** left, Node** right) {
+    if (t == NULL) {
+      *left = *right = NULL;
+      return;
+    }
+    if (SizeOf(t->left_) < k) {
+      Split(t->right_, k - SizeOf(t->left_) - 1, &t->right_, right);
+      *left = t;
+    } else {
+      Split(t->left_, k, left, &t->left_);
+      *right = t;
+    }
+    Update(t);
+  }
+
+  static Node* Merge(Node* left, Node* right) {
+    if (left == NULL) return right;
+    if (right == NULL) return left;
+    if (left->priority_ > right->priority_) {
+      left->right_ = Merge(left->right_, right);
+      Update(left);
+      return left;
+    }
+    right->left_ = Merge(left, right->left_);
+    Update(right);
+    return right;
+  }
+
+  void Link(Node* n, int i) {
+    Node* left;
+    Node* right;
+    Split(root_, i, &left, &right);
+    root_ = Merge(Merge(left, n), right);
+    root_->parent_ = NULL;
+  }
+
+  void Unlink(Node* n) {
+    Node* parent = n->parent_;
+    Node* replacement = Merge(n->left_, n->right_);
+    if (replacement != NULL) {
+      replacement->parent_ = parent;
+    }
+    if (parent == NULL) {
+      root_ = replacement;
+    } else if (parent->left_ == n) {
+      parent->left_ = replacement;
+    } else {
+      parent->right_ = replacement;
+    }
+    for (Node* p = parent; p != NULL; p = p->parent_) {
+      --p->size_;
+    }
+    n->left_ = n->right_ = n->parent_ = NULL;
+    n->size_ = 1;
+  }
+
+  static void DeleteNodes(Node* n) {
+    if (n == NULL) return;
+    DeleteNodes(n->left_);
+    DeleteNodes(n->right_);
+    delete n;
+  }
+
+  // xorshift; the priorities only need to look random.
+  unsigned int NextPriority() {
+    seed_ ^= seed_ << 13;
+    seed_ ^= seed_ >> 17;
+    seed_ ^= seed_ << 5;
+    return seed_;
+  }
+
+  Node* root_;
+  unsigned int seed_;
+};
+
+#endif  // INDEXED_LIST_H_
@@ -0,0 +1,79 @@
+#include "indexed-list.h"
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+static int errors = 0;
+
+ostream& ERROR() {
+  ++errors;
+  cout << "Error: ";
+  return cout;
+}
+
+typedef IndexedList<int>::Node Node;
+
+// Checks that list holds exactly what expected does, in the same order, and
+// that every node knows its own position.
+bool ListMatches(const IndexedList<int>& list, const vector<int>& expected) {
+  if (list.Size() != expected.size() || list.ToVector() != expected) {
+    ERROR() << "List contents don't match." << endl;
+    return false;
+  }
+  for (int i = 0; i < expected.size(); ++i) {
+    if (list.At(i) != expected[i] ||
+        IndexedList<int>::IndexOf(list.NodeAt(i)) != i) {
+      ERROR() << "Item " << i << " is in the wrong place." << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TestInsertAndErase() {
+  cout << "Testing inserting and erasing" << endl;
+  IndexedList<int> list;
+  vector<int> expected;
+  Node* middle = NULL;
+  for (int i = 0; i < 100; ++i) {
+    Node* n = list.Insert(i / 2, i);
+    expected.insert(expected.begin() + i / 2, i);
+    if (i == 50) middle = n;
+  }
+  if (!ListMatches(list, expected)) return false;
+
+  int index = IndexedList<int>::IndexOf(middle);
+  list.Erase(middle);
+  expected.erase(expected.begin() + index);
+  return ListMatches(list, expected);
+}
+
+bool TestMovesMatchAVector() {
+  cout << "Testing moves match a vector" << endl;
+  srand(1);
+  IndexedList<int> list;
+  vector<Node*> nodes;
+  vector<int> expected;
+  for (int i = 0; i < 500; ++i) {
+    nodes.push_back(list.PushBack(i));
+    expected.push_back(i);
+  }
+
+  for (int step = 0; step < 2000; ++step) {
+    Node* n = nodes[rand() % nodes.size()];
+    int from = IndexedList<int>::IndexOf(n);
+    int to = rand() % expected.size();
+    list.Move(n, to);
+    expected.erase(expected.begin() + from);
+    expected.insert(expected.begin() + to, n->Value());
+  }
+  return ListMatches(list, expected);
+}
+
+int main() {
+  bool success = TestInsertAndErase() && TestMovesMatchAVector();
+  cout << errors << " errors." << endl;
+  return !success;
+}
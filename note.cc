@@ -14,7 +14,7 @@ string Note::Text() { return date_.ToString() + ": " + text_; }
 
 string Note::GetText() { return text_; }
 
-void Note::Serialize(Serializer* s) {
+void Note::Serialize(Serializer* s) const {
   s->WriteString(text_);
   date_.Serialize(s);
 }
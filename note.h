@@ -13,7 +13,7 @@ class Note {
 
   string Text();
   string GetText();
-  void Serialize(Serializer* s);
+  void Serialize(Serializer* s) const;
   void ReadFromSerializer(Serializer* s);
 
  private:
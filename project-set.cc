@@ -0,0 +1,231 @@
+#include "project-set.h"
+#include <utility>
+#include "constants.h"
+#include "file-versions.h"
+#include "fuzzy-match.h"
+#include "project.h"
+#include "serializer.h"
+#include "thread-pool.h"
+
+using std::make_pair;
+using std::pair;
+
+const string ProjectItem::TextForColumn(const string& c) {
+  if (c == "Task") return project_->Name();
+  return "";
+}
+
+int ProjectItem::NumListChildren() { return project_->NumFilteredRoots(); }
+
+ListItem* ProjectItem::ListChild(int c) { return project_->FilteredRoot(c); }
+
+ProjectSet::~ProjectSet() {
+  for (int i = 0; i < items_.size(); ++i) {
+    delete items_[i]->GetProject();
+    delete items_[i];
+  }
+}
+
+static void LoadProject(const string& path, Project** project) {
+  *project = Project::NewProjectFromFile(path);
+}
+
+static void SaveProject(const string& path, Project* project) {
+  Serializer s("", path);
+  s.SetVersion(TASK_ID_VERSION);
+  project->Serialize(&s);
+  s.CloseAll();
+}
+
+int ProjectSet::LoadProjects(const string& dir, const vector<string>& names,
+                             ThreadPool* pool) {
+  vector<Project*> loaded(names.size(), static_cast<Project*>(NULL));
+  for (int i = 0; i < names.size(); ++i) {
+    pool->Schedule(std::bind(LoadProject, dir + names[i], &loaded[i]));
+  }
+  pool->Wait();
+
+  int num_added = 0;
+  for (int i = 0; i < loaded.size(); ++i) {
+    if (loaded[i] != NULL) {
+      AddProject(loaded[i]);
+      ++num_added;
+    }
+  }
+  return num_added;
+}
+
+void ProjectSet::SaveProjects(const string& dir, ThreadPool* pool) {
+  for (int i = 0; i < items_.size(); ++i) {
+    Project* p = items_[i]->GetProject();
+    pool->Schedule(std::bind(SaveProject, dir + p->Name(), p));
+  }
+  pool->Wait();
+}
+
+void ProjectSet::AddProject(Project* p) {
+  ProjectItem* item = new ProjectItem(p);
+  p->SetListParentOfRoots(item);
+  items_.push_back(item);
+}
+
+Project* ProjectSet::FindProject(const string& name) {
+  for (int i = 0; i < items_.size(); ++i) {
+    if (items_[i]->GetProject()->Name() == name) {
+      return items_[i]->GetProject();
+    }
+  }
+  return NULL;
+}
+
+vector<string> ProjectSet::ProjectNames() {
+  vector<string> names;
+  for (int i = 0; i < items_.size(); ++i) {
+    names.push_back(items_[i]->GetProject()->Name());
+  }
+  return names;
+}
+
+ListItem* ProjectSet::ItemForProject(Project* p) {
+  for (int i = 0; i < items_.size(); ++i) {
+    if (items_[i]->GetProject() == p) {
+      return items_[i];
+    }
+  }
+  return NULL;
+}
+
+Project* ProjectSet::ProjectOf(ListItem* item) {
+  if (item == NULL) {
+    return NULL;
+  }
+  // Only projects' lines are at the top of the tree.
+  while (item->ListParent() != NULL) {
+    item = item->ListParent();
+  }
+  return static_cast<ProjectItem*>(item)->GetProject();
+}
+
+Task* ProjectSet::TaskOf(ListItem* item) {
+  if (item == NULL || item->ListParent() == NULL) {
+    return NULL;
+  }
+  return static_cast<Task*>(item);
+}
+
+void ProjectSet::ForEachProject(const function<void(Project*)>& f,
+                                ThreadPool* pool) {
+  for (int i = 0; i < items_.size(); ++i) {
+    pool->Schedule(std::bind(f, items_[i]->GetProject()));
+  }
+  pool->Wait();
+}
+
+// A task FindFuzzy() found, which sorts before the ones it ranks above.
+struct FuzzyFound {
+  int score;
+  int path_size;
+  // Where the task is in the tree, counting every task of every project.
+  int order;
+  Task* task;
+
+  bool operator<(const FuzzyFound& other) const {
+    if (score != other.score) return score > other.score;
+    if (path_size != other.path_size) return path_size < other.path_size;
+    return order < other.order;
+  }
+};
+
+static void AddTasks(Task* t, vector<Task*>* tasks) {
+  tasks->push_back(t);
+  for (Task* c = t->FirstChild(); c != NULL; c = c->NextSibling()) {
+    AddTasks(c, tasks);
+  }
+}
+
+static void AppendPath(Task* t, string* path) {
+  if (t->Parent() != NULL) {
+    AppendPath(t->Parent(), path);
+    path->append(" / ");
+  }
+  path->append(t->Title());
+}
+
+// The tasks are in tree order, so each one's path mostly repeats the last
+// one's.  The tasks the current path runs through are kept with how long the
+// path is up to them, and it's cut back to the new task's parent.
+static void FindFuzzyInChunk(const FuzzyMatcher* matcher,
+                             const vector<Task*>* tasks, int begin, int end,
+                             TopK<FuzzyFound>* best) {
+  string path;
+  vector<pair<Task*, int> > on_path;
+  for (int i = begin; i < end; ++i) {
+    Task* t = (*tasks)[i];
+    while (!on_path.empty() && on_path.back().first != t->Parent()) {
+      on_path.pop_back();
+    }
+    if (on_path.empty()) {
+      path.clear();
+      if (t->Parent() != NULL) {
+        AppendPath(t->Parent(), &path);
+        on_path.push_back(make_pair(t->Parent(), path.size()));
+      }
+    } else {
+      path.resize(on_path.back().second);
+    }
+    if (!on_path.empty()) {
+      path.append(" / ");
+    }
+    path.append(t->Title());
+    on_path.push_back(make_pair(t, path.size()));
+
+    FuzzyFound found;
+    if (matcher->Match(path, &found.score)) {
+      found.path_size = path.size();
+      found.order = i;
+      found.task = t;
+      best->Offer(found);
+    }
+  }
+}
+
+vector<Task*> ProjectSet::FindFuzzy(const string& pattern, int k,
+                                    ThreadPool* pool) {
+  vector<Task*> tasks;
+  for (int i = 0; i < items_.size(); ++i) {
+    for (Task* t = items_[i]->GetProject()->FirstRootTask(); t != NULL;
+         t = t->NextSibling()) {
+      AddTasks(t, &tasks);
+    }
+  }
+
+  // Each chunk keeps its own best, and those are merged at the end.
+  FuzzyMatcher matcher(pattern);
+  int chunk_size = Constants::kFuzzyFindChunkSize;
+  vector<TopK<FuzzyFound> > chunk_best(
+      (tasks.size() + chunk_size - 1) / chunk_size, TopK<FuzzyFound>(k));
+  for (int i = 0; i < chunk_best.size(); ++i) {
+    int end = std::min<int>((i + 1) * chunk_size, tasks.size());
+    pool->Schedule(std::bind(FindFuzzyInChunk, &matcher, &tasks,
+                             i * chunk_size, end, &chunk_best[i]));
+  }
+  pool->Wait();
+
+  TopK<FuzzyFound> best(k);
+  for (int i = 0; i < chunk_best.size(); ++i) {
+    best.Merge(chunk_best[i]);
+  }
+  vector<FuzzyFound> ranked;
+  best.Sorted(&ranked);
+  vector<Task*> found;
+  for (int i = 0; i < ranked.size(); ++i) {
+    found.push_back(ranked[i].task);
+  }
+  return found;
+}
+
+string ProjectSet::TaskPath(Task* t) {
+  string path;
+  AppendPath(t, &path);
+  return path;
+}
@@ -0,0 +1,93 @@
+#ifndef PROJECT_SET_H_
+#define PROJECT_SET_H_
+
+// Every open project, shown as a single tree: each project gets a line of its
+// own with its tasks below it.  Projects are loaded, saved and filtered in
+// parallel on a ThreadPool, since each one only ever touches its own tasks.
+//
+//   ProjectSet projects;
+//   projects.LoadProjects(fm->ProjectDir(), fm->SavedProjectNames(), &pool);
+//   list->SetDatasource(&projects);
+//   ...
+//   Project* p = projects.ProjectOf(list->SelectedItem());
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "hierarchical-list.h"
+#include "task.h"
+
+using std::function;
+using std::string;
+using std::vector;
+
+class Project;
+class ThreadPool;
+
+// The line a project gets in a ProjectSet's tree.
+class ProjectItem : public ListItem {
+ public:
+  explicit ProjectItem(Project* p) : project_(p) {}
+  Project* GetProject() { return project_; }
+
+  // Functions required by list item
+  const string TextForColumn(const string& c);
+  int NumListChildren();
+  ListItem* ListChild(int c);
+  ListItem* ListParent() { return NULL; }
+  void SetListText(const string& text) {}
+  int ListColor() { return A_BOLD; }
+
+ private:
+  Project* project_;
+};
+
+class ProjectSet : public HierarchicalListDataSource {
+ public:
+  ProjectSet() {}
+  virtual ~ProjectSet();
+
+  // Loads the named projects from dir all at once, and adds those that could
+  // be read in the order they were named.  Returns how many were added.
+  int LoadProjects(const string& dir, const vector<string>& names,
+                   ThreadPool* pool);
+  // Saves every project to a file named after it in dir.
+  void SaveProjects(const string& dir, ThreadPool* pool);
+  // Takes ownership of p.
+  void AddProject(Project* p);
+
+  int NumProjects() { return items_.size(); }
+  Project* ProjectAt(int i) { return items_[i]->GetProject(); }
+  Project* FindProject(const string& name);
+  vector<string> ProjectNames();
+  ListItem* ItemForProject(Project* p);
+
+  // The project a line of the tree belongs to, or NULL for no line.
+  Project* ProjectOf(ListItem* item);
+  // The task a line of the tree shows, or NULL if it's a project's line.
+  static Task* TaskOf(ListItem* item);
+
+  // Runs f on every project at once and waits for them all.  f must only
+  // touch the project it's given.
+  void ForEachProject(const function<void(Project*)>& f, ThreadPool* pool);
+
+  // The k tasks in any project whose paths best fit pattern, as FuzzyMatcher
+  // scores them, best first.  Ties go to shorter paths, then to the task that
+  // comes first.  The tasks are split up between all of pool's threads.
+  vector<Task*> FindFuzzy(const string& pattern, int k, ThreadPool* pool);
+  // The titles of t's ancestors and then t, like "Move / Pack / Books".
+  static string TaskPath(Task* t);
+
+  // Functions required by HierarchicalListDataSource:
+  int NumRoots() { return items_.size(); }
+  ListItem* Root(int i) { return items_[i]; }
+
+ private:
+  // Not copyable, since it owns the projects.
+  ProjectSet(const ProjectSet&);
+  ProjectSet& operator=(const ProjectSet&);
+
+  vector<ProjectItem*> items_;
+};
+
+#endif  // PROJECT_SET_H_
@@ -0,0 +1,156 @@
+#include "project-set.h"
+#include <sys/stat.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "project.h"
+#include "thread-pool.h"
+
+using namespace std;
+
+static int errors = 0;
+
+ostream& ERROR() {
+  ++errors;
+  cout << "Error: ";
+  return cout;
+}
+
+static const int kNumProjects = 30;
+
+string ProjectName(int i) {
+  ostringstream name;
+  name << "ProjectSetTest" << i;
+  return name.str();
+}
+
+bool TestSaveAndLoadInParallel() {
+  cout << "Testing saving and loading projects in parallel" << endl;
+  string dir = "/tmp/ProjectSetTest/";
+  mkdir(dir.c_str(), 0755);
+  ThreadPool pool(4);
+
+  vector<string> names;
+  {
+    ProjectSet saved;
+    for (int i = 0; i < kNumProjects; ++i) {
+      Project* p = new Project(ProjectName(i));
+      for (int t = 0; t <= i; ++t) {
+        p->AddTaskNamed("task")->AddSubTask(new Task("subtask", ""));
+      }
+      saved.AddProject(p);
+      names.push_back(ProjectName(i));
+    }
+    saved.SaveProjects(dir, &pool);
+  }
+
+  ProjectSet loaded;
+  names.push_back("NoSuchProject");
+  if (loaded.LoadProjects(dir, names, &pool) != kNumProjects) {
+    ERROR() << "Loaded " << loaded.NumProjects() << " projects." << endl;
+    return false;
+  }
+  for (int i = 0; i < kNumProjects; ++i) {
+    Project* p = loaded.ProjectAt(i);
+    if (p->Name() != ProjectName(i) || p->NumTasks() != 2 * (i + 1)) {
+      ERROR() << "Project " << i << " didn't load back the same." << endl;
+      return false;
+    }
+    // Loading adds the tasks without filtering them, so the lists shown have
+    // to be made from scratch rather than kept from when it was empty.
+    p->ShowAllTasks();
+    if (p->NumFilteredRoots() != i + 1) {
+      ERROR() << "Project " << i << " shows " << p->NumFilteredRoots()
+              << " root tasks after loading." << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TestTasksKnowTheirProject() {
+  cout << "Testing tasks know which project they're in" << endl;
+  ProjectSet projects;
+  Project* a = new Project("a");
+  Project* b = new Project("b");
+  projects.AddProject(a);
+  projects.AddProject(b);
+  Task* sub = new Task("sub", "");
+  b->AddTaskNamed("root")->AddSubTask(sub);
+  b->ShowAllTasks();
+
+  ListItem* item = projects.Root(1);
+  if (projects.ProjectOf(item) != b || ProjectSet::TaskOf(item) != NULL) {
+    ERROR() << "A project's line isn't a task of that project." << endl;
+    return false;
+  }
+  if (projects.ProjectOf(sub) != b || ProjectSet::TaskOf(sub) != sub ||
+      item->ListChild(0)->ListParent() != item) {
+    ERROR() << "Tasks don't hang below their project's line." << endl;
+    return false;
+  }
+  return true;
+}
+
+// Lists every filtered task of p, in the order they're shown.
+void ListFiltered(Task* t, vector<Task*>* out) {
+  out->push_back(t);
+  for (int i = 0; i < t->NumFilteredChildren(); ++i) {
+    ListFiltered(t->FilteredChild(i), out);
+  }
+}
+
+vector<Task*> AllFiltered(Project* p) {
+  vector<Task*> out;
+  for (int i = 0; i < p->NumFilteredRoots(); ++i) {
+    ListFiltered(p->FilteredRoot(i), &out);
+  }
+  return out;
+}
+
+bool TestLargeProjectsFilterInParallel() {
+  cout << "Testing large projects are filtered the same in parallel" << endl;
+  ThreadPool pool(4);
+  ProjectSet projects;
+  for (int i = 0; i < 2; ++i) {
+    Project* p = new Project(ProjectName(i));
+    // Some wide roots, one with so many subtasks they get split up too.
+    for (int r = 0; r < 300; ++r) {
+      Task* root = p->AddTaskNamed(r % 7 ? "root" : "match");
+      int num_subtasks = r == 0 ? 20000 : 30;
+      for (int c = 0; c < num_subtasks; ++c) {
+        root->AddSubTask(new Task(c % 11 ? "subtask" : "match", ""));
+      }
+    }
+    projects.AddProject(p);
+  }
+
+  projects.ForEachProject(
+      std::bind(&Project::RunSearchFilter, std::placeholders::_1, "match"),
+      &pool);
+  vector<vector<Task*> > serial;
+  for (int i = 0; i < projects.NumProjects(); ++i) {
+    serial.push_back(AllFiltered(projects.ProjectAt(i)));
+    projects.ProjectAt(i)->ShowAllTasks();
+    projects.ProjectAt(i)->SetThreadPool(&pool);
+  }
+  // Each project's filter forks more work onto the pool it's running on.
+  projects.ForEachProject(
+      std::bind(&Project::RunSearchFilter, std::placeholders::_1, "match"),
+      &pool);
+  for (int i = 0; i < projects.NumProjects(); ++i) {
+    if (AllFiltered(projects.ProjectAt(i)) != serial[i]) {
+      ERROR() << "Project " << i << " filtered differently in parallel."
+              << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+int main() {
+  bool success = TestSaveAndLoadInParallel() && TestTasksKnowTheirProject() &&
+                 TestLargeProjectsFilterInParallel();
+  cout << errors << " errors." << endl;
+  return !success;
+}
@@ -1,35 +1,134 @@
 #include "project.h"
+#include <ctype.h>
+#include <algorithm>
 #include <map>
+#include <unordered_set>
+#include <utility>
+#include "constants.h"
 #include "hierarchical-list.h"
+#include "note.h"
 #include "serializer.h"
+#include "snapshot.h"
 #include "utils.h"
 
+using std::lower_bound;
+using std::make_pair;
 using std::map;
+using std::pair;
+using std::sort;
+using std::unordered_set;
 
-Project::Project(string name) : name_(name) { ShowAllTasks(); }
+Project::Project(string name)
+    : name_(name),
+      sort_order_(SORT_BY_POSITION),
+      list_parent_of_roots_(NULL),
+      thread_pool_(NULL),
+      next_task_id_(1),
+      batch_depth_(0),
+      batch_moved_(false),
+      searching_(false),
+      search_(""),
+      shown_view_(NULL),
+      generation_(0),
+      filtered_generation_(0),
+      saved_view_bytes_(0) {
+  for (int s = 0; s < NUM_STATUSES; ++s) {
+    tasks_with_status_[s].reset(new IdBitmap());
+  }
+  ShowAllTasks();
+}
 
 Project::~Project() {
-  for (int i = 0; i < tasks_.size(); ++i) {
-    tasks_[i]->Delete();
+  for (Task* t = FirstRootTask(); t != NULL;) {
+    Task* next = t->NextSibling();
+    t->Delete();
+    t = next;
   }
 }
 
-void Project::FilterTasks(FilterPredicate<Task>* filter) {
-  // Filter all the children of the root tasks.
-  for (int i = 0; i < tasks_.size(); ++i) {
-    tasks_[i]->ApplyFilter(filter);
+void Project::FilterTasks() {
+  base_program_.Compile(&base_filter_);
+  // Each task is in at most one list, its parent's or the roots'.
+  filtered_.Reset(next_task_id_, task_ids_.Count());
+
+  // Filter all the children of the root tasks, on every core if there are
+  // enough of them to be worth it.
+  if (thread_pool_ != NULL &&
+      task_ids_.Count() >= Constants::kMinTasksToFilterInParallel) {
+    Task::ApplyFilterToSiblings(FirstRootTask(), NumRootTasks(), base_program_,
+                                sort_order_, thread_pool_);
+  } else {
+    for (Task* t = FirstRootTask(); t != NULL; t = t->NextSibling()) {
+      t->ApplyFilter(base_program_, sort_order_);
+    }
   }
 
   // Finally filter the root tasks themselves.
-  filtered_tasks_ = filter->FilterVector(tasks_);
+  Task** roots = filtered_.Claim(FilteredLists::kRoots, tasks_.Size());
+  int size = 0;
+  for (Task* t = FirstRootTask(); t != NULL; t = t->NextSibling()) {
+    if (base_program_.ObjectPasses(t)) {
+      roots[size++] = t;
+    }
+  }
+  filtered_.SetSize(FilteredLists::kRoots, size);
+  if (sort_order_ != SORT_BY_POSITION) {
+    sort(roots, roots + size, Task::SortsBefore);
+  }
+  filtered_generation_ = generation_;
+}
+
+void Project::SetSortOrder(SortOrder order) {
+  sort_order_ = order;
+  // Saved views are in the old order, and the tasks' sort keys aren't.
+  saved_views_.clear();
+  saved_view_bytes_ = 0;
+  FilterTasks();
+}
+
+// Filters a list of siblings in stored order with the base filter, and puts
+// what's left in the current sort order.
+vector<Task*> Project::FilterSiblings(const vector<Task*>& siblings) {
+  for (int i = 0; i < siblings.size(); ++i) {
+    siblings[i]->UpdateSortKey(sort_order_);
+  }
+  vector<Task*> filtered = base_program_.FilterVector(siblings);
+  if (sort_order_ != SORT_BY_POSITION) {
+    sort(filtered.begin(), filtered.end(), Task::SortsBefore);
+  }
+  return filtered;
 }
 
 Task* Project::AddTaskNamed(const string& name) {
   Task* nt = new Task(name, "");
-  tasks_.push_back(nt);
+  AddRootTask(nt);
+  AssignIds(nt);
+  IndexTasks(nt);
   return nt;
 }
 
+// Only new subtrees need ids, and they're found by their root not having one,
+// so tasks that are just being moved around aren't walked.
+void Project::AssignIds(Task* t) {
+  if (t->Id() == 0) {
+    t->AssignIds(&next_task_id_);
+  }
+}
+
+void Project::AddRootTask(Task* t) { InsertRootTask(t, tasks_.Size()); }
+
+void Project::InsertRootTask(Task* t, int index) {
+  t->SetParent(NULL);
+  t->SetObserver(this);
+  t->sibling_node_ = tasks_.Insert(index, t);
+  TaskChanged(t);
+}
+
+Task* Project::FirstRootTask() {
+  IndexedList<Task*>::Node* n = tasks_.First();
+  return n == NULL ? NULL : n->Value();
+}
+
 void Project::Serialize(Serializer* s) {
   // Write a serialization version.
   s->WriteInt64(s->Version());
@@ -41,9 +140,31 @@ void Project::Serialize(Serializer* s) {
   s->WriteInt32(NumTasks());
 
   // Serialize the tree.
-  for (int i = 0; i < tasks_.size(); ++i) {
-    tasks_[i]->Serialize(s);
+  for (Task* t = FirstRootTask(); t != NULL; t = t->NextSibling()) {
+    t->Serialize(s);
+  }
+}
+
+shared_ptr<const ProjectSnapshot> Project::Snapshot() {
+  shared_ptr<const ProjectSnapshot> snapshot = snapshot_.lock();
+  if (!snapshot) {
+    vector<shared_ptr<const TaskSnapshot> > roots;
+    roots.reserve(tasks_.Size());
+    for (Task* t = FirstRootTask(); t != NULL; t = t->NextSibling()) {
+      roots.push_back(t->Snapshot());
+    }
+    snapshot.reset(new ProjectSnapshot(name_, roots));
+    snapshot_ = snapshot;
   }
+  return snapshot;
+}
+
+// The snapshot is out of date, as are the saved views other than named ones
+// that show t.
+void Project::TaskChanged(Task* t) {
+  snapshot_.reset();
+  ++generation_;
+  StaleViewsShowing(t);
 }
 
 Project* Project::NewProjectFromFile(string path) {
@@ -65,13 +186,14 @@ Project* Project::NewProjectFromFile(string path) {
   int num_tasks = s.ReadInt32();
 
   // First read in every task in the file.
-  map<int, Task*> task_map;
-  map<Task*, int> tasks_parents;
+  map<uint64, Task*> task_map;
+  map<Task*, uint64> tasks_parents;
   vector<Task*> tasks;
+  IdBitmap loaded_ids;
   for (int i = 0; i < num_tasks; ++i) {
     // Read in the values.
-    int task_identifier;
-    int parent_pointer;
+    uint64 task_identifier;
+    uint64 parent_pointer;
     task_identifier = s.ReadUint64();
     Task* t = Task::NewTaskFromSerializer(&s);
     parent_pointer = s.ReadUint64();
@@ -79,6 +201,19 @@ Project* Project::NewProjectFromFile(string path) {
     tasks_parents[t] = parent_pointer;
     task_map[task_identifier] = t;
     tasks.push_back(t);
+
+    // Older files have no ids, and a broken file could repeat one or have one
+    // out of range.  Either way the task gets a new one below.
+    int id = t->Id();
+    if (id < 0 || id >= Constants::kMaxTaskId || loaded_ids.Test(id)) {
+      t->id_ = 0;
+    } else if (id != 0) {
+      if (id >= loaded_ids.Size()) {
+        loaded_ids.Resize(id + 1);
+      }
+      loaded_ids.Set(id);
+    }
+    p->next_task_id_ = std::max(p->next_task_id_, t->Id() + 1);
   }
 
   // Then re-assemble the tree structure.
@@ -86,40 +221,583 @@ Project* Project::NewProjectFromFile(string path) {
     Task* t = tasks[i];
     if (tasks_parents[t] == 0) {
       // We have a root task.  Add it to the root list.
-      p->tasks_.push_back(tasks[i]);
+      p->AddRootTask(tasks[i]);
     } else {
       // We have a child task.  Add it to its parent's list.
       task_map[tasks_parents[t]]->AddSubTask(tasks[i]);
     }
   }
+  for (Task* t = p->FirstRootTask(); t != NULL; t = t->NextSibling()) {
+    t->AssignIds(&p->next_task_id_);
+    p->IndexTasks(t);
+  }
 
-  p->ShowAllTasks();
+  // The tasks were added without being filtered.
+  p->FilterTasks();
   return p;
 }
 
 int Project::NumTasks() {
   int total = 0;
-  for (int i = 0; i < tasks_.size(); ++i) {
-    total += 1 + tasks_[i]->NumOffspring();
+  for (Task* t = FirstRootTask(); t != NULL; t = t->NextSibling()) {
+    total += 1 + t->NumOffspring();
   }
   return total;
 }
 
 void Project::DeleteTask(Task* t) {
+  UnindexTasks(t);
   if (t->Parent() == NULL) {
-    // It's a top level task.  Remove it from our list of roots.
-    for (int i = 0; i < tasks_.size(); ++i) {
-      if (tasks_[i] == t) {
-        tasks_[i]->Delete();
-        tasks_.erase(tasks_.begin() + i);
-        break;
-      }
+    // It's a top level task.  Remove it from our list of roots, once the
+    // views saved have looked for it where it was.
+    TaskChanged(t);
+    tasks_.Erase(t->sibling_node_);
+    t->Delete();
+  } else {
+    t->Delete();
+  }
+}
+
+Task* Project::DetachTask(Task* t, Task** parent, int* index) {
+  UnindexTasks(t);
+  return TakeOutTask(t, parent, index);
+}
+
+// Takes t out of the tree like DetachTask(), but leaves it in the indexes for
+// when it's only being moved.
+Task* Project::TakeOutTask(Task* t, Task** parent, int* index) {
+  *parent = t->Parent();
+  if (*parent == NULL) {
+    // Only the root list changes.  The task is gone from it, so t itself is
+    // what a list has to drop.
+    *index = t->SiblingIndex();
+    RemoveFiltered(FilteredLists::kRoots, t);
+    TaskChanged(t);
+    tasks_.Erase(t->sibling_node_);
+    t->sibling_node_ = NULL;
+    t->SetObserver(NULL);
+    if (batch_depth_ > 0) {
+      batch_moved_ = true;
+      return NULL;
+    }
+    filtered_generation_ = generation_;
+    return t;
+  }
+
+  *index = t->SiblingIndex();
+  RemoveFiltered((*parent)->Id(), t);
+  (*parent)->RemoveSubtaskFromList(t);
+  t->SetParent(NULL);
+  if (batch_depth_ > 0) {
+    batch_edits_.push_back(*parent);
+    batch_moved_ = true;
+    return NULL;
+  }
+  Task* status_changed = RecomputeStatusAbove(*parent);
+
+  // Unless that showed or hid something above, a list only has to drop t's
+  // own lines.
+  Task* changed = RefilterAncestors(*parent, status_changed);
+  return changed == NULL ? t : changed;
+}
+
+Task* Project::AttachTask(Task* t, Task* parent, int index) {
+  // The subtree's filter results may be stale if it spent time detached, or
+  // missing if it's new.  Either way it's one pass over the subtree, as is
+  // numbering a new one.
+  AssignIds(t);
+  IndexTasks(t);
+  t->ApplyFilter(base_program_, sort_order_);
+  return InsertTask(t, parent, index);
+}
+
+void Project::MoveTask(Task* t, Task* parent, int index, Task** old_parent,
+                       int* old_index, vector<Task*>* changed) {
+  if (t->Parent() == parent) {
+    // Reordering siblings doesn't change any statuses or filter results, only
+    // the order of the filtered siblings.
+    *old_parent = parent;
+    *old_index = t->SiblingIndex();
+    int list = ListOf(parent);
+    // Batches leave the filtered siblings to be put back in order at the end.
+    bool shown = batch_depth_ == 0 && RemoveFiltered(list, t);
+    if (parent == NULL) {
+      TaskChanged(t);
+      tasks_.Move(t->sibling_node_, index);
+    } else {
+      parent->MoveSubTask(t, index);
+    }
+    if (batch_depth_ > 0) {
+      batch_edits_.push_back(t);
+      batch_moved_ = true;
+      return;
+    }
+    if (shown) {
+      filtered_.Insert(list, FilteredIndex(list, t), t);
+    }
+    filtered_generation_ = generation_;
+    changed->push_back(t);
+    return;
+  }
+
+  // Where a subtree sits doesn't change its own filter results, so only the
+  // ancestors at either end need looking at.
+  Task* from = TakeOutTask(t, old_parent, old_index);
+  Task* to = InsertTask(t, parent, index);
+  // If the tasks at either end are siblings they may both have been resorted,
+  // and a list can only move one at a time to where it now sorts.  So their
+  // parent is updated instead, or the whole list if they're roots.
+  if (sort_order_ != SORT_BY_POSITION && from != NULL && to != NULL &&
+      from != to && from->Parent() == to->Parent()) {
+    changed->push_back(to->Parent());
+    return;
+  }
+  changed->push_back(from);
+  changed->push_back(to);
+}
+
+Task* Project::TaskEdited(Task* t) {
+  UpdateTitleIndex(t);
+  UpdateSearchIndex(t);
+  UpdateStatusIndexes(t);
+  UpdateQueryMatches(t);
+  if (batch_depth_ > 0) {
+    batch_edits_.push_back(t);
+    return NULL;
+  }
+  Task* changed = RefilterAncestors(t, RecomputeStatusAbove(t->Parent()));
+  return changed == NULL ? t : changed;
+}
+
+void Project::BeginBatch() { ++batch_depth_; }
+
+void Project::EndBatch(vector<Task*>* changed) {
+  if (--batch_depth_ > 0) {
+    return;
+  }
+
+  // Gather every task on the paths from the edits up to the roots, deepest
+  // first so that children are always dealt with before their parents.  Each
+  // path stops where it meets one already walked, whose depth is then known.
+  map<Task*, int> depths;
+  vector<pair<int, Task*> > path;
+  for (int i = 0; i < batch_edits_.size(); ++i) {
+    vector<Task*> chain;
+    Task* t = batch_edits_[i];
+    for (; t != NULL && depths.find(t) == depths.end(); t = t->Parent()) {
+      chain.push_back(t);
+    }
+    int depth = (t == NULL ? -1 : depths[t]) + chain.size();
+    for (int j = 0; j < chain.size(); ++j, --depth) {
+      depths[chain[j]] = depth;
+      path.push_back(make_pair(-depth, chain[j]));
     }
+  }
+  batch_edits_.clear();
+  sort(path.begin(), path.end());
+
+  for (int i = 0; i < path.size(); ++i) {
+    UpdateStatusFromChildren(path[i].second);
+  }
+
+  // Moved tasks leave their old siblings' filtered subtasks out of order, and
+  // their old and new lines can't be worked out from the paths alone.
+  if (batch_moved_) {
+    batch_moved_ = false;
+    for (int i = 0; i < path.size(); ++i) {
+      Task* t = path[i].second;
+      filtered_.Assign(t->Id(), FilterSiblings(t->Children()));
+    }
+    filtered_.Assign(FilteredLists::kRoots, FilterSiblings(tasks_.ToVector()));
+    filtered_generation_ = generation_;
+    changed->push_back(NULL);
+    return;
+  }
+
+  // Otherwise each task only moves within, into or out of its parent's
+  // filtered subtasks, so one filter pass over just those tasks will do.
+  vector<Task*> roots;
+  for (int i = 0; i < path.size(); ++i) {
+    Task* t = path[i].second;
+    Refilter(t);
+    if (t->Parent() == NULL) {
+      roots.push_back(t);
+    }
+  }
+  filtered_generation_ = generation_;
+  // A list can only move one root at a time to where it now sorts, so if
+  // several could have swapped places the whole list is updated.
+  if (roots.size() > 1 && sort_order_ != SORT_BY_POSITION) {
+    changed->push_back(NULL);
   } else {
-    for (int i = 0; i < tasks_.size(); ++i) {
-      tasks_[i]->DeleteTask(t);
+    changed->insert(changed->end(), roots.begin(), roots.end());
+  }
+}
+
+// Puts t at index among parent's subtasks, or the root tasks if parent is NULL,
+// assuming its subtree's filter results are up to date.
+Task* Project::InsertTask(Task* t, Task* parent, int index) {
+  if (parent == NULL) {
+    InsertRootTask(t, index);
+  } else {
+    parent->InsertSubTask(t, index);
+  }
+  if (batch_depth_ > 0) {
+    batch_edits_.push_back(t);
+    return NULL;
+  }
+  Task* changed = RefilterAncestors(t, RecomputeStatusAbove(parent));
+  return changed == NULL ? t : changed;
+}
+
+// Recomputes the status of |parent| and its ancestors after one of parent's
+// children changed.  Returns the highest task whose status changed, or NULL.
+Task* Project::RecomputeStatusAbove(Task* parent) {
+  Task* highest = NULL;
+  for (Task* p = parent; p != NULL; p = p->Parent()) {
+    TaskStatus before = p->Status();
+    if (UpdateStatusFromChildren(p) == before) {
+      // A task's status only depends on its children, so nothing above can
+      // change either.
+      break;
+    }
+    highest = p;
+  }
+  return highest;
+}
+
+// Re-evaluates the filter on t and each of its ancestors, moving each to its
+// place among its filtered siblings in case its sort key changed.  Only t's
+// subtree changed, so its siblings' filter results can't have.  We can stop as
+// soon as a task is shown or hidden just as before, since the only thing that
+// looks at other tasks is "has filtered children", unless an ancestor at or
+// below |must_reach| changed its status and so has to be looked at anyway.
+// Returns the highest task that was shown or hidden, or must_reach if that's
+// higher since its line changed, or NULL if nothing above t needs redrawing.
+Task* Project::RefilterAncestors(Task* t, Task* must_reach) {
+  Task* changed = must_reach;
+  for (Task* node = t; node != NULL; node = node->Parent()) {
+    if (node == must_reach) {
+      must_reach = NULL;
+    }
+    if (Refilter(node)) {
+      if (must_reach == NULL) {
+        changed = node;
+      }
+    } else if (must_reach == NULL) {
+      break;
     }
   }
+  filtered_generation_ = generation_;
+  return changed;
+}
+
+// Re-evaluates the filter on t alone, and moves it to its place among its
+// filtered siblings in case its sort key changed.  Returns whether that showed
+// or hid it.
+bool Project::Refilter(Task* t) {
+  int list = ListOf(t->Parent());
+  // The stale sort key is what t was filed under.
+  bool was_shown = RemoveFiltered(list, t);
+  t->UpdateSortKey(sort_order_);
+  bool shown = base_program_.ObjectPasses(t);
+  if (shown) {
+    filtered_.Insert(list, FilteredIndex(list, t), t);
+  }
+  return shown != was_shown;
+}
+
+// The filtered list that parent's subtasks are in, or the root tasks if parent
+// is NULL.
+int Project::ListOf(Task* parent) {
+  return parent == NULL ? FilteredLists::kRoots : parent->Id();
+}
+
+// Returns where t is, or would go, in list, the filtered list of t's
+// siblings.  Since it's sorted by the cached keys this is a binary search.
+int Project::FilteredIndex(int list, Task* t) {
+  return lower_bound(filtered_.Begin(list), filtered_.End(list), t,
+                     Task::SortsBefore) -
+         filtered_.Begin(list);
+}
+
+// Takes t out of list, the filtered list of its siblings, if it's there.
+// Returns whether it was.
+bool Project::RemoveFiltered(int list, Task* t) {
+  int i = FilteredIndex(list, t);
+  if (i == filtered_.Size(list) || filtered_.At(list, i) != t) {
+    return false;
+  }
+  filtered_.Erase(list, i);
+  return true;
+}
+
+Task* Project::TaskWithId(int id) {
+  return id >= 0 && id < tasks_by_id_.size() ? tasks_by_id_[id] : NULL;
+}
+
+vector<Task*> Project::TasksWithTitlePrefix(const string& prefix,
+                                            int max_results) {
+  string key = TitleKey(prefix);
+  vector<Task*> found;
+  for (multimap<string, Task*>::iterator it = tasks_by_title_.lower_bound(key);
+       it != tasks_by_title_.end() && found.size() < max_results &&
+       it->first.compare(0, key.size(), key) == 0;
+       ++it) {
+    found.push_back(it->second);
+  }
+  return found;
+}
+
+bool Project::IsShown(Task* t) {
+  for (Task* node = t; node != NULL; node = node->Parent()) {
+    int list = ListOf(node->Parent());
+    int i = FilteredIndex(list, node);
+    if (i == filtered_.Size(list) || filtered_.At(list, i) != node) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Adds t and its offspring to the indexes.
+void Project::IndexTasks(Task* t) {
+  if (t->Id() >= tasks_by_id_.size()) {
+    tasks_by_id_.resize(t->Id() + 1);
+    task_ids_.Resize(t->Id() + 1);
+    for (int s = 0; s < NUM_STATUSES; ++s) {
+      tasks_with_status_[s]->Resize(t->Id() + 1);
+    }
+  }
+  tasks_by_id_[t->Id()] = t;
+  task_ids_.Set(t->Id());
+  t->filtered_lists_ = &filtered_;
+  t->title_key_ = TitleKey(t->Title());
+  tasks_by_title_.insert(make_pair(t->title_key_, t));
+  tasks_by_creation_.insert(make_pair(t->CreationTime(), t->Id()));
+  UpdateSearchIndex(t);
+  UpdateStatusIndexes(t);
+  UpdateQueryMatches(t);
+  for (Task* c = t->FirstChild(); c != NULL; c = c->NextSibling()) {
+    IndexTasks(c);
+  }
+}
+
+void Project::UnindexTasks(Task* t) {
+  tasks_by_id_[t->Id()] = NULL;
+  task_ids_.Clear(t->Id());
+  filtered_.Clear(t->Id());
+  t->filtered_lists_ = NULL;
+  pair<multimap<string, Task*>::iterator, multimap<string, Task*>::iterator>
+      range = tasks_by_title_.equal_range(t->title_key_);
+  for (multimap<string, Task*>::iterator it = range.first; it != range.second;
+       ++it) {
+    if (it->second == t) {
+      tasks_by_title_.erase(it);
+      break;
+    }
+  }
+  search_index_.Update(t->Id(), t->search_trigrams_,
+                       vector<TrigramIndex::Trigram>());
+  vector<TrigramIndex::Trigram>().swap(t->search_trigrams_);
+  t->matches_search_ = false;
+  tasks_by_creation_.erase(make_pair(t->CreationTime(), t->Id()));
+  tasks_by_completion_.erase(make_pair(t->completion_key_, t->Id()));
+  t->completion_key_ = 0;
+  for (int s = 0; s < NUM_STATUSES; ++s) {
+    tasks_with_status_[s]->Clear(t->Id());
+  }
+  ForgetQueryMatches(t);
+  for (Task* c = t->FirstChild(); c != NULL; c = c->NextSibling()) {
+    UnindexTasks(c);
+  }
+}
+
+// Refiles t in the title index if its title changed.
+void Project::UpdateTitleIndex(Task* t) {
+  string key = TitleKey(t->Title());
+  if (key == t->title_key_) {
+    return;
+  }
+  pair<multimap<string, Task*>::iterator, multimap<string, Task*>::iterator>
+      range = tasks_by_title_.equal_range(t->title_key_);
+  for (multimap<string, Task*>::iterator it = range.first; it != range.second;
+       ++it) {
+    if (it->second == t) {
+      tasks_by_title_.erase(it);
+      break;
+    }
+  }
+  t->title_key_ = key;
+  tasks_by_title_.insert(make_pair(key, t));
+}
+
+// Refiles t in the search index under the trigrams of all of its text, and
+// checks it against the current search, if any.
+void Project::UpdateSearchIndex(Task* t) {
+  vector<TrigramIndex::Trigram> trigrams;
+  TrigramIndex::AddTrigrams(t->Title(), &trigrams);
+  TrigramIndex::AddTrigrams(t->Description(), &trigrams);
+  for (int i = 0; i < t->notes_.size(); ++i) {
+    TrigramIndex::AddTrigrams(t->notes_[i]->GetText(), &trigrams);
+  }
+  TrigramIndex::SortTrigrams(&trigrams);
+  search_index_.Update(t->Id(), t->search_trigrams_, trigrams);
+  // Kept for every task, so without any room to spare.
+  vector<TrigramIndex::Trigram>(trigrams.begin(), trigrams.end())
+      .swap(t->search_trigrams_);
+
+  if (searching_) {
+    t->matches_search_ = MatchesSearch(t);
+  }
+}
+
+// Refiles t under its status and, if it's completed, when it was.
+void Project::UpdateStatusIndexes(Task* t) {
+  for (int s = 0; s < NUM_STATUSES; ++s) {
+    tasks_with_status_[s]->Assign(t->Id(), s == t->Status());
+  }
+  time_t completed = t->CompletionTime();
+  if (completed == t->completion_key_) {
+    return;
+  }
+  tasks_by_completion_.erase(make_pair(t->completion_key_, t->Id()));
+  if (completed > 0) {
+    tasks_by_completion_.insert(make_pair(completed, t->Id()));
+  }
+  t->completion_key_ = completed > 0 ? completed : 0;
+}
+
+// The base filter only looks up what passed the query shown, and views are
+// shown without testing any task, so whatever changes a task has to test it
+// again against each of them.
+void Project::UpdateQueryMatches(Task* t) {
+  if (query_ && shown_view_ == NULL) {
+    UpdateMatch(query_.get(), t);
+  }
+  for (list<View>::iterator it = views_.begin(); it != views_.end(); ++it) {
+    UpdateMatch(it->live.get(), t);
+  }
+  StaleViewsShowing(t);
+}
+
+// t may be what the query looked up in the indexes now, too.
+void Project::UpdateMatch(LiveQuery* live, Task* t) {
+  for (int i = 0; i < live->candidates.size(); ++i) {
+    IdBitmap* candidates = live->candidates[i].get();
+    if (t->Id() >= candidates->Size()) {
+      candidates->Resize(t->Id() + 1);
+    }
+    candidates->Set(t->Id());
+  }
+  if (t->Id() >= live->matches->Size()) {
+    live->matches->Resize(t->Id() + 1);
+  }
+  live->matches->Assign(t->Id(), live->filter.ObjectPasses(t));
+}
+
+// A task taken out of the tree passes nothing, until it's put back.
+void Project::ForgetQueryMatches(Task* t) {
+  StaleViewsShowing(t);
+  if (query_ && shown_view_ == NULL && t->Id() < query_->matches->Size()) {
+    query_->matches->Clear(t->Id());
+  }
+  for (list<View>::iterator it = views_.begin(); it != views_.end(); ++it) {
+    if (t->Id() < it->live->matches->Size()) {
+      it->live->matches->Clear(t->Id());
+    }
+  }
+}
+
+// A named view's saved lists are kept while t is neither among the tasks they
+// show nor passes the view's query, since then its lists don't hold t and
+// wouldn't if they were filtered again.  Every ancestor of a task shown is
+// shown, so that covers t's subtasks being added, moved and taken out, too.
+// Tasks have to be reported before they move, while they're still where the
+// saved lists have them.
+void Project::StaleViewsShowing(Task* t) {
+  for (list<SavedView>::iterator it = saved_views_.begin();
+       it != saved_views_.end(); ++it) {
+    if (it->view != NULL && !it->stale &&
+        (Shows(&it->lists, t) || it->view->live->matches->Test(t->Id()))) {
+      it->stale = true;
+    }
+  }
+}
+
+// Whether lists, which were filtered with the tasks as they are, have t among
+// t's siblings.  Until a task or its siblings change, a list stays sorted by
+// their cached keys, so this is a binary search like FilteredIndex().
+bool Project::Shows(FilteredLists* lists, Task* t) {
+  // A task out of the tree isn't in any list.
+  if (t->Parent() == NULL && t->sibling_node_ == NULL) {
+    return false;
+  }
+  int list = ListOf(t->Parent());
+  Task** end = lists->End(list);
+  Task** found = lower_bound(lists->Begin(list), end, t, Task::SortsBefore);
+  return found != end && *found == t;
+}
+
+bool Project::MatchesSearch(Task* t) {
+  if (search_.FoundIn(t->Title()) || search_.FoundIn(t->Description())) {
+    return true;
+  }
+  for (int i = 0; i < t->notes_.size(); ++i) {
+    if (search_.FoundIn(t->notes_[i]->GetText())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t Project::SearchIndexMemoryUsage() {
+  size_t usage = search_index_.MemoryUsage();
+  for (int id = task_ids_.Next(0); id >= 0; id = task_ids_.Next(id + 1)) {
+    usage += tasks_by_id_[id]->search_trigrams_.capacity() *
+             sizeof(TrigramIndex::Trigram);
+  }
+  return usage;
+}
+
+// Lower case, with leading whitespace dropped and every other run of
+// whitespace turned into a single space.
+string Project::TitleKey(const string& title) {
+  string key;
+  key.reserve(title.size());
+  bool space = false;
+  for (int i = 0; i < title.size(); ++i) {
+    if (isspace(title[i])) {
+      space = !key.empty();
+    } else {
+      if (space) {
+        key += ' ';
+        space = false;
+      }
+      key += tolower(title[i]);
+    }
+  }
+  return key;
+}
+
+int Project::NumSiblings(Task* t) {
+  return t->Parent() == NULL ? tasks_.Size() : t->Parent()->NumChildren();
+}
+
+int Project::SiblingIndexAfterMoving(Task* t, int offset) {
+  int list = ListOf(t->Parent());
+  int size = filtered_.Size(list);
+  int from = FilteredIndex(list, t);
+  if (from == size || filtered_.At(list, from) != t) {
+    // t is hidden itself, so just count every sibling.
+    int to = t->SiblingIndex() + offset;
+    return std::max(0, std::min(NumSiblings(t) - 1, to));
+  }
+
+  // Landing just above a sibling when moving up, or just below it when moving
+  // down, both come out as that sibling's index once t is taken out.
+  int to = std::max(0, std::min(size - 1, from + offset));
+  return filtered_.At(list, to)->SiblingIndex();
 }
 
 // Compute the status of all nodes.  Nodes which have children have their status
@@ -127,12 +805,22 @@ void Project::DeleteTask(Task* t) {
 // child is itself IN_PROGRESS.  If all of a node's children are PAUSED, the
 // node is PAUSED.
 void Project::RecomputeNodeStatus() {
-  for (int i = 0; i < tasks_.size(); ++i) {
-    ComputeStatusForTask(tasks_[i]);
+  for (Task* t = FirstRootTask(); t != NULL; t = t->NextSibling()) {
+    ComputeStatusForTask(t);
   }
 }
 
 TaskStatus Project::ComputeStatusForTask(Task* t) {
+  for (Task* c = t->FirstChild(); c != NULL; c = c->NextSibling()) {
+    ComputeStatusForTask(c);
+  }
+  return UpdateStatusFromChildren(t);
+}
+
+// Sets t's status from the current statuses of its children.  Only tasks whose
+// status actually changes are touched, so recomputing doesn't invalidate the
+// snapshot of every parent task.
+TaskStatus Project::UpdateStatusFromChildren(Task* t) {
   if (!t->NumChildren()) {
     return t->Status();
   }
@@ -142,91 +830,500 @@ TaskStatus Project::ComputeStatusForTask(Task* t) {
     status_counts[i] = 0;
   }
 
-  for (int i = 0; i < t->NumChildren(); ++i) {
-    TaskStatus s = ComputeStatusForTask(t->Child(i));
-    ++status_counts[s];
+  for (Task* c = t->FirstChild(); c != NULL; c = c->NextSibling()) {
+    ++status_counts[c->Status()];
   }
 
-  // If any children are in progress, so is this one.
-  if (status_counts[IN_PROGRESS]) {
-    t->SetStatus(IN_PROGRESS);
-    return IN_PROGRESS;
-  }
-
-  // If all children are the same, this node gets that status.
-  for (int i = 0; i < NUM_STATUSES; ++i) {
-    if (status_counts[i] == t->NumChildren()) {
-      t->SetStatus((TaskStatus)i);
-      return (TaskStatus)i;
+  // If any children are in progress, so is this one.  If all children are the
+  // same, this node gets that status.  Under any other circumstance we're in
+  // progress.
+  TaskStatus status = IN_PROGRESS;
+  if (!status_counts[IN_PROGRESS]) {
+    for (int i = 0; i < NUM_STATUSES; ++i) {
+      if (status_counts[i] == t->NumChildren()) {
+        status = (TaskStatus)i;
+        break;
+      }
     }
   }
 
-  // Under any other circumstance we're in progress.
-  t->SetStatus(IN_PROGRESS);
-  return IN_PROGRESS;
+  if (t->Status() != status) {
+    t->SetStatus(status);
+    UpdateStatusIndexes(t);
+    UpdateQueryMatches(t);
+  }
+  return status;
 }
 
-int Project::NumFilteredRoots() { return filtered_tasks_.size(); }
+int Project::NumFilteredRoots() {
+  return filtered_.Size(FilteredLists::kRoots);
+}
 
-Task* Project::FilteredRoot(int r) { return filtered_tasks_[r]; }
+Task* Project::FilteredRoot(int r) {
+  return filtered_.At(FilteredLists::kRoots, r);
+}
 
 void Project::ShowAllTasks() {
-  GTFilterPredicate<Task, time_t>* gtfp =
-      new GTFilterPredicate<Task, time_t>(-1, Task::CompletionDateWrapper);
+  GTFilterPredicate<Task, time_t, Task::CompletionTimeGetter>* gtfp =
+      new GTFilterPredicate<Task, time_t, Task::CompletionTimeGetter>(
+          -1, Task::CompletionTimeGetter());
   base_filter_.Clear();
   base_filter_.AddChild(gtfp);
-  FilterTasks();
+  LeaveView();
+  if (ShowSavedView("all")) {
+    base_program_.Compile(&base_filter_);
+  } else {
+    FilterTasks();
+  }
 }
 
 void Project::ArchiveCompletedTasks() {
-  EqualityFilterPredicate<Task, TaskStatus>* efp =
-      new EqualityFilterPredicate<Task, TaskStatus>(COMPLETED,
-                                                    Task::StatusWrapper);
+  EqualityFilterPredicate<Task, TaskStatus, Task::StatusGetter>* efp =
+      new EqualityFilterPredicate<Task, TaskStatus, Task::StatusGetter>(
+          COMPLETED, Task::StatusGetter());
   efp->SetIsNot(true);
   base_filter_.Clear();
   base_filter_.AddChild(efp);
-  FilterTasks();
+  LeaveView();
+  if (ShowSavedView("archive")) {
+    base_program_.Compile(&base_filter_);
+  } else {
+    FilterTasks();
+  }
 }
 
-void Project::ShowCompletedLastWeek() {
-  // We check if their completion date is > one week ago.
-  time_t week_ago;
-  std::time(&week_ago);
-  week_ago -= 60 * 60 * 24 * 7;
-  GTFilterPredicate<Task, time_t>* gtfp = new GTFilterPredicate<Task, time_t>(
-      week_ago, Task::CompletionDateWrapper);
-  GTFilterPredicate<Task, int>* has_filtered_child =
-      new GTFilterPredicate<Task, int>(0, Task::NumFilteredOffspringWrapper);
+// The same as the query, which looks the tasks up in the completion time index
+// rather than testing every one.
+void Project::ShowCompletedLastWeek() { RunQuery("completed>-1w", time(NULL)); }
+
+void Project::RunSearchFilter(const string& needle) {
+  // A needle containing the last one only matches what that matched, which is
+  // how a search goes as it's typed.
+  if (searching_ && search_.FoundIn(needle)) {
+    NarrowSearch(needle);
+    return;
+  }
+
+  // Clear the current filters.  A saved view takes its lists with it, which
+  // leaves none to empty.
+  bool was_showing_matches = searching_ || query_;
+  was_showing_matches = LeaveView() || was_showing_matches;
+  base_filter_.Clear();
+
+  // Only the tasks the search index turns up need their text searched, unless
+  // the needle is too short to look up.  Tasks edited while the search is
+  // showing are checked as they change.
+  searching_ = true;
+  search_ = CaselessSearcher(needle);
+  vector<Task*> matches;
+  vector<int> candidates;
+  if (search_index_.Candidates(needle, &candidates)) {
+    for (int i = 0; i < candidates.size(); ++i) {
+      Task* t = tasks_by_id_[candidates[i]];
+      if (MatchesSearch(t)) {
+        matches.push_back(t);
+      }
+    }
+  } else {
+    for (int id = task_ids_.Next(0); id >= 0; id = task_ids_.Next(id + 1)) {
+      if (MatchesSearch(tasks_by_id_[id])) {
+        matches.push_back(tasks_by_id_[id]);
+      }
+    }
+  }
+  for (int i = 0; i < matches.size(); ++i) {
+    matches[i]->matches_search_ = true;
+  }
+
+  BooleanFilterPredicate<Task, Task::MatchesSearchGetter>* matches_filter =
+      new BooleanFilterPredicate<Task, Task::MatchesSearchGetter>(
+          Task::MatchesSearchGetter());
+
+  BooleanFilterPredicate<Task, Task::HasFilteredSubtasksGetter>*
+      has_filtered_child =
+          new BooleanFilterPredicate<Task, Task::HasFilteredSubtasksGetter>(
+              Task::HasFilteredSubtasksGetter());
+
   OrFilterPredicate<Task>* or_filter = new OrFilterPredicate<Task>();
-  or_filter->AddChild(gtfp);
+  or_filter->AddChild(matches_filter);
   or_filter->AddChild(has_filtered_child);
+
+  base_filter_.AddChild(or_filter);
+  if (was_showing_matches &&
+      matches.size() * Constants::kTasksPerSearchMatchToShowMatches <
+          task_ids_.Count()) {
+    base_program_.Compile(&base_filter_);
+    ShowSearchMatches(matches);
+  } else {
+    FilterTasks();
+  }
+}
+
+void Project::RunRegexFilter(const shared_ptr<const RegexMatcher>& regex) {
+  LeaveView();
   base_filter_.Clear();
+
+  OrFilterPredicate<Task>* or_filter = new OrFilterPredicate<Task>();
+  or_filter->AddChild(new RegexFilterPredicate<Task, Task::TitleGetter>(
+      regex, Task::TitleGetter()));
+  or_filter->AddChild(new RegexFilterPredicate<Task, Task::DescriptionGetter>(
+      regex, Task::DescriptionGetter()));
+  or_filter->AddChild(
+      new BooleanFilterPredicate<Task, Task::HasFilteredSubtasksGetter>(
+          Task::HasFilteredSubtasksGetter()));
   base_filter_.AddChild(or_filter);
   FilterTasks();
 }
 
-void Project::RunSearchFilter(const string& needle) {
-  // Clear the current filters.
-  base_filter_.Clear();
+bool Project::RunQuery(const string& query, time_t now) {
+  now -= now % Constants::kQueryTimeResolution;
+  shared_ptr<LiveQuery> live = PlanQuery(query, now);
+  if (!live) {
+    return false;
+  }
+  bool was_showing_matches = searching_ || query_;
+  was_showing_matches = LeaveView() || was_showing_matches;
+  query_ = live;
 
-  // Create the search filters.  Right now it only searches on the text and
-  // description of the tasks.
-  StringContainsFilterPredicate<Task>* title_filter =
-      new StringContainsFilterPredicate<Task>(needle, Task::TitleWrapper);
+  // Unless the query was shown and left since the project last changed, every
+  // task is tested at once, by id.
+  bool saved = ShowSavedView("query " + std::to_string(now) + " " + query);
+  if (!saved) {
+    EvaluateQuery(query_.get());
+  }
+  FilterByQueryMatches();
+  if (saved) {
+    base_program_.Compile(&base_filter_);
+  } else {
+    ShowQueryMatches(was_showing_matches);
+  }
+  return true;
+}
 
-  StringContainsFilterPredicate<Task>* description_filter =
-      new StringContainsFilterPredicate<Task>(needle, Task::DescriptionWrapper);
+bool Project::AddView(const string& name, const string& query) {
+  for (list<View>::iterator it = views_.begin(); it != views_.end(); ++it) {
+    if (it->name == name) {
+      return false;
+    }
+  }
+  time_t now = time(NULL);
+  now -= now % Constants::kQueryTimeResolution;
+  shared_ptr<LiveQuery> live = PlanQuery(query, now);
+  if (!live) {
+    return false;
+  }
+  EvaluateQuery(live.get());
+  views_.push_back(View());
+  View* view = &views_.back();
+  view->name = name;
+  view->query = query;
+  view->relative = TaskQuery::CountsBackFromNow(query);
+  view->now = now;
+  view->live = live;
+  return true;
+}
 
-  GTFilterPredicate<Task, int>* has_filtered_child =
-      new GTFilterPredicate<Task, int>(0, Task::NumFilteredOffspringWrapper);
+bool Project::ShowView(const string& name) {
+  View* view = NULL;
+  for (list<View>::iterator it = views_.begin(); it != views_.end(); ++it) {
+    if (it->name == name) {
+      view = &*it;
+    }
+  }
+  if (view == NULL) {
+    return false;
+  }
+  bool was_showing_matches = searching_ || query_;
+  was_showing_matches = LeaveView() || was_showing_matches;
 
-  OrFilterPredicate<Task>* or_filter = new OrFilterPredicate<Task>();
-  or_filter->AddChild(title_filter);
-  or_filter->AddChild(description_filter);
-  or_filter->AddChild(has_filtered_child);
+  // Times ago are moved up to this minute, which means testing every task
+  // again.
+  time_t now = time(NULL);
+  now -= now % Constants::kQueryTimeResolution;
+  if (view->relative && view->now != now) {
+    view->now = now;
+    view->live = PlanQuery(view->query, now);
+    EvaluateQuery(view->live.get());
+  }
+  shown_view_ = view;
+  query_ = view->live;
+  bool saved = ShowSavedView("view " + std::to_string(view->now) + " " + name);
+  FilterByQueryMatches();
+  if (saved) {
+    base_program_.Compile(&base_filter_);
+  } else {
+    ShowQueryMatches(was_showing_matches);
+  }
 
+  // Tasks may have been expanded or collapsed in other views since.  Those
+  // this one didn't show with subtasks are left as they are.
+  RestoreExpanded(view->expanded, true);
+  RestoreExpanded(view->collapsed, false);
+  return true;
+}
+
+void Project::RestoreExpanded(const IdBitmap& ids, bool expand) {
+  for (int id = ids.Next(0); id >= 0; id = ids.Next(id + 1)) {
+    if (task_ids_.Test(id)) {
+      tasks_by_id_[id]->SetExpanded(expand);
+    }
+  }
+}
+
+// Parses query, looking up what it can in the indexes, and orders its tests
+// by how they do on a sample of the tasks.  Returns NULL if query isn't valid.
+shared_ptr<Project::LiveQuery> Project::PlanQuery(const string& query,
+                                                  time_t now) {
+  shared_ptr<LiveQuery> live(new LiveQuery());
+  TaskQuery::Indexes indexes;
+  indexes.text = &search_index_;
+  indexes.statuses.assign(tasks_with_status_,
+                          tasks_with_status_ + NUM_STATUSES);
+  indexes.created = &tasks_by_creation_;
+  indexes.completed = &tasks_by_completion_;
+  indexes.num_tasks = task_ids_.Count();
+  indexes.candidates = &live->candidates;
+  string error;
+  FilterPredicate<Task>* passes =
+      TaskQuery::Parse(query, now, indexes, &error);
+  if (passes == NULL) {
+    return shared_ptr<LiveQuery>();
+  }
+  live->filter.AddChild(passes);
+  vector<Task*> sample;
+  SampleTasks(&sample);
+  live->filter.Plan(sample);
+  return live;
+}
+
+// Tests every task at once, by id.
+void Project::EvaluateQuery(LiveQuery* live) {
+  live->matches.reset(new IdBitmap());
+  live->filter.Evaluate(tasks_by_id_, task_ids_, live->matches.get());
+}
+
+// The base filter only looks up what passed query_.
+void Project::FilterByQueryMatches() {
+  base_filter_.Clear();
+  OrFilterPredicate<Task>* or_filter = new OrFilterPredicate<Task>();
+  or_filter->AddChild(new BitmapFilterPredicate<Task, Task::IdGetter>(
+      query_->matches, Task::IdGetter()));
+  or_filter->AddChild(
+      new BooleanFilterPredicate<Task, Task::HasFilteredSubtasksGetter>(
+          Task::HasFilteredSubtasksGetter()));
   base_filter_.AddChild(or_filter);
-  FilterTasks();
+}
+
+// Like a search, a query that passes few tasks only has to visit the ones it
+// or the last one shows.
+void Project::ShowQueryMatches(bool was_showing_matches) {
+  IdBitmap* matches = query_->matches.get();
+  if (was_showing_matches &&
+      matches->Count() * Constants::kTasksPerSearchMatchToShowMatches <
+          task_ids_.Count()) {
+    vector<Task*> shown;
+    for (int id = matches->Next(0); id >= 0; id = matches->Next(id + 1)) {
+      shown.push_back(tasks_by_id_[id]);
+    }
+    base_program_.Compile(&base_filter_);
+    ShowSearchMatches(shown);
+  } else {
+    FilterTasks();
+  }
+}
+
+// Ids are handed out in order, so tasks picked at even steps through them are
+// spread over the whole project.
+void Project::SampleTasks(vector<Task*>* sample) {
+  int step = std::max(1, next_task_id_ / Constants::kQueryPlanSampleSize);
+  for (int id = 1; id < next_task_id_; id += step) {
+    if (task_ids_.Test(id)) {
+      sample->push_back(tasks_by_id_[id]);
+    }
+  }
+}
+
+// The search and query filters show exactly the matches and their ancestors,
+// and no hidden task has any filtered subtasks.
+void Project::ShownTasks(vector<Task*>* shown) {
+  shown->assign(filtered_.Begin(FilteredLists::kRoots),
+                filtered_.End(FilteredLists::kRoots));
+  for (int i = 0; i < shown->size(); ++i) {
+    int list = (*shown)[i]->Id();
+    shown->insert(shown->end(), filtered_.Begin(list), filtered_.End(list));
+  }
+}
+
+// Filters the tasks with a new search or query while the last one is still
+// showing, without visiting the tasks neither of them shows.  Since hidden
+// tasks have no filtered subtasks, the lists of the tasks the last one showed
+// are the only ones to empty.
+void Project::ShowSearchMatches(const vector<Task*>& matches) {
+  vector<Task*> shown;
+  ShownTasks(&shown);
+  for (int i = 0; i < shown.size(); ++i) {
+    filtered_.Clear(shown[i]->Id());
+  }
+  filtered_.Clear(FilteredLists::kRoots);
+
+  // Each match is added to its parent's filtered subtasks, and so on up until
+  // a task that's already been added.  The lists are sorted once they're full.
+  unordered_set<Task*> added;
+  vector<int> filled;
+  for (int i = 0; i < matches.size(); ++i) {
+    for (Task* t = matches[i]; t != NULL && added.insert(t).second;
+         t = t->Parent()) {
+      int list = ListOf(t->Parent());
+      if (filtered_.Size(list) == 0) {
+        filled.push_back(list);
+      }
+      filtered_.Append(list, t);
+      t->UpdateSortKey(sort_order_);
+    }
+  }
+  for (int i = 0; i < filled.size(); ++i) {
+    sort(filtered_.Begin(filled[i]), filtered_.End(filled[i]),
+         Task::SortsBefore);
+  }
+}
+
+// Only tasks shown now can still be shown, so just their lists are filtered,
+// from the bottom up so that each task's subtasks are done before it is.
+// Filtering a list keeps it in order.
+void Project::NarrowSearch(const string& needle) {
+  search_ = CaselessSearcher(needle);
+  vector<Task*> shown;
+  ShownTasks(&shown);
+  for (int i = 0; i < shown.size(); ++i) {
+    if (shown[i]->matches_search_) {
+      shown[i]->matches_search_ = MatchesSearch(shown[i]);
+    }
+  }
+  for (int i = shown.size() - 1; i >= 0; --i) {
+    KeepSearchResults(shown[i]->Id());
+  }
+  KeepSearchResults(FilteredLists::kRoots);
+}
+
+void Project::KeepSearchResults(int list) {
+  int size = filtered_.Size(list);
+  if (size == 0) {
+    return;
+  }
+  Task** filtered = filtered_.Begin(list);
+  int kept = 0;
+  for (int i = 0; i < size; ++i) {
+    Task* t = filtered[i];
+    if (t->matches_search_ || t->HasFilteredSubtasks()) {
+      filtered[kept++] = t;
+    }
+  }
+  filtered_.SetSize(list, kept);
+}
+
+// Saves the view shown if it has a key, and forgets the last search or query.
+// Every search match is shown, so the matches to forget are among the shown
+// tasks.  Returns whether the view was saved, which leaves no filtered lists.
+bool Project::LeaveView() {
+  bool saved = SaveView();
+  shown_view_ = NULL;
+  view_key_.clear();
+  query_.reset();
+  if (!searching_) {
+    return saved;
+  }
+  vector<Task*> shown;
+  ShownTasks(&shown);
+  for (int i = 0; i < shown.size(); ++i) {
+    shown[i]->matches_search_ = false;
+  }
+  searching_ = false;
+  search_ = CaselessSearcher("");
+  return saved;
+}
+
+// Moves the filtered lists into saved_views_, after dropping
+// the views saved that are out of date.  The least recently left views are
+// dropped to keep within Constants::kMaxSavedViewBytes.  A named view also
+// notes which of the tasks it shows are expanded and collapsed.  Lists that tasks changed
+// outside the editing helpers have left behind are saved out of date.
+bool Project::SaveView() {
+  if (view_key_.empty()) {
+    return false;
+  }
+  for (list<SavedView>::iterator it = saved_views_.begin();
+       it != saved_views_.end();) {
+    if (!UpToDate(*it)) {
+      saved_view_bytes_ -= it->bytes;
+      it = saved_views_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  saved_views_.emplace_front();
+  SavedView* saved = &saved_views_.front();
+  saved->key = view_key_;
+  saved->generation = filtered_generation_;
+  saved->view = shown_view_;
+  saved->stale = filtered_generation_ != generation_;
+  if (shown_view_ != NULL) {
+    // Only tasks with subtasks shown can be seen to be expanded or collapsed.
+    IdBitmap* expanded = &shown_view_->expanded;
+    IdBitmap* collapsed = &shown_view_->collapsed;
+    expanded->Resize(0);
+    expanded->Resize(tasks_by_id_.size());
+    collapsed->Resize(0);
+    collapsed->Resize(tasks_by_id_.size());
+    for (int id = filtered_.NextList(FilteredLists::kRoots + 1); id >= 0;
+         id = filtered_.NextList(id + 1)) {
+      if (tasks_by_id_[id]->ShouldExpand()) {
+        expanded->Set(id);
+      } else {
+        collapsed->Set(id);
+      }
+    }
+  }
+  if (query_) {
+    saved->query_matches = query_->matches;
+  }
+  saved->lists.Swap(&filtered_);
+  saved->bytes = sizeof(SavedView) + saved->lists.MemoryUsage();
+  if (query_) {
+    saved->bytes += query_->matches->MemoryUsage();
+  }
+
+  saved_view_bytes_ += saved->bytes;
+  while (saved_view_bytes_ > Constants::kMaxSavedViewBytes) {
+    saved_view_bytes_ -= saved_views_.back().bytes;
+    saved_views_.pop_back();
+  }
+  return true;
+}
+
+// Puts back the lists of the view saved as key, if it's still up to date, in
+// place of the ones shown.  Either way, the view is saved as key when it's
+// left.
+bool Project::ShowSavedView(const string& key) {
+  view_key_ = key;
+  for (list<SavedView>::iterator it = saved_views_.begin();
+       it != saved_views_.end(); ++it) {
+    if (it->key != key || !UpToDate(*it)) {
+      continue;
+    }
+    filtered_.Swap(&it->lists);
+    if (query_) {
+      query_->matches = it->query_matches;
+    }
+    saved_view_bytes_ -= it->bytes;
+    saved_views_.erase(it);
+    return true;
+  }
+  return false;
+}
+
+bool Project::UpToDate(const SavedView& saved) const {
+  return saved.view != NULL ? !saved.stale : saved.generation == generation_;
 }
 
 ostream& operator<<(ostream& out, Project& project) {
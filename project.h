@@ -3,38 +3,144 @@
 
 #include <fstream>
 #include <iostream>
+#include <list>
+#include <memory>
+#include <map>
 #include <ostream>
 #include <vector>
 #include "filter-predicate.h"
+#include "filtered-lists.h"
+#include "id-bitmap.h"
+#include "indexed-list.h"
+#include "regex-matcher.h"
+#include "string-search.h"
+#include "task-query.h"
 #include "task.h"
+#include "trigram-index.h"
 
 using std::ifstream;
+using std::list;
+using std::multimap;
 using std::ofstream;
+using std::shared_ptr;
 using std::string;
 using std::vector;
+using std::weak_ptr;
 
+class ProjectSnapshot;
 class Serializer;
+class ThreadPool;
 
-class Project : public HierarchicalListDataSource {
+class Project : public HierarchicalListDataSource, public TaskObserver {
  public:
   explicit Project(string name);
   virtual ~Project();
 
   static Project* NewProjectFromFile(string path);
 
-  void FilterTasks(FilterPredicate<Task>* filter);
-  void FilterTasks() { FilterTasks(&base_filter_); }
+  // Compiles the base filter and refilters every task with it.
+  void FilterTasks();
+  // Shows the tasks whose title, description or notes contain find, and their
+  // ancestors.  Only the tasks the search index turns up are searched, or
+  // just the last search's matches if find contains what it searched for.
   void RunSearchFilter(const string& find);
+  // Shows the tasks whose title or description has a match for regex, and
+  // their ancestors.
+  void RunRegexFilter(const shared_ptr<const RegexMatcher>& regex);
+  // Shows the tasks that pass query (see task-query.h), and their ancestors.
+  // Its tests are ordered by how they do on a sample of the tasks, and text
+  // is looked up in the search index.  Returns false, and leaves the filter
+  // alone, if query isn't valid.  Times ago count back from the start of
+  // now's minute.
+  bool RunQuery(const string& query, time_t now);
+
+  // Saves query as a view called name.  From then on the tasks that pass it
+  // are kept up to date as tasks change, so ShowView() doesn't have to test
+  // any, and the view remembers which of the tasks it shows are expanded and
+  // collapsed.
+  // Returns false if query isn't valid or there's a view called name already.
+  bool AddView(const string& name, const string& query);
+  // Returns false, and leaves the filter alone, if there's no view called
+  // name.
+  bool ShowView(const string& name);
 
   string Name() { return name_; }
   Task* AddTaskNamed(const string& name);
   void Serialize(Serializer* s);
 
+  // Returns an immutable snapshot of the whole project.  This is cheap while an
+  // earlier snapshot is still held: only the tasks that changed since then are
+  // copied.  Saving doesn't need one, and writes the live tree instead.
+  shared_ptr<const ProjectSnapshot> Snapshot();
+
   // A count of every item in the tree.
   int NumTasks();
+  int NumRootTasks() { return tasks_.Size(); }
+  // Walk the root tasks with FirstRootTask() and Task::NextSibling().
+  Task* FirstRootTask();
+  // How many tasks share t's parent, t included.
+  int NumSiblings(Task* t);
   void DeleteTask(Task* t);
 
-  // Various Common Filters
+  // Finds the tasks in the project by id in O(1), or by how their titles start
+  // in O(log n), ignoring case and runs of whitespace.  At most max_results
+  // tasks are returned, in title order.
+  Task* TaskWithId(int id);
+  vector<Task*> TasksWithTitlePrefix(const string& prefix, int max_results);
+
+  // Roughly how many bytes the search index takes up.
+  size_t SearchIndexMemoryUsage();
+
+  // Whether the current filter shows t and all of its ancestors.
+  bool IsShown(Task* t);
+
+  // Editing helpers that keep node statuses and filter results up to date by
+  // only looking at the edited task and its ancestors, instead of the whole
+  // project.  Each returns the task whose subtree now looks different in the
+  // filtered tree, which is the only part a HierarchicalList has to update.
+  //
+  // DetachTask() takes t and its offspring out of the tree without deleting
+  // them, and reports where t was so AttachTask() can put it back.  A NULL
+  // parent means the list of root tasks.  AttachTask() also takes whole new
+  // subtrees, such as those made by Task::Clone(), and hands their tasks ids.
+  Task* DetachTask(Task* t, Task** parent, int* index);
+  Task* AttachTask(Task* t, Task* parent, int index);
+  Task* TaskEdited(Task* t);
+
+  // Moves t and its offspring to position index among parent's subtasks,
+  // without revisiting the subtree itself.  Reports where t was like
+  // DetachTask(), and appends the tasks a list has to update to |changed|.
+  // Moving a task among its own siblings takes O(log^2 n) time in the number
+  // of siblings, plus shifting the filtered siblings along.
+  void MoveTask(Task* t, Task* parent, int index, Task** old_parent,
+                int* old_index, vector<Task*>* changed);
+
+  // Edits made between BeginBatch() and EndBatch() leave statuses and filter
+  // results alone, and return NULL instead of a task, since what changed isn't
+  // known until the end.  EndBatch() then brings everything up to date in a
+  // single pass over the tasks on the paths from the edits to the roots, and
+  // adds the root tasks those paths reach to changed.  If any task was moved
+  // or taken out of the tree, or several roots may have been resorted, it adds
+  // NULL instead, since the whole list needs updating.
+  // Batches can be nested.
+  void BeginBatch();
+  void EndBatch(vector<Task*>* changed);
+
+  // Returns the index to MoveTask() t to so it moves |offset| places among the
+  // siblings the current filter shows, or up if offset is negative.  Hidden
+  // siblings in between are jumped over.  Only meaningful while tasks are
+  // shown in their stored order.
+  int SiblingIndexAfterMoving(Task* t, int offset);
+
+  // Shows every task's filtered subtasks in |order|.  The stored order of the
+  // tasks is left alone.  Changing the order resorts the whole view, but
+  // after that edits only move the edited tasks.
+  void SetSortOrder(SortOrder order);
+  SortOrder CurrentSortOrder() { return sort_order_; }
+
+  // Various Common Filters.  These and queries are saved when another view
+  // is shown, until the project next changes, so that switching back to them
+  // doesn't filter the tasks again.
   void ShowAllTasks();
   void ShowCompletedLastWeek();
   void ArchiveCompletedTasks();
@@ -49,13 +155,143 @@ class Project : public HierarchicalListDataSource {
   void RecomputeNodeStatus();
   friend ostream& operator<<(ostream& out, Project& project);
 
+  // Set when the project is shown as one line of a bigger tree, such as a
+  // ProjectSet, so its root tasks show up below that line.
+  void SetListParentOfRoots(ListItem* item) { list_parent_of_roots_ = item; }
+
+  // Large projects are filtered in parallel on pool, which may be NULL.
+  void SetThreadPool(ThreadPool* pool) { thread_pool_ = pool; }
+
+  // Functions required by TaskObserver:
+  void TaskChanged(Task* t);
+  ListItem* ListParentOfRoots() { return list_parent_of_roots_; }
+
  private:
   TaskStatus ComputeStatusForTask(Task* t);
+  TaskStatus UpdateStatusFromChildren(Task* t);
+  Task* RecomputeStatusAbove(Task* parent);
+  Task* RefilterAncestors(Task* t, Task* must_reach);
+  bool Refilter(Task* t);
+  Task* InsertTask(Task* t, Task* parent, int index);
+  Task* TakeOutTask(Task* t, Task** parent, int* index);
+  void IndexTasks(Task* t);
+  void UnindexTasks(Task* t);
+  void UpdateTitleIndex(Task* t);
+  static string TitleKey(const string& title);
+  void AssignIds(Task* t);
+  void UpdateSearchIndex(Task* t);
+  void UpdateStatusIndexes(Task* t);
+  void UpdateQueryMatches(Task* t);
+  void ForgetQueryMatches(Task* t);
+  bool MatchesSearch(Task* t);
+  void StaleViewsShowing(Task* t);
+  static bool Shows(FilteredLists* lists, Task* t);
+  bool LeaveView();
+  bool SaveView();
+  bool ShowSavedView(const string& key);
+  void RestoreExpanded(const IdBitmap& ids, bool expand);
+  struct LiveQuery;
+  shared_ptr<LiveQuery> PlanQuery(const string& query, time_t now);
+  void EvaluateQuery(LiveQuery* live);
+  void FilterByQueryMatches();
+  void ShowQueryMatches(bool was_showing_matches);
+  void ShownTasks(vector<Task*>* shown);
+  void SampleTasks(vector<Task*>* sample);
+  void ShowSearchMatches(const vector<Task*>& matches);
+  void NarrowSearch(const string& needle);
+  void KeepSearchResults(int list);
+  vector<Task*> FilterSiblings(const vector<Task*>& siblings);
+  static int ListOf(Task* parent);
+  int FilteredIndex(int list, Task* t);
+  bool RemoveFiltered(int list, Task* t);
+  void AddRootTask(Task* t);
+  void InsertRootTask(Task* t, int index);
 
   string name_;
-  vector<Task*> tasks_;
-  vector<Task*> filtered_tasks_;
+  IndexedList<Task*> tasks_;
+  // What the filter shows: each task's filtered subtasks, and the filtered
+  // root tasks.
+  FilteredLists filtered_;
   AndFilterPredicate<Task> base_filter_;
+  // base_filter_ compiled, which is what tasks are actually filtered with.
+  FilterProgram<Task> base_program_;
+  SortOrder sort_order_;
+  ListItem* list_parent_of_roots_;
+  ThreadPool* thread_pool_;
+  weak_ptr<const ProjectSnapshot> snapshot_;
+  int next_task_id_;
+  // Every task by id, and NULL for ids not in use, which are clear in
+  // task_ids_.
+  vector<Task*> tasks_by_id_;
+  IdBitmap task_ids_;
+  multimap<string, Task*> tasks_by_title_;
+  int batch_depth_;
+  vector<Task*> batch_edits_;
+  // Whether a task was moved or taken out of the tree since the batch began.
+  bool batch_moved_;
+  // Every task's text, by trigram.
+  TrigramIndex search_index_;
+  // The tasks with each status, and when tasks were created and completed,
+  // which queries look up.
+  shared_ptr<IdBitmap> tasks_with_status_[NUM_STATUSES];
+  TaskQuery::TimeIndex tasks_by_creation_;
+  TaskQuery::TimeIndex tasks_by_completion_;
+  // While RunSearchFilter()'s filter is the base filter, what it searched for.
+  // The tasks that match have Task::matches_search_ set.
+  bool searching_;
+  CaselessSearcher search_;
+  // A query, and the tasks that pass it by id, kept up to date as tasks
+  // change.  Only the tasks in the candidates of each lookup in the indexes
+  // are tested for what was looked up, so changed tasks are added to them.
+  struct LiveQuery {
+    vector<TaskQuery::IdSet> candidates;
+    AndFilterPredicate<Task> filter;
+    shared_ptr<IdBitmap> matches;
+  };
+  static void UpdateMatch(LiveQuery* live, Task* t);
+  // While RunQuery()'s or ShowView()'s filter is the base filter, its query.
+  shared_ptr<LiveQuery> query_;
+
+  // A query saved under a name, and the tasks expanded and collapsed when it
+  // was last shown, by id.
+  struct View {
+    string name;
+    string query;
+    // Whether it has times ago, and the minute they count back from.
+    bool relative;
+    time_t now;
+    shared_ptr<LiveQuery> live;
+    IdBitmap expanded;
+    IdBitmap collapsed;
+  };
+  list<View> views_;
+  View* shown_view_;
+
+  // Bumped by every change to the tasks.
+  unsigned long generation_;
+  // The generation filtered_ was last brought up to date at, by filtering or
+  // by one of the editing helpers.  Tasks changed any other way, such as
+  // while a project is loaded, leave it behind.
+  unsigned long filtered_generation_;
+  // What the view shown is saved as when it's left, or empty if it isn't.
+  string view_key_;
+  // A view's filtered lists, swapped out of filtered_ whole.  A named
+  // view's lists stay up to date until a task they show, or a task that now
+  // passes its query, changes.  Other views' lists only last until any task
+  // changes.
+  struct SavedView {
+    string key;
+    unsigned long generation;
+    View* view;
+    bool stale;
+    FilteredLists lists;
+    shared_ptr<IdBitmap> query_matches;
+    size_t bytes;
+  };
+  bool UpToDate(const SavedView& saved) const;
+  // The views left that are still up to date, most recently left first.
+  list<SavedView> saved_views_;
+  size_t saved_view_bytes_;
 };
 
 #endif  // PROJECT_H_
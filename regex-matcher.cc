@@ -0,0 +1,584 @@
+#include "regex-matcher.h"
+#include <ctype.h>
+#include <algorithm>
+#include <bitset>
+#include <map>
+#include <mutex>
+#include <utility>
+
+using std::bitset;
+using std::lock_guard;
+using std::make_pair;
+using std::map;
+using std::mutex;
+using std::pair;
+
+// Patterns that need more states than these are turned down, rather than
+// taking up a lot of memory.
+static const int kMaxNfaStates = 2000;
+static const int kMaxDfaStates = 2048;
+// How many compiled patterns are kept for reuse.
+static const int kMaxCachedPatterns = 64;
+
+typedef bitset<256> ByteSet;
+
+// The parsed pattern, as a tree of nodes that refer to each other by index.
+struct RegexNode {
+  enum Type { BYTES, CONCAT, ALTERNATE, REPEAT };
+  Type type;
+  // For BYTES, the index of the bytes it matches.
+  int set;
+  vector<int> children;
+  // For REPEAT, how many times its child is repeated.  max is -1 for no
+  // limit.
+  int min, max;
+};
+
+class RegexParser {
+ public:
+  explicit RegexParser(const string& pattern) : pattern_(pattern), pos_(0) {}
+
+  // Returns the root node, or -1 after saying what's wrong in error.
+  int Parse(string* error);
+
+  vector<RegexNode> nodes_;
+  vector<ByteSet> sets_;
+
+ private:
+  int ParseAlternation();
+  int ParseConcatenation();
+  int ParseRepeat();
+  int ParseAtom();
+  bool ParseClass(ByteSet* set);
+  bool ParseEscape(ByteSet* set);
+  bool ParseNumber(int* n);
+  bool AtRepeat();
+  int AddNode(RegexNode::Type type);
+  int AddBytes(const ByteSet& set);
+  int Fail(const string& error);
+
+  const string& pattern_;
+  int pos_;
+  string error_;
+};
+
+int RegexParser::Parse(string* error) {
+  int root = ParseAlternation();
+  if (root >= 0 && pos_ < pattern_.size()) {
+    root = Fail("unmatched )");
+  }
+  *error = error_;
+  return root;
+}
+
+int RegexParser::ParseAlternation() {
+  int first = ParseConcatenation();
+  if (first < 0 || pos_ == pattern_.size() || pattern_[pos_] != '|') {
+    return first;
+  }
+  int alternate = AddNode(RegexNode::ALTERNATE);
+  nodes_[alternate].children.push_back(first);
+  while (pos_ < pattern_.size() && pattern_[pos_] == '|') {
+    ++pos_;
+    int next = ParseConcatenation();
+    if (next < 0) {
+      return -1;
+    }
+    nodes_[alternate].children.push_back(next);
+  }
+  return alternate;
+}
+
+int RegexParser::ParseConcatenation() {
+  int concat = AddNode(RegexNode::CONCAT);
+  while (pos_ < pattern_.size() && pattern_[pos_] != '|' &&
+         pattern_[pos_] != ')') {
+    int next = ParseRepeat();
+    if (next < 0) {
+      return -1;
+    }
+    nodes_[concat].children.push_back(next);
+  }
+  return concat;
+}
+
+bool RegexParser::AtRepeat() {
+  if (pos_ == pattern_.size()) {
+    return false;
+  }
+  char c = pattern_[pos_];
+  // A brace that doesn't start a count is just a brace.
+  return c == '*' || c == '+' || c == '?' ||
+         (c == '{' && pos_ + 1 < pattern_.size() &&
+          isdigit(static_cast<unsigned char>(pattern_[pos_ + 1])));
+}
+
+int RegexParser::ParseRepeat() {
+  int atom = ParseAtom();
+  while (atom >= 0 && AtRepeat()) {
+    int repeat = AddNode(RegexNode::REPEAT);
+    nodes_[repeat].children.push_back(atom);
+    char c = pattern_[pos_++];
+    int min = c == '+' ? 1 : 0;
+    int max = c == '?' ? 1 : -1;
+    if (c == '{') {
+      if (!ParseNumber(&min)) {
+        return -1;
+      }
+      max = min;
+      if (pos_ < pattern_.size() && pattern_[pos_] == ',') {
+        ++pos_;
+        max = -1;
+        if (pos_ < pattern_.size() && pattern_[pos_] != '}' &&
+            !ParseNumber(&max)) {
+          return -1;
+        }
+      }
+      if (pos_ == pattern_.size() || pattern_[pos_] != '}') {
+        return Fail("missing }");
+      }
+      ++pos_;
+      if (max != -1 && max < min) {
+        return Fail("bad repeat count");
+      }
+    }
+    nodes_[repeat].min = min;
+    nodes_[repeat].max = max;
+    atom = repeat;
+  }
+  return atom;
+}
+
+bool RegexParser::ParseNumber(int* n) {
+  *n = 0;
+  int start = pos_;
+  while (pos_ < pattern_.size() &&
+         isdigit(static_cast<unsigned char>(pattern_[pos_]))) {
+    *n = *n * 10 + (pattern_[pos_++] - '0');
+    if (*n > kMaxNfaStates) {
+      Fail("repeat count too large");
+      return false;
+    }
+  }
+  if (pos_ == start) {
+    Fail("bad repeat count");
+    return false;
+  }
+  return true;
+}
+
+int RegexParser::ParseAtom() {
+  char c = pattern_[pos_++];
+  ByteSet set;
+  switch (c) {
+    case '(': {
+      if (pattern_.compare(pos_, 2, "?:") == 0) {
+        pos_ += 2;
+      }
+      int group = ParseAlternation();
+      if (group >= 0 && (pos_ == pattern_.size() || pattern_[pos_] != ')')) {
+        return Fail("missing )");
+      }
+      ++pos_;
+      return group;
+    }
+    case '[':
+      if (!ParseClass(&set)) {
+        return -1;
+      }
+      break;
+    case '.':
+      set.set();
+      set.reset('\n');
+      break;
+    case '\\':
+      if (!ParseEscape(&set)) {
+        return -1;
+      }
+      break;
+    case '^':
+    case '$':
+      return Fail("^ and $ only go at the ends");
+    case '*':
+    case '+':
+    case '?':
+      return Fail("nothing to repeat");
+    default:
+      set.set(static_cast<unsigned char>(c));
+  }
+  return AddBytes(set);
+}
+
+bool RegexParser::ParseClass(ByteSet* set) {
+  bool negated = pos_ < pattern_.size() && pattern_[pos_] == '^';
+  if (negated) {
+    ++pos_;
+  }
+  bool first = true;
+  while (pos_ < pattern_.size() && (first || pattern_[pos_] != ']')) {
+    first = false;
+    unsigned char low = pattern_[pos_++];
+    if (low == '\\') {
+      // An escape can't start a range, since it might be a whole class.
+      if (!ParseEscape(set)) {
+        return false;
+      }
+      continue;
+    }
+    unsigned char high = low;
+    if (pos_ + 1 < pattern_.size() && pattern_[pos_] == '-' &&
+        pattern_[pos_ + 1] != ']') {
+      high = pattern_[pos_ + 1];
+      pos_ += 2;
+      if (high < low) {
+        Fail("bad range in []");
+        return false;
+      }
+    }
+    for (int b = low; b <= high; ++b) {
+      set->set(b);
+    }
+  }
+  if (pos_ == pattern_.size()) {
+    Fail("missing ]");
+    return false;
+  }
+  ++pos_;
+  if (negated) {
+    set->flip();
+  }
+  return true;
+}
+
+// The bytes \d, \w or \s stands for.
+static ByteSet ClassFor(char kind) {
+  ByteSet bytes;
+  for (int b = 0; b < 256; ++b) {
+    bytes[b] = kind == 'd'   ? isdigit(b)
+               : kind == 'w' ? isalnum(b) || b == '_'
+                             : isspace(b);
+  }
+  return bytes;
+}
+
+bool RegexParser::ParseEscape(ByteSet* set) {
+  if (pos_ == pattern_.size()) {
+    Fail("trailing \\");
+    return false;
+  }
+  unsigned char c = pattern_[pos_++];
+  ByteSet bytes;
+  switch (c) {
+    case 'd':
+    case 'w':
+    case 's':
+      bytes = ClassFor(c);
+      break;
+    case 'D':
+    case 'W':
+    case 'S':
+      bytes = ~ClassFor(tolower(c));
+      break;
+    case 't':
+      bytes.set('\t');
+      break;
+    case 'n':
+      bytes.set('\n');
+      break;
+    case 'r':
+      bytes.set('\r');
+      break;
+    default:
+      if (isalnum(c)) {
+        Fail(string("unknown escape \\") + static_cast<char>(c));
+        return false;
+      }
+      bytes.set(c);
+  }
+  *set |= bytes;
+  return true;
+}
+
+int RegexParser::AddNode(RegexNode::Type type) {
+  RegexNode node;
+  node.type = type;
+  node.set = -1;
+  node.min = node.max = 0;
+  nodes_.push_back(node);
+  return nodes_.size() - 1;
+}
+
+int RegexParser::AddBytes(const ByteSet& set) {
+  int node = AddNode(RegexNode::BYTES);
+  nodes_[node].set = sets_.size();
+  sets_.push_back(set);
+  return node;
+}
+
+int RegexParser::Fail(const string& error) {
+  if (error_.empty()) {
+    error_ = error;
+  }
+  // Nothing more is parsed.
+  pos_ = pattern_.size();
+  return -1;
+}
+
+// A Thompson automaton, built from the end of the pattern back to the start
+// so that each piece is compiled knowing where it goes next.
+class Nfa {
+ public:
+  enum { kEpsilon = -1, kMatch = -2 };
+  struct State {
+    // The index of the bytes this state reads, or kEpsilon or kMatch.
+    int set;
+    int out, out1;
+  };
+
+  explicit Nfa(const RegexParser& parser) : parser_(parser) {}
+
+  // Returns the start state, or -1 if there would be too many states.
+  int Build(int root) { return Compile(root, AddState(kMatch, -1, -1)); }
+
+  vector<State> states_;
+
+ private:
+  int Compile(int node, int next);
+  int AddState(int set, int out, int out1);
+
+  const RegexParser& parser_;
+};
+
+int Nfa::AddState(int set, int out, int out1) {
+  if (states_.size() >= kMaxNfaStates) {
+    return -1;
+  }
+  State state = {set, out, out1};
+  states_.push_back(state);
+  return states_.size() - 1;
+}
+
+int Nfa::Compile(int node, int next) {
+  if (next < 0) {
+    return -1;
+  }
+  const RegexNode& n = parser_.nodes_[node];
+  switch (n.type) {
+    case RegexNode::BYTES:
+      return AddState(n.set, next, -1);
+    case RegexNode::CONCAT:
+      for (int i = n.children.size() - 1; i >= 0 && next >= 0; --i) {
+        next = Compile(n.children[i], next);
+      }
+      return next;
+    case RegexNode::ALTERNATE: {
+      int start = Compile(n.children.back(), next);
+      for (int i = n.children.size() - 2; i >= 0 && start >= 0; --i) {
+        start = AddState(kEpsilon, Compile(n.children[i], next), start);
+        if (start >= 0 && states_[start].out < 0) {
+          return -1;
+        }
+      }
+      return start;
+    }
+    case RegexNode::REPEAT: {
+      int child = n.children[0];
+      int start = next;
+      if (n.max == -1) {
+        // A loop: the state either goes through the child and back, or on.
+        int loop = AddState(kEpsilon, -1, next);
+        if (loop < 0) {
+          return -1;
+        }
+        int body = Compile(child, loop);
+        if (body < 0) {
+          return -1;
+        }
+        states_[loop].out = body;
+        start = loop;
+      } else {
+        for (int i = n.min; i < n.max && start >= 0; ++i) {
+          int body = Compile(child, start);
+          start = body < 0 ? -1 : AddState(kEpsilon, body, start);
+        }
+      }
+      for (int i = 0; i < n.min && start >= 0; ++i) {
+        start = Compile(child, start);
+      }
+      return start;
+    }
+  }
+  return -1;
+}
+
+// Adds the states that read bytes or match which state leads to without
+// reading anything.
+static void AddClosure(const Nfa& nfa, int state, vector<bool>* seen,
+                       vector<int>* closure) {
+  if (state < 0 || (*seen)[state]) {
+    return;
+  }
+  (*seen)[state] = true;
+  const Nfa::State& s = nfa.states_[state];
+  if (s.set == Nfa::kEpsilon) {
+    AddClosure(nfa, s.out, seen, closure);
+    AddClosure(nfa, s.out1, seen, closure);
+  } else {
+    closure->push_back(state);
+  }
+}
+
+RegexMatcher::RegexMatcher(const string& pattern)
+    : pattern_(pattern),
+      num_classes_(0),
+      dead_state_(-1),
+      anchored_at_end_(false) {}
+
+bool RegexMatcher::Compile(string* error) {
+  string body = pattern_;
+  bool anchored_at_start = !body.empty() && body[0] == '^';
+  if (anchored_at_start) {
+    body.erase(0, 1);
+  }
+  // A "$" at the end anchors unless it's escaped.
+  int backslashes = 0;
+  for (int i = body.size() - 2; i >= 0 && body[i] == '\\'; --i) {
+    ++backslashes;
+  }
+  anchored_at_end_ =
+      !body.empty() && body[body.size() - 1] == '$' && backslashes % 2 == 0;
+  if (anchored_at_end_) {
+    body.erase(body.size() - 1);
+  }
+
+  RegexParser parser(body);
+  int root = parser.Parse(error);
+  if (root < 0) {
+    return false;
+  }
+  Nfa nfa(parser);
+  int nfa_start = nfa.Build(root);
+  if (nfa_start < 0) {
+    *error = "pattern too large";
+    return false;
+  }
+
+  // Split the bytes up by which of the pattern's sets they're in.
+  std::fill(byte_class_, byte_class_ + 256, 0);
+  num_classes_ = 1;
+  for (int i = 0; i < parser.sets_.size(); ++i) {
+    map<pair<int, bool>, int> split;
+    for (int b = 0; b < 256; ++b) {
+      pair<int, bool> key = make_pair(byte_class_[b], parser.sets_[i][b]);
+      map<pair<int, bool>, int>::iterator it = split.find(key);
+      if (it == split.end()) {
+        it = split.insert(make_pair(key, static_cast<int>(split.size()))).first;
+      }
+      byte_class_[b] = it->second;
+    }
+    num_classes_ = split.size();
+  }
+  vector<unsigned char> class_byte(num_classes_);
+  for (int b = 255; b >= 0; --b) {
+    class_byte[byte_class_[b]] = b;
+  }
+
+  // Each state of the automaton is the set of states the Thompson automaton
+  // could be in.  A pattern that can match anywhere could also be starting
+  // over at every byte.
+  vector<bool> seen(nfa.states_.size());
+  vector<int> start;
+  AddClosure(nfa, nfa_start, &seen, &start);
+  sort(start.begin(), start.end());
+  vector<vector<int> > states(1, start);
+  map<vector<int>, int> state_ids;
+  state_ids[start] = 0;
+  for (int s = 0; s < states.size(); ++s) {
+    bool accepting = false;
+    for (int i = 0; i < states[s].size(); ++i) {
+      accepting |= nfa.states_[states[s][i]].set == Nfa::kMatch;
+    }
+    accepting_.push_back(accepting);
+    if (states[s].empty()) {
+      dead_state_ = s;
+    }
+    for (int c = 0; c < num_classes_; ++c) {
+      // Once something matches, nothing after it matters.
+      if (accepting && !anchored_at_end_) {
+        transitions_.push_back(s);
+        continue;
+      }
+      std::fill(seen.begin(), seen.end(), false);
+      vector<int> next;
+      for (int i = 0; i < states[s].size(); ++i) {
+        const Nfa::State& state = nfa.states_[states[s][i]];
+        if (state.set >= 0 && parser.sets_[state.set][class_byte[c]]) {
+          AddClosure(nfa, state.out, &seen, &next);
+        }
+      }
+      if (!anchored_at_start) {
+        AddClosure(nfa, nfa_start, &seen, &next);
+      }
+      sort(next.begin(), next.end());
+      map<vector<int>, int>::iterator it = state_ids.find(next);
+      if (it == state_ids.end()) {
+        if (states.size() >= kMaxDfaStates) {
+          *error = "pattern too complex";
+          return false;
+        }
+        it = state_ids.insert(make_pair(next, static_cast<int>(states.size())))
+                 .first;
+        states.push_back(next);
+      }
+      transitions_.push_back(it->second);
+    }
+  }
+  return true;
+}
+
+bool RegexMatcher::FoundIn(const char* text, size_t size) const {
+  const int* transitions = &transitions_[0];
+  int state = 0;
+  if (!anchored_at_end_) {
+    // The accepting states loop back on themselves, so only the end matters,
+    // but stopping early saves reading the rest.
+    for (size_t i = 0; i < size && !accepting_[state]; ++i) {
+      state = transitions[state * num_classes_ +
+                          byte_class_[static_cast<unsigned char>(text[i])]];
+    }
+    return accepting_[state];
+  }
+  for (size_t i = 0; i < size && state != dead_state_; ++i) {
+    state = transitions[state * num_classes_ +
+                        byte_class_[static_cast<unsigned char>(text[i])]];
+  }
+  return accepting_[state];
+}
+
+shared_ptr<const RegexMatcher> RegexMatcher::Compiled(const string& pattern,
+                                                      string* error) {
+  static mutex cache_mutex;
+  static map<string, shared_ptr<const RegexMatcher> > cache;
+  {
+    lock_guard<mutex> lock(cache_mutex);
+    map<string, shared_ptr<const RegexMatcher> >::iterator it =
+        cache.find(pattern);
+    if (it != cache.end()) {
+      return it->second;
+    }
+  }
+
+  RegexMatcher* matcher = new RegexMatcher(pattern);
+  if (!matcher->Compile(error)) {
+    delete matcher;
+    return shared_ptr<const RegexMatcher>();
+  }
+  shared_ptr<const RegexMatcher> compiled(matcher);
+  lock_guard<mutex> lock(cache_mutex);
+  // Whoever still uses a dropped matcher keeps it alive.
+  if (cache.size() >= kMaxCachedPatterns) {
+    cache.clear();
+  }
+  cache[pattern] = compiled;
+  return compiled;
+}
@@ -0,0 +1,71 @@
+#ifndef REGEX_MATCHER_H_
+#define REGEX_MATCHER_H_
+
+// Finds regular expressions in texts in time linear in the text, however the
+// pattern is written:
+//
+//   string error;
+//   shared_ptr<const RegexMatcher> regex =
+//       RegexMatcher::Compiled("[A-Z]+-[0-9]+", &error);
+//   if (regex && regex->FoundIn(t->Title())) ...
+//
+// The pattern is compiled into a deterministic automaton up front, so a text
+// is matched by looking up one transition per byte, and never backtracks.
+// Compiled matchers are cached by pattern and never change, so any number of
+// threads can share one.
+//
+// The syntax is the usual one, without backreferences: literals, ".", classes
+// like [a-z] and [^0-9], the escapes \d \w \s (and \D \W \S), grouping with
+// parentheses, "|", and the repeats *, +, ?, {n}, {n,} and {n,m}.  "^" at the
+// start and "$" at the end anchor the pattern to the ends of the text;
+// otherwise it can match anywhere in it.  Case matters.
+
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+class RegexMatcher {
+ public:
+  // The matcher for pattern, compiling it if no one has lately.  Returns NULL,
+  // and says why in error, if pattern isn't valid or needs too many states.
+  static shared_ptr<const RegexMatcher> Compiled(const string& pattern,
+                                                 string* error);
+
+  const string& Pattern() const { return pattern_; }
+  int NumStates() const { return accepting_.size(); }
+
+  bool FoundIn(const char* text, size_t size) const;
+  bool FoundIn(const string& text) const {
+    return FoundIn(text.data(), text.size());
+  }
+
+ private:
+  explicit RegexMatcher(const string& pattern);
+  // Not copyable.
+  RegexMatcher(const RegexMatcher&);
+  RegexMatcher& operator=(const RegexMatcher&);
+
+  // Builds the automaton, or returns false and says why in error.
+  bool Compile(string* error);
+
+  string pattern_;
+  // Bytes that every part of the pattern treats alike share a class, so the
+  // transition table has a column per class rather than per byte.
+  unsigned char byte_class_[256];
+  int num_classes_;
+  // The state after state s reads a byte of class c is
+  // transitions_[s * num_classes_ + c].  State 0 is the start.
+  vector<int> transitions_;
+  vector<bool> accepting_;
+  // The state no match can come from any more, or -1.
+  int dead_state_;
+  // Whether a match has to end at the end of the text, rather than anywhere.
+  bool anchored_at_end_;
+};
+
+#endif  // REGEX_MATCHER_H_
@@ -0,0 +1,155 @@
+#include "regex-matcher.h"
+#include <stdlib.h>
+#include <iostream>
+#include <regex>
+#include <string>
+
+using namespace std;
+
+static int errors = 0;
+
+ostream& ERROR() {
+  ++errors;
+  cout << "Error: ";
+  return cout;
+}
+
+bool FoundIn(const string& pattern, const string& text) {
+  string error;
+  shared_ptr<const RegexMatcher> regex =
+      RegexMatcher::Compiled(pattern, &error);
+  if (!regex) {
+    ERROR() << "\"" << pattern << "\" didn't compile: " << error << endl;
+    return false;
+  }
+  return regex->FoundIn(text);
+}
+
+bool TestMatching() {
+  cout << "Testing matching patterns" << endl;
+  struct {
+    const char* pattern;
+    const char* text;
+    bool found;
+  } cases[] = {
+      {"[A-Z]+-[0-9]+", "Fix OPS-1234 before Friday", true},
+      {"[A-Z]+-[0-9]+", "Fix ops-1234 before Friday", false},
+      {"^Fix", "Fix the bike", true},
+      {"^Fix", "Don't fix the bike", false},
+      {"bike$", "Fix the bike", true},
+      {"bike$", "Fix the bike tomorrow", false},
+      {"^$", "", true},
+      {"colou?r", "the color red", true},
+      {"(ab|cd){2}x", "zzabcdx", true},
+      {"(ab|cd){2}x", "zzabx", false},
+      {"a{2,}", "baab", true},
+      {"a{2,3}b", "aaaab", true},
+      {"\\d\\d:\\d\\d", "at 09:30", true},
+      {"\\w+@\\w+\\.com", "mail bob@example.com", true},
+      {"[^a-z ]", "only lower case", false},
+      {"1\\.5", "version 1x5", false},
+      {"a.c", "abc", true},
+      {"x{", "x{", true},
+      {"costs \\$5$", "it costs $5", true},
+  };
+  bool success = true;
+  for (int i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+    if (FoundIn(cases[i].pattern, cases[i].text) != cases[i].found) {
+      ERROR() << "\"" << cases[i].pattern << "\" in \"" << cases[i].text
+              << "\" should be " << cases[i].found << "." << endl;
+      success = false;
+    }
+  }
+  return success;
+}
+
+bool TestErrors() {
+  cout << "Testing turning down bad patterns" << endl;
+  const char* bad[] = {"(ab", "ab)", "[a-", "*a", "a{2", "\\q", "a^b",
+                       "a{3,2}", "(a{1000}){1000}"};
+  for (int i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+    string error;
+    if (RegexMatcher::Compiled(bad[i], &error) || error.empty()) {
+      ERROR() << "\"" << bad[i] << "\" compiled." << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TestCaching() {
+  cout << "Testing compiled patterns are reused" << endl;
+  string error;
+  if (RegexMatcher::Compiled("[A-Z]+-[0-9]+", &error) !=
+      RegexMatcher::Compiled("[A-Z]+-[0-9]+", &error)) {
+    ERROR() << "The same pattern was compiled twice." << endl;
+    return false;
+  }
+  return true;
+}
+
+bool TestNoBacktracking() {
+  cout << "Testing patterns that backtrack badly" << endl;
+  // Backtracking tries every way of splitting the a's up before failing.
+  string text(100000, 'a');
+  if (FoundIn("(a*)*b", text) || FoundIn("(a|aa)+c", text + "b") ||
+      !FoundIn("(a|aa)+b$", text + "b")) {
+    ERROR() << "Long runs of a matched wrong." << endl;
+    return false;
+  }
+  return true;
+}
+
+// Builds a random pattern out of a few letters and every operator.
+string RandomPattern(int depth) {
+  int choice = rand() % (depth > 3 ? 3 : 9);
+  switch (choice) {
+    case 0:
+      return "a";
+    case 1:
+      return "b";
+    case 2:
+      return rand() % 2 ? "." : "[ab]";
+    case 3:
+      return RandomPattern(depth + 1) + RandomPattern(depth + 1);
+    case 4:
+      return "(" + RandomPattern(depth + 1) + "|" + RandomPattern(depth + 1) +
+             ")";
+    case 5:
+      return "(" + RandomPattern(depth + 1) + ")*";
+    case 6:
+      return "(" + RandomPattern(depth + 1) + ")+";
+    case 7:
+      return "(" + RandomPattern(depth + 1) + ")?";
+    default:
+      return "(" + RandomPattern(depth + 1) + "){1,2}";
+  }
+}
+
+bool TestAgreesWithStdRegex() {
+  cout << "Testing random patterns against std::regex" << endl;
+  srand(44);
+  for (int round = 0; round < 2000; ++round) {
+    string pattern = RandomPattern(0);
+    if (rand() % 4 == 0) pattern = "^" + pattern;
+    if (rand() % 4 == 0) pattern += "$";
+    string text;
+    for (int i = rand() % 8; i > 0; --i) {
+      text += "abc"[rand() % 3];
+    }
+    bool expected = regex_search(text, regex(pattern));
+    if (FoundIn(pattern, text) != expected) {
+      ERROR() << "\"" << pattern << "\" in \"" << text << "\" should be "
+              << expected << "." << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+int main() {
+  bool success = TestMatching() && TestErrors() && TestCaching() &&
+                 TestNoBacktracking() && TestAgreesWithStdRegex();
+  cout << errors << " errors." << endl;
+  return !success;
+}
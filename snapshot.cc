@@ -0,0 +1,103 @@
+#include "snapshot.h"
+#include "file-versions.h"
+#include "serializer.h"
+
+TaskSnapshot::TaskSnapshot(Task* t)
+    : id_(t->id_),
+      title_(t->title_),
+      description_(t->description_),
+      status_(t->status_),
+      creation_date_(t->creation_date_),
+      start_date_(t->start_date_),
+      completion_date_(t->completion_date_),
+      status_changes_(t->status_changes_) {
+  notes_.reserve(t->notes_.size());
+  for (int i = 0; i < t->notes_.size(); ++i) {
+    notes_.push_back(*t->notes_[i]);
+  }
+
+  children_.reserve(t->NumChildren());
+  for (Task* c = t->FirstChild(); c != NULL; c = c->NextSibling()) {
+    children_.push_back(c->Snapshot());
+  }
+}
+
+int TaskSnapshot::NumOffspring() const {
+  int sum_from_children = 0;
+  for (int i = 0; i < children_.size(); ++i) {
+    sum_from_children += 1 + children_[i]->NumOffspring();
+  }
+  return sum_from_children;
+}
+
+void TaskSnapshot::Serialize(Serializer* s, const TaskSnapshot* parent) const {
+  // Initially we store a unique identifier to ourselves that will help with
+  // reading in the tasks and assembling the tree.  A node appears only once in
+  // any tree, so its address is unique even though it may be shared.
+  s->WriteUint64((uint64)this);
+
+  // Data about this task.
+  s->WriteString(title_);
+  s->WriteString(description_);
+  s->WriteInt32(static_cast<int32>(status_));
+
+  // Various dates.
+  creation_date_.Serialize(s);
+  start_date_.Serialize(s);
+  completion_date_.Serialize(s);
+
+  // The notes associated with this task.
+  if (s->Version() >= NOTES_VERSION) {
+    s->WriteInt32(notes_.size());
+    for (int i = 0; i < notes_.size(); ++i) {
+      notes_[i].Serialize(s);
+    }
+  }
+
+  // Task status changes.
+  if (s->Version() >= TASK_STATUS_VERSION) {
+    s->WriteInt32(status_changes_.size());
+    for (int i = 0; i < status_changes_.size(); ++i) {
+      status_changes_[i].date.Serialize(s);
+      s->WriteInt32(status_changes_[i].status);
+    }
+  }
+
+  if (s->Version() >= TASK_ID_VERSION) {
+    s->WriteInt32(id_);
+  }
+
+  // Finally our parent pointer and then we move onto the children.
+  s->WriteUint64((uint64)parent);
+  for (int i = 0; i < children_.size(); ++i) {
+    children_[i]->Serialize(s, this);
+  }
+}
+
+ProjectSnapshot::ProjectSnapshot(
+    const string& name, const vector<shared_ptr<const TaskSnapshot> >& roots)
+    : name_(name), roots_(roots) {}
+
+int ProjectSnapshot::NumTasks() const {
+  int total = 0;
+  for (int i = 0; i < roots_.size(); ++i) {
+    total += 1 + roots_[i]->NumOffspring();
+  }
+  return total;
+}
+
+void ProjectSnapshot::Serialize(Serializer* s) const {
+  // Write a serialization version.
+  s->WriteInt64(s->Version());
+
+  // Write our project name to the file.
+  s->WriteString(name_);
+
+  // Write how many tasks there are.
+  s->WriteInt32(NumTasks());
+
+  // Serialize the tree.
+  for (int i = 0; i < roots_.size(); ++i) {
+    roots_[i]->Serialize(s, NULL);
+  }
+}
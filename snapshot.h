@@ -0,0 +1,92 @@
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+// Immutable snapshots of a project's task tree that share structure with each
+// other.
+//
+// Every Task remembers the TaskSnapshot describing it for as long as someone
+// holds on to it.  Changing a task forgets the snapshots of that task and of
+// its ancestors, so the next snapshot only rebuilds the path from the changed
+// task up to the root and reuses every untouched subtree of a snapshot still
+// held.  Snapshotting a project that hasn't changed just hands back the same
+// snapshot.  Nothing is kept once the last snapshot is let go, so the live
+// tree isn't held in memory twice.
+//
+// Snapshots hold no pointers back into the live tree, so they can be saved or
+// exported while the project keeps being edited.  Two snapshot nodes that are
+// the same pointer describe identical subtrees, which keeps comparing two
+// snapshots proportional to what changed between them.
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "date.h"
+#include "note.h"
+#include "task.h"
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+class Serializer;
+
+class TaskSnapshot {
+ public:
+  // Builds a snapshot of t.  The children are taken from the snapshots cached
+  // on t's subtasks, which are built first if they're missing.
+  explicit TaskSnapshot(Task* t);
+
+  int Id() const { return id_; }
+  const string& Title() const { return title_; }
+  const string& Description() const { return description_; }
+  TaskStatus Status() const { return status_; }
+  const Date& CreationDate() const { return creation_date_; }
+  const Date& StartDate() const { return start_date_; }
+  const Date& CompletionDate() const { return completion_date_; }
+  int NumNotes() const { return notes_.size(); }
+  const Note& GetNote(int i) const { return notes_[i]; }
+
+  int NumChildren() const { return children_.size(); }
+  const TaskSnapshot* Child(int i) const { return children_[i].get(); }
+
+  // Returns the number of tasks below this one.
+  int NumOffspring() const;
+
+  // Serializes this task and all of its children.  The parent is needed since
+  // snapshots don't point back up the tree.
+  void Serialize(Serializer* s, const TaskSnapshot* parent) const;
+
+ private:
+  int id_;
+  string title_;
+  string description_;
+  TaskStatus status_;
+  Date creation_date_;
+  Date start_date_;
+  Date completion_date_;
+  vector<Note> notes_;
+  vector<Task::StatusChange> status_changes_;
+  vector<shared_ptr<const TaskSnapshot> > children_;
+};
+
+class ProjectSnapshot {
+ public:
+  ProjectSnapshot(const string& name,
+                  const vector<shared_ptr<const TaskSnapshot> >& roots);
+
+  const string& Name() const { return name_; }
+  int NumRoots() const { return roots_.size(); }
+  const TaskSnapshot* Root(int i) const { return roots_[i].get(); }
+
+  // A count of every item in the tree.
+  int NumTasks() const;
+
+  // Writes the snapshot in the same format Project::NewProjectFromFile() reads.
+  void Serialize(Serializer* s) const;
+
+ private:
+  string name_;
+  vector<shared_ptr<const TaskSnapshot> > roots_;
+};
+
+#endif  // SNAPSHOT_H_
@@ -0,0 +1,105 @@
+#include "snapshot.h"
+#include <iostream>
+#include <string>
+#include "file-versions.h"
+#include "project.h"
+#include "serializer.h"
+
+using namespace std;
+
+static int errors = 0;
+
+ostream& ERROR() {
+  ++errors;
+  cout << "Error: ";
+  return cout;
+}
+
+bool TestUnchangedProjectReusesSnapshot() {
+  cout << "Testing unchanged projects reuse their snapshot" << endl;
+  Project p("test");
+  p.AddTaskNamed("a")->AddSubTask(new Task("a1", ""));
+
+  shared_ptr<const ProjectSnapshot> before = p.Snapshot();
+  if (before != p.Snapshot()) {
+    ERROR() << "Snapshotting an unchanged project made a new snapshot." << endl;
+    return false;
+  }
+  return true;
+}
+
+bool TestChangesOnlyCopyThePathToTheRoot() {
+  cout << "Testing changes only copy the path to the root" << endl;
+  bool success = true;
+  Project p("test");
+  Task* a = p.AddTaskNamed("a");
+  p.AddTaskNamed("b");
+  Task* a1 = new Task("a1", "");
+  Task* a2 = new Task("a2", "");
+  a->AddSubTask(a1);
+  a->AddSubTask(a2);
+
+  shared_ptr<const ProjectSnapshot> before = p.Snapshot();
+  a2->SetListText("a2 edited");
+  shared_ptr<const ProjectSnapshot> after = p.Snapshot();
+
+  if (before->Root(1) != after->Root(1)) {
+    ERROR() << "An untouched root wasn't shared." << endl;
+    success = false;
+  }
+  if (before->Root(0)->Child(0) != after->Root(0)->Child(0)) {
+    ERROR() << "An untouched sibling wasn't shared." << endl;
+    success = false;
+  }
+  if (before->Root(0)->Child(1)->Title() != "a2" ||
+      after->Root(0)->Child(1)->Title() != "a2 edited") {
+    ERROR() << "Snapshots didn't keep their own titles." << endl;
+    success = false;
+  }
+  return success;
+}
+
+bool TestUnheldSnapshotsAreFreed() {
+  cout << "Testing snapshots nobody holds are freed" << endl;
+  Project p("test");
+  p.AddTaskNamed("a")->AddSubTask(new Task("a1", ""));
+
+  weak_ptr<const ProjectSnapshot> dropped = p.Snapshot();
+  if (!dropped.expired()) {
+    ERROR() << "The project kept a snapshot nobody holds." << endl;
+    return false;
+  }
+  return true;
+}
+
+bool TestSerializedSnapshotLoads() {
+  cout << "Testing serialized snapshots load back" << endl;
+  Project p("test");
+  Task* a = p.AddTaskNamed("a");
+  a->AddSubTask(new Task("a1", ""));
+  a->AddNote("note");
+
+  string path = "/tmp/SnapshotTest.project";
+  Serializer s("", path);
+  s.SetVersion(NOTES_VERSION);
+  p.Snapshot()->Serialize(&s);
+  s.CloseAll();
+
+  Project* loaded = Project::NewProjectFromFile(path);
+  bool success = loaded != NULL && loaded->NumTasks() == 2 &&
+                 loaded->Snapshot()->Root(0)->NumNotes() == 1;
+  if (!success) {
+    ERROR() << "The loaded project didn't match the snapshot." << endl;
+  }
+  delete loaded;
+  return success;
+}
+
+int main() {
+  bool success = TestUnchangedProjectReusesSnapshot() &&
+                 TestChangesOnlyCopyThePathToTheRoot() &&
+                 TestUnheldSnapshotsAreFreed() &&
+                 TestSerializedSnapshotLoads();
+  cout << errors << " errors." << endl;
+  return !success;
+}
@@ -0,0 +1,181 @@
+#include "string-search.h"
+
+// The vector kernels are compiled for their instruction sets one function at
+// a time, so the rest of the program runs on any x86 CPU.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+static inline unsigned char Lower(unsigned char c) {
+  return c - 'A' < 26u ? c + ('a' - 'A') : c;
+}
+
+static inline unsigned char Upper(unsigned char c) {
+  return c - 'a' < 26u ? c - ('a' - 'A') : c;
+}
+
+CaselessSearcher::CaselessSearcher(const string& needle)
+    : needle_(needle),
+      first_lower_(0),
+      first_upper_(0),
+      last_lower_(0),
+      last_upper_(0),
+      kernel_(FunctionFor(BestKernel())) {
+  for (int i = 0; i < needle_.size(); ++i) {
+    needle_[i] = Lower(needle_[i]);
+  }
+  if (!needle_.empty()) {
+    first_lower_ = needle_[0];
+    first_upper_ = Upper(first_lower_);
+    last_lower_ = needle_[needle_.size() - 1];
+    last_upper_ = Upper(last_lower_);
+  }
+}
+
+CaselessSearcher::Kernel CaselessSearcher::BestKernel() {
+#ifdef HAVE_X86_KERNELS
+  // Only asked once, since it's the same for every searcher.
+  static const Kernel best = __builtin_cpu_supports("avx2")   ? AVX2
+                             : __builtin_cpu_supports("sse2") ? SSE2
+                                                              : SCALAR;
+  return best;
+#else
+  return SCALAR;
+#endif
+}
+
+bool CaselessSearcher::Supports(Kernel kernel) {
+  return kernel <= BestKernel();
+}
+
+bool CaselessSearcher::FoundInWith(Kernel kernel, const char* text,
+                                   size_t size) const {
+  return FunctionFor(kernel)(*this, text, size);
+}
+
+CaselessSearcher::KernelFunction CaselessSearcher::FunctionFor(Kernel kernel) {
+  switch (kernel) {
+    case AVX2:
+      return FindAvx2;
+    case SSE2:
+      return FindSse2;
+    case SCALAR:
+    case NUM_KERNELS:
+      break;
+  }
+  return FindScalar;
+}
+
+bool CaselessSearcher::MatchesAt(const char* text) const {
+  for (int i = 1; i + 1 < needle_.size(); ++i) {
+    if (Lower(text[i]) != static_cast<unsigned char>(needle_[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CaselessSearcher::FindScalar(const CaselessSearcher& s, const char* text,
+                                  size_t size) {
+  size_t n = s.needle_.size();
+  if (n == 0) {
+    return true;
+  }
+  for (size_t i = 0; i + n <= size; ++i) {
+    unsigned char first = text[i];
+    unsigned char last = text[i + n - 1];
+    if ((first == s.first_lower_ || first == s.first_upper_) &&
+        (last == s.last_lower_ || last == s.last_upper_) &&
+        s.MatchesAt(text + i)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+__attribute__((target("sse2"))) bool CaselessSearcher::FindSse2(
+    const CaselessSearcher& s, const char* text, size_t size) {
+  size_t n = s.needle_.size();
+  if (n == 0) {
+    return true;
+  }
+  const __m128i first_lower = _mm_set1_epi8(s.first_lower_);
+  const __m128i first_upper = _mm_set1_epi8(s.first_upper_);
+  const __m128i last_lower = _mm_set1_epi8(s.last_lower_);
+  const __m128i last_upper = _mm_set1_epi8(s.last_upper_);
+  size_t i = 0;
+  for (; i + n - 1 + 16 <= size; i += 16) {
+    // Lane j compares the needle's first byte with text[i + j] and its last
+    // byte with text[i + j + n - 1].
+    __m128i firsts =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+    __m128i lasts =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + n - 1));
+    __m128i first_matches = _mm_or_si128(_mm_cmpeq_epi8(firsts, first_lower),
+                                         _mm_cmpeq_epi8(firsts, first_upper));
+    __m128i last_matches = _mm_or_si128(_mm_cmpeq_epi8(lasts, last_lower),
+                                        _mm_cmpeq_epi8(lasts, last_upper));
+    unsigned mask =
+        _mm_movemask_epi8(_mm_and_si128(first_matches, last_matches));
+    for (; mask != 0; mask &= mask - 1) {
+      if (s.MatchesAt(text + i + __builtin_ctz(mask))) {
+        return true;
+      }
+    }
+  }
+  return FindScalar(s, text + i, size - i);
+}
+
+__attribute__((target("avx2"))) bool CaselessSearcher::FindAvx2(
+    const CaselessSearcher& s, const char* text, size_t size) {
+  size_t n = s.needle_.size();
+  if (n == 0) {
+    return true;
+  }
+  const __m256i first_lower = _mm256_set1_epi8(s.first_lower_);
+  const __m256i first_upper = _mm256_set1_epi8(s.first_upper_);
+  const __m256i last_lower = _mm256_set1_epi8(s.last_lower_);
+  const __m256i last_upper = _mm256_set1_epi8(s.last_upper_);
+  size_t i = 0;
+  for (; i + n - 1 + 32 <= size; i += 32) {
+    __m256i firsts =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+    __m256i lasts = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(text + i + n - 1));
+    __m256i first_matches =
+        _mm256_or_si256(_mm256_cmpeq_epi8(firsts, first_lower),
+                        _mm256_cmpeq_epi8(firsts, first_upper));
+    __m256i last_matches =
+        _mm256_or_si256(_mm256_cmpeq_epi8(lasts, last_lower),
+                        _mm256_cmpeq_epi8(lasts, last_upper));
+    unsigned mask = _mm256_movemask_epi8(
+        _mm256_and_si256(first_matches, last_matches));
+    for (; mask != 0; mask &= mask - 1) {
+      if (s.MatchesAt(text + i + __builtin_ctz(mask))) {
+        return true;
+      }
+    }
+  }
+  // What's left is shorter than a vector, and may still fit half of one.  The
+  // SSE2 kernel's instructions stall while the upper halves of the AVX
+  // registers are dirty, and the compiler doesn't clear them for a tail call.
+  _mm256_zeroupper();
+  return FindSse2(s, text + i, size - i);
+}
+
+#else
+
+bool CaselessSearcher::FindSse2(const CaselessSearcher& s, const char* text,
+                                size_t size) {
+  return FindScalar(s, text, size);
+}
+
+bool CaselessSearcher::FindAvx2(const CaselessSearcher& s, const char* text,
+                                size_t size) {
+  return FindScalar(s, text, size);
+}
+
+#endif  // HAVE_X86_KERNELS
@@ -0,0 +1,63 @@
+#ifndef STRING_SEARCH_H_
+#define STRING_SEARCH_H_
+
+// Finds a needle in many texts, ignoring the case of ASCII letters:
+//
+//   CaselessSearcher searcher("deploy");
+//   if (searcher.FoundIn(t->Title())) ...
+//
+// The searcher scans with the widest vector instructions the CPU has, picked
+// the first time one is made.  Each block of text is compared with the first
+// and last bytes of the needle at once, and only the places where both match
+// have the rest of the needle checked.
+
+#include <stddef.h>
+#include <string>
+
+using std::string;
+
+class CaselessSearcher {
+ public:
+  // The ways of scanning, from slowest to fastest.
+  enum Kernel { SCALAR, SSE2, AVX2, NUM_KERNELS };
+
+  explicit CaselessSearcher(const string& needle);
+
+  // The needle in lower case.
+  const string& Needle() const { return needle_; }
+
+  bool FoundIn(const char* text, size_t size) const {
+    return kernel_(*this, text, size);
+  }
+  bool FoundIn(const string& text) const {
+    return kernel_(*this, text.data(), text.size());
+  }
+
+  // The fastest kernel this CPU runs, and whether it can run kernel at all,
+  // for comparing them.
+  static Kernel BestKernel();
+  static bool Supports(Kernel kernel);
+  bool FoundInWith(Kernel kernel, const char* text, size_t size) const;
+
+ private:
+  typedef bool (*KernelFunction)(const CaselessSearcher& searcher,
+                                 const char* text, size_t size);
+  static KernelFunction FunctionFor(Kernel kernel);
+
+  static bool FindScalar(const CaselessSearcher& s, const char* text,
+                         size_t size);
+  static bool FindSse2(const CaselessSearcher& s, const char* text,
+                       size_t size);
+  static bool FindAvx2(const CaselessSearcher& s, const char* text,
+                       size_t size);
+  // Whether the needle is at text, given that its first and last bytes are.
+  bool MatchesAt(const char* text) const;
+
+  string needle_;
+  // The needle's first and last bytes in either case.
+  unsigned char first_lower_, first_upper_;
+  unsigned char last_lower_, last_upper_;
+  KernelFunction kernel_;
+};
+
+#endif  // STRING_SEARCH_H_
@@ -0,0 +1,77 @@
+#include "string-search.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+static int errors = 0;
+
+ostream& ERROR() {
+  ++errors;
+  cout << "Error: ";
+  return cout;
+}
+
+string Lowered(string s) {
+  for (int i = 0; i < s.size(); ++i) {
+    s[i] = tolower(s[i]);
+  }
+  return s;
+}
+
+// A few letters in both cases and a byte that isn't ASCII, so that needles
+// turn up often and partial matches are common.
+string RandomText(int size) {
+  static const char kChars[] = "abAB c\xe9";
+  string text;
+  for (int i = 0; i < size; ++i) {
+    text += kChars[rand() % (sizeof(kChars) - 1)];
+  }
+  return text;
+}
+
+bool TestFoundInIgnoresCase() {
+  cout << "Testing finding needles in any case" << endl;
+  CaselessSearcher searcher("DePloy");
+  if (!searcher.FoundIn("Deploy the site") ||
+      !searcher.FoundIn("after that, redeploy") ||
+      searcher.FoundIn("Deplo") || searcher.FoundIn("de-ploy") ||
+      !CaselessSearcher("").FoundIn("")) {
+    ERROR() << "Needles were found in the wrong texts." << endl;
+    return false;
+  }
+  return true;
+}
+
+bool TestKernelsAgree() {
+  cout << "Testing every kernel finds the same needles" << endl;
+  srand(41);
+  for (int round = 0; round < 20000; ++round) {
+    // Long enough texts to go through a few vectors and leave a tail.
+    string text = RandomText(rand() % 100);
+    string needle = RandomText(1 + rand() % 5);
+    bool expected = Lowered(text).find(Lowered(needle)) != string::npos;
+    CaselessSearcher searcher(needle);
+    for (int k = 0; k < CaselessSearcher::NUM_KERNELS; ++k) {
+      CaselessSearcher::Kernel kernel =
+          static_cast<CaselessSearcher::Kernel>(k);
+      if (!CaselessSearcher::Supports(kernel)) {
+        continue;
+      }
+      if (searcher.FoundInWith(kernel, text.data(), text.size()) != expected) {
+        ERROR() << "Kernel " << k << " got \"" << needle << "\" in \"" << text
+                << "\" wrong." << endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int main() {
+  bool success = TestFoundInIgnoresCase() && TestKernelsAgree();
+  cout << errors << " errors." << endl;
+  return !success;
+}
@@ -0,0 +1,491 @@
+#include "task-query.h"
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "constants.h"
+#include "regex-matcher.h"
+#include "task.h"
+#include "trigram-index.h"
+
+static const char* kStatusNames[NUM_STATUSES] = {"created", "paused",
+                                                 "in_progress", "completed"};
+
+// Finds text, or regex if there is one, in what Getter gets.
+template <class Getter>
+static FilterPredicate<Task>* TextIn(
+    const string& text, const shared_ptr<const RegexMatcher>& regex) {
+  if (regex) {
+    return new RegexFilterPredicate<Task, Getter>(regex, Getter());
+  }
+  return new StringContainsFilterPredicate<Task, Getter>(text, Getter());
+}
+
+class QueryParser {
+ public:
+  QueryParser(const string& query, time_t now,
+              const TaskQuery::Indexes& indexes)
+      : query_(query),
+        pos_(0),
+        now_(now),
+        indexes_(indexes),
+        counts_back_(false) {}
+
+  // Returns the root predicate, or NULL after saying what's wrong in error.
+  FilterPredicate<Task>* Parse(string* error);
+  // Whether a time ago was parsed.
+  bool CountsBack() { return counts_back_; }
+
+ private:
+  typedef vector<FilterPredicate<Task>*> Terms;
+
+  FilterPredicate<Task>* ParseOr();
+  FilterPredicate<Task>* ParseAnd();
+  FilterPredicate<Task>* ParseUnary();
+  FilterPredicate<Task>* ParseTerm();
+  string ParseWord();
+  bool ParseText(string* text, bool* is_regex);
+  bool ParseTime(const string& value, time_t* time);
+  FilterPredicate<Task>* StatusTerm(const string& statuses);
+  FilterPredicate<Task>* TimeTerm(const string& field, char op,
+                                  const string& value);
+  FilterPredicate<Task>* TextTerm(const string& field, const string& text,
+                                  bool is_regex);
+  FilterPredicate<Task>* HasTerm(const string& what);
+  FilterPredicate<Task>* TimeLookup(FilterPredicate<Task>* test,
+                                    const TaskQuery::TimeIndex* index,
+                                    char op, time_t time);
+  FilterPredicate<Task>* AmongCandidates(const vector<int>& ids,
+                                         FilterPredicate<Task>* test);
+  bool AtEnd();
+  bool AtOr();
+  FilterPredicate<Task>* Fail(const string& error);
+  static FilterPredicate<Task>* Fail(Terms* terms);
+
+  const string& query_;
+  int pos_;
+  time_t now_;
+  const TaskQuery::Indexes& indexes_;
+  bool counts_back_;
+  string error_;
+};
+
+FilterPredicate<Task>* QueryParser::Parse(string* error) {
+  FilterPredicate<Task>* root = ParseOr();
+  if (root != NULL && !AtEnd()) {
+    delete root;
+    root = Fail("unmatched )");
+  }
+  *error = error_;
+  return root;
+}
+
+FilterPredicate<Task>* QueryParser::ParseOr() {
+  Terms terms;
+  for (;;) {
+    FilterPredicate<Task>* term = ParseAnd();
+    if (term == NULL) {
+      return Fail(&terms);
+    }
+    terms.push_back(term);
+    if (!AtOr()) {
+      break;
+    }
+    pos_ += 2;
+  }
+  if (terms.size() == 1) {
+    return terms[0];
+  }
+  OrFilterPredicate<Task>* any = new OrFilterPredicate<Task>();
+  for (int i = 0; i < terms.size(); ++i) {
+    any->AddChild(terms[i]);
+  }
+  return any;
+}
+
+FilterPredicate<Task>* QueryParser::ParseAnd() {
+  Terms terms;
+  while (!AtEnd() && query_[pos_] != ')' && !AtOr()) {
+    FilterPredicate<Task>* term = ParseUnary();
+    if (term == NULL) {
+      return Fail(&terms);
+    }
+    terms.push_back(term);
+  }
+  if (terms.empty()) {
+    return Fail("expected a term");
+  }
+  if (terms.size() == 1) {
+    return terms[0];
+  }
+  AndFilterPredicate<Task>* all = new AndFilterPredicate<Task>();
+  for (int i = 0; i < terms.size(); ++i) {
+    all->AddChild(terms[i]);
+  }
+  return all;
+}
+
+FilterPredicate<Task>* QueryParser::ParseUnary() {
+  bool negated = false;
+  while (pos_ < query_.size() && query_[pos_] == '-') {
+    negated = !negated;
+    ++pos_;
+  }
+  FilterPredicate<Task>* term;
+  if (pos_ < query_.size() && query_[pos_] == '(') {
+    ++pos_;
+    term = ParseOr();
+    if (term != NULL && (AtEnd() || query_[pos_] != ')')) {
+      delete term;
+      return Fail("missing )");
+    }
+    ++pos_;
+  } else {
+    term = ParseTerm();
+  }
+  if (term != NULL && negated) {
+    term->SetIsNot(!term->IsNot());
+  }
+  return term;
+}
+
+FilterPredicate<Task>* QueryParser::ParseTerm() {
+  // A field is a lower case word followed by how it's compared.
+  int start = pos_;
+  while (pos_ < query_.size() &&
+         (islower(static_cast<unsigned char>(query_[pos_])) ||
+          query_[pos_] == '_')) {
+    ++pos_;
+  }
+  string field = query_.substr(start, pos_ - start);
+  char op = pos_ < query_.size() ? query_[pos_] : '\0';
+  string text;
+  bool is_regex;
+  if (field.empty() || (op != ':' && op != '<' && op != '>')) {
+    pos_ = start;
+    return ParseText(&text, &is_regex) ? TextTerm("", text, is_regex) : NULL;
+  }
+  ++pos_;
+  string name = field + op;
+  if (name == "title:" || name == "description:" || name == "notes:") {
+    return ParseText(&text, &is_regex) ? TextTerm(field, text, is_regex)
+                                       : NULL;
+  }
+  string value = ParseWord();
+  if (value.empty()) {
+    return Fail("expected a value after " + name);
+  }
+  if (name == "status:") {
+    return StatusTerm(value);
+  }
+  if (name == "has:") {
+    return HasTerm(value);
+  }
+  if ((field == "created" || field == "completed") && op != ':') {
+    return TimeTerm(field, op, value);
+  }
+  return Fail("unknown field " + name);
+}
+
+// Reads up to the next space or parenthesis.
+string QueryParser::ParseWord() {
+  int start = pos_;
+  while (pos_ < query_.size() &&
+         !isspace(static_cast<unsigned char>(query_[pos_])) &&
+         query_[pos_] != '(' && query_[pos_] != ')') {
+    ++pos_;
+  }
+  return query_.substr(start, pos_ - start);
+}
+
+// Reads a word, "a quoted string" or a /regular expression/, in which \/
+// stands for a slash.
+bool QueryParser::ParseText(string* text, bool* is_regex) {
+  *is_regex = false;
+  if (pos_ == query_.size() || (query_[pos_] != '"' && query_[pos_] != '/')) {
+    *text = ParseWord();
+    if (text->empty()) {
+      Fail("expected text");
+      return false;
+    }
+    return true;
+  }
+  char quote = query_[pos_++];
+  *is_regex = quote == '/';
+  text->clear();
+  while (pos_ < query_.size() && query_[pos_] != quote) {
+    if (*is_regex && query_.compare(pos_, 2, "\\/") == 0) {
+      ++pos_;
+    }
+    *text += query_[pos_++];
+  }
+  if (pos_ == query_.size()) {
+    Fail(string("missing closing ") + quote);
+    return false;
+  }
+  ++pos_;
+  return true;
+}
+
+// Reads a date like 2024-03-01, which starts at local midnight, or a time ago
+// like -7d.
+bool QueryParser::ParseTime(const string& value, time_t* time) {
+  int n;
+  char unit;
+  int used = 0;
+  if (sscanf(value.c_str(), "-%d%c%n", &n, &unit, &used) == 2 &&
+      used == value.size() && n >= 0) {
+    time_t seconds;
+    switch (unit) {
+      case 'h':
+        seconds = 60 * 60;
+        break;
+      case 'd':
+        seconds = 24 * 60 * 60;
+        break;
+      case 'w':
+        seconds = 7 * 24 * 60 * 60;
+        break;
+      default:
+        return false;
+    }
+    *time = now_ - seconds * n;
+    counts_back_ = true;
+    return true;
+  }
+  int year, month, day;
+  if (sscanf(value.c_str(), "%d-%d-%d%n", &year, &month, &day, &used) == 3 &&
+      used == value.size() && month >= 1 && month <= 12 && day >= 1 &&
+      day <= 31) {
+    struct tm date = tm();
+    date.tm_year = year - 1900;
+    date.tm_mon = month - 1;
+    date.tm_mday = day;
+    date.tm_isdst = -1;
+    *time = mktime(&date);
+    return *time != -1;
+  }
+  return false;
+}
+
+FilterPredicate<Task>* QueryParser::StatusTerm(const string& statuses) {
+  Terms terms;
+  size_t start = 0;
+  while (start <= statuses.size()) {
+    size_t end = statuses.find(',', start);
+    if (end == string::npos) {
+      end = statuses.size();
+    }
+    string name = statuses.substr(start, end - start);
+    int status = 0;
+    while (status < NUM_STATUSES && name != kStatusNames[status]) {
+      ++status;
+    }
+    if (status == NUM_STATUSES) {
+      Fail("unknown status " + name);
+      return Fail(&terms);
+    }
+    if (indexes_.statuses.size() == NUM_STATUSES) {
+      terms.push_back(new BitmapFilterPredicate<Task, Task::IdGetter>(
+          indexes_.statuses[status], Task::IdGetter()));
+    } else {
+      terms.push_back(
+          new EqualityFilterPredicate<Task, TaskStatus, Task::StatusGetter>(
+              static_cast<TaskStatus>(status), Task::StatusGetter()));
+    }
+    start = end + 1;
+  }
+  if (terms.size() == 1) {
+    return terms[0];
+  }
+  OrFilterPredicate<Task>* any = new OrFilterPredicate<Task>();
+  for (int i = 0; i < terms.size(); ++i) {
+    any->AddChild(terms[i]);
+  }
+  return any;
+}
+
+FilterPredicate<Task>* QueryParser::TimeTerm(const string& field, char op,
+                                             const string& value) {
+  time_t time;
+  if (!ParseTime(value, &time)) {
+    return Fail("expected a date like 2024-03-01 or -7d, not " + value);
+  }
+  if (field == "created") {
+    FilterPredicate<Task>* test;
+    if (op == '>') {
+      test = new GTFilterPredicate<Task, time_t, Task::CreationTimeGetter>(
+          time, Task::CreationTimeGetter());
+    } else {
+      test = new LTFilterPredicate<Task, time_t, Task::CreationTimeGetter>(
+          time, Task::CreationTimeGetter());
+    }
+    return TimeLookup(test, indexes_.created, op, time);
+  }
+  GTFilterPredicate<Task, time_t, Task::CompletionTimeGetter>* after =
+      new GTFilterPredicate<Task, time_t, Task::CompletionTimeGetter>(
+          op == '>' ? time : 0, Task::CompletionTimeGetter());
+  if (op == '>') {
+    return TimeLookup(after, indexes_.completed, op, time);
+  }
+  // Tasks that aren't completed have no completion time, which would come
+  // before any date.
+  AndFilterPredicate<Task>* between = new AndFilterPredicate<Task>();
+  between->AddChild(after);
+  between->AddChild(
+      new LTFilterPredicate<Task, time_t, Task::CompletionTimeGetter>(
+          time, Task::CompletionTimeGetter()));
+  return TimeLookup(between, indexes_.completed, op, time);
+}
+
+// Looks up the tasks whose times in index are after time, for a '>', or
+// before it, so that only those are tested.  Like text, a time is only looked
+// up if few enough tasks turn up.
+FilterPredicate<Task>* QueryParser::TimeLookup(
+    FilterPredicate<Task>* test, const TaskQuery::TimeIndex* index, char op,
+    time_t time) {
+  if (index == NULL || indexes_.candidates == NULL) {
+    return test;
+  }
+  TaskQuery::TimeIndex::const_iterator begin = index->begin();
+  TaskQuery::TimeIndex::const_iterator end = index->end();
+  if (op == '>') {
+    begin = index->upper_bound(std::make_pair(time, INT_MAX));
+  } else {
+    end = index->lower_bound(std::make_pair(time, INT_MIN));
+  }
+  int most = indexes_.num_tasks / Constants::kTasksPerIndexedQueryMatch;
+  vector<int> ids;
+  for (TaskQuery::TimeIndex::const_iterator it = begin; it != end; ++it) {
+    if (ids.size() == most) {
+      return test;
+    }
+    ids.push_back(it->second);
+  }
+  return AmongCandidates(ids, test);
+}
+
+// Tests only the tasks in ids, which must take in every task that can pass.
+FilterPredicate<Task>* QueryParser::AmongCandidates(
+    const vector<int>& ids, FilterPredicate<Task>* test) {
+  int size = 0;
+  for (int i = 0; i < ids.size(); ++i) {
+    size = std::max(size, ids[i] + 1);
+  }
+  TaskQuery::IdSet candidates(new IdBitmap(size));
+  for (int i = 0; i < ids.size(); ++i) {
+    candidates->Set(ids[i]);
+  }
+  indexes_.candidates->push_back(candidates);
+  AndFilterPredicate<Task>* among = new AndFilterPredicate<Task>();
+  among->AddChild(new BitmapFilterPredicate<Task, Task::IdGetter>(
+      candidates, Task::IdGetter()));
+  among->AddChild(test);
+  return among;
+}
+
+// An empty field looks in every field.
+FilterPredicate<Task>* QueryParser::TextTerm(const string& field,
+                                             const string& text,
+                                             bool is_regex) {
+  shared_ptr<const RegexMatcher> regex;
+  if (is_regex) {
+    string error;
+    regex = RegexMatcher::Compiled(text, &error);
+    if (!regex) {
+      return Fail(error);
+    }
+  }
+  FilterPredicate<Task>* scan;
+  if (field == "title") {
+    scan = TextIn<Task::TitleGetter>(text, regex);
+  } else if (field == "description") {
+    scan = TextIn<Task::DescriptionGetter>(text, regex);
+  } else if (field == "notes") {
+    scan = TextIn<Task::NotesTextGetter>(text, regex);
+  } else {
+    OrFilterPredicate<Task>* anywhere = new OrFilterPredicate<Task>();
+    anywhere->AddChild(TextIn<Task::TitleGetter>(text, regex));
+    anywhere->AddChild(TextIn<Task::DescriptionGetter>(text, regex));
+    anywhere->AddChild(TextIn<Task::NotesTextGetter>(text, regex));
+    scan = anywhere;
+  }
+
+  // The index files each task under the trigrams of its title, description
+  // and notes together, so a task it doesn't turn up has the text in none of
+  // them.  It's only worth looking in if that rules out most tasks, since
+  // the lists it intersects are as long as the number of tasks they name.
+  if (regex || indexes_.text == NULL || indexes_.candidates == NULL) {
+    return scan;
+  }
+  int most = indexes_.text->MaxCandidates(text);
+  if (most < 0 ||
+      most * Constants::kTasksPerIndexedQueryMatch > indexes_.num_tasks) {
+    return scan;
+  }
+  vector<int> ids;
+  indexes_.text->Candidates(text, &ids);
+  return AmongCandidates(ids, scan);
+}
+
+FilterPredicate<Task>* QueryParser::HasTerm(const string& what) {
+  if (what == "notes") {
+    return new BooleanFilterPredicate<Task, Task::HasNotesGetter>(
+        Task::HasNotesGetter());
+  }
+  if (what == "description") {
+    return new BooleanFilterPredicate<Task, Task::HasDescriptionGetter>(
+        Task::HasDescriptionGetter());
+  }
+  return Fail("unknown has:" + what);
+}
+
+// Skips spaces, and says whether that's the end of the query.
+bool QueryParser::AtEnd() {
+  while (pos_ < query_.size() &&
+         isspace(static_cast<unsigned char>(query_[pos_]))) {
+    ++pos_;
+  }
+  return pos_ == query_.size();
+}
+
+// Whether the next word is OR.
+bool QueryParser::AtOr() {
+  if (AtEnd() || query_.compare(pos_, 2, "OR") != 0) {
+    return false;
+  }
+  return pos_ + 2 == query_.size() ||
+         isspace(static_cast<unsigned char>(query_[pos_ + 2])) ||
+         query_[pos_ + 2] == '(';
+}
+
+// Keeps the first error, since the others follow from it.
+FilterPredicate<Task>* QueryParser::Fail(const string& error) {
+  if (error_.empty()) {
+    error_ = error;
+  }
+  return NULL;
+}
+
+FilterPredicate<Task>* QueryParser::Fail(Terms* terms) {
+  for (int i = 0; i < terms->size(); ++i) {
+    delete (*terms)[i];
+  }
+  return NULL;
+}
+
+FilterPredicate<Task>* TaskQuery::Parse(const string& query, time_t now,
+                                        const Indexes& indexes,
+                                        string* error) {
+  return QueryParser(query, now, indexes).Parse(error);
+}
+
+bool TaskQuery::CountsBackFromNow(const string& query) {
+  Indexes none;
+  QueryParser parser(query, 0, none);
+  string error;
+  delete parser.Parse(&error);
+  return parser.CountsBack();
+}
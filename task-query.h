@@ -0,0 +1,86 @@
+#ifndef TASK_QUERY_H_
+#define TASK_QUERY_H_
+
+// Parses queries like
+//
+//   status:in_progress completed>-7d title:"deploy" has:notes
+//
+// into filter predicates over tasks.  Terms next to each other must all pass,
+// OR between them means either may, a leading "-" negates a term, and
+// parentheses group.  The terms are:
+//
+//   status:created,paused,in_progress,completed  any of the statuses
+//   created>T  created<T  completed>T  completed<T
+//       where T is a date like 2024-03-01, or a time ago like -3h, -7d or -2w
+//   title:TEXT  description:TEXT  notes:TEXT  or just TEXT, which looks in
+//       all three.  TEXT can be quoted to take in spaces, and case is ignored.
+//       Written /like this/ it's a regular expression instead.
+//   has:notes  has:description
+//
+// Terms only look at the task they test, never its subtasks, so a project
+// only has to refilter the tasks an edit touches.  The predicates aren't in
+// any particular order; FilterPredicate::Plan() orders them once it's known
+// how often each passes.
+
+#include <ctime>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "filter-predicate.h"
+#include "id-bitmap.h"
+
+using std::pair;
+using std::set;
+using std::shared_ptr;
+using std::string;
+using std::time_t;
+using std::vector;
+
+class Task;
+class TrigramIndex;
+
+class TaskQuery {
+ public:
+  // Tasks by id.
+  typedef shared_ptr<IdBitmap> IdSet;
+  // Task ids by a time, in order.
+  typedef set<pair<time_t, int> > TimeIndex;
+
+  // What the tasks a query will filter are indexed by, so that tests can skip
+  // the tasks that can't pass them.
+  struct Indexes {
+    Indexes()
+        : text(NULL),
+          created(NULL),
+          completed(NULL),
+          num_tasks(0),
+          candidates(NULL) {}
+    // Every task's text, by id.
+    const TrigramIndex* text;
+    // The tasks with each status, if there's one for every status.  The query
+    // looks in these as they change, so they have to be kept current.
+    vector<shared_ptr<const IdBitmap> > statuses;
+    // When every task was created, and when the completed ones were.
+    const TimeIndex* created;
+    const TimeIndex* completed;
+    int num_tasks;
+    // Where the tasks turned up by each lookup in the text and time indexes
+    // are added.  Only those are tested for what was looked up, so whoever
+    // keeps the indexes has to add every task that changes while the query is
+    // in use.
+    vector<IdSet>* candidates;
+  };
+
+  // Returns a new predicate tree for query, or NULL after saying what's wrong
+  // in error.  Times ago count back from now.
+  static FilterPredicate<Task>* Parse(const string& query, time_t now,
+                                      const Indexes& indexes, string* error);
+
+  // Whether query has a time ago in it, so that what passes it depends on
+  // when it's parsed.
+  static bool CountsBackFromNow(const string& query);
+};
+
+#endif  // TASK_QUERY_H_
@@ -0,0 +1,276 @@
+#include "task-query.h"
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "project.h"
+#include "task.h"
+
+using namespace std;
+
+static int errors = 0;
+
+ostream& ERROR() {
+  ++errors;
+  cout << "Error: ";
+  return cout;
+}
+
+// The numbers, from 1, of the tasks that pass query, like "1 3".
+string Passing(const string& query, const vector<Task*>& tasks, time_t now) {
+  string error;
+  FilterPredicate<Task>* filter =
+      TaskQuery::Parse(query, now, TaskQuery::Indexes(), &error);
+  if (filter == NULL) {
+    ERROR() << "\"" << query << "\" didn't parse: " << error << endl;
+    return "";
+  }
+  string passing;
+  for (int i = 0; i < tasks.size(); ++i) {
+    if (filter->ObjectPasses(tasks[i])) {
+      passing += (passing.empty() ? "" : " ") + to_string(i + 1);
+    }
+  }
+  delete filter;
+  return passing;
+}
+
+bool TestQueries() {
+  cout << "Testing which tasks queries pass" << endl;
+  vector<Task*> tasks;
+  tasks.push_back(new Task("Deploy the site", "to production"));
+  tasks[0]->SetStatus(IN_PROGRESS);
+  tasks[0]->AddNote("Remember the cache");
+  tasks.push_back(new Task("Write docs", ""));
+  tasks[1]->SetStatus(COMPLETED);
+  tasks.push_back(new Task("Deploy docs", "see OPS-12"));
+  tasks[2]->AddSubTask(new Task("Fix typo", ""));
+  tasks.push_back(new Task("Pause everything", ""));
+  tasks[3]->SetStatus(PAUSED);
+
+  time_t now = time(NULL);
+  time_t next_month = now + 30 * 24 * 60 * 60;
+  struct {
+    const char* query;
+    time_t now;
+    const char* passing;
+  } cases[] = {
+      {"deploy", now, "1 3"},
+      {"DEPLOY docs", now, "3"},
+      {"deploy OR docs", now, "1 2 3"},
+      {"-deploy", now, "2 4"},
+      {"--deploy", now, "1 3"},
+      {"status:in_progress", now, "1"},
+      {"status:paused,completed", now, "2 4"},
+      {"-status:created", now, "1 2 4"},
+      {"title:\"the site\"", now, "1"},
+      {"title:production", now, ""},
+      {"description:production", now, "1"},
+      {"notes:cache", now, "1"},
+      {"cache", now, "1"},
+      {"/[A-Z]+-[0-9]+/", now, "3"},
+      {"title:/^(Write|Pause)/", now, "2 4"},
+      {"has:notes", now, "1"},
+      {"-has:description", now, "2 4"},
+      {"completed>-7d", now, "2"},
+      {"completed<-7d", now, ""},
+      {"completed<-7d", next_month, "2"},
+      {"created>-1h", now, "1 2 3 4"},
+      {"created>-1h", next_month, ""},
+      {"created<2000-01-01", now, ""},
+      {"created>2000-01-01", now, "1 2 3 4"},
+      {"(deploy OR status:paused) -has:notes", now, "3 4"},
+      {"-(deploy OR docs)", now, "4"},
+  };
+  bool success = true;
+  for (int i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+    string passing = Passing(cases[i].query, tasks, cases[i].now);
+    if (passing != cases[i].passing) {
+      ERROR() << "\"" << cases[i].query << "\" passed \"" << passing
+              << "\", not \"" << cases[i].passing << "\"." << endl;
+      success = false;
+    }
+  }
+  for (int i = 0; i < tasks.size(); ++i) {
+    delete tasks[i];
+  }
+  return success;
+}
+
+bool TestErrors() {
+  cout << "Testing turning down bad queries" << endl;
+  const char* bad[] = {"",           "(deploy",          "deploy)",
+                       "deploy OR",  "OR deploy",        "-",
+                       "status:",    "status:finished",  "due:tomorrow",
+                       "has:bugs",   "title:\"the site", "title:/[a-/",
+                       "created>7d", "completed<-7y",    "created>2024-13-01"};
+  for (int i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+    string error;
+    FilterPredicate<Task>* filter =
+        TaskQuery::Parse(bad[i], time(NULL), TaskQuery::Indexes(), &error);
+    if (filter != NULL || error.empty()) {
+      ERROR() << "\"" << bad[i] << "\" parsed." << endl;
+      delete filter;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TestRunQuery() {
+  cout << "Testing running queries over a project" << endl;
+  Project project("TaskQueryTest");
+  Task* site = project.AddTaskNamed("Deploy the site");
+  Task* docs = project.AddTaskNamed("Write docs");
+  Task* typo = new Task("Fix typo", "in the deploy docs");
+  project.AttachTask(typo, docs, 0);
+  for (int i = 0; i < 100; ++i) {
+    project.AddTaskNamed("Filler " + to_string(i));
+  }
+
+  // Long enough words are looked up in the search index, short ones aren't,
+  // and either way the ancestors of what passes are shown.
+  if (!project.RunQuery("deploy", time(NULL)) || !project.IsShown(site) ||
+      !project.IsShown(typo) || project.NumFilteredRoots() != 2) {
+    ERROR() << "Looking up a word showed the wrong tasks." << endl;
+    return false;
+  }
+  if (!project.RunQuery("ty", time(NULL)) || !project.IsShown(typo) ||
+      project.NumFilteredRoots() != 1) {
+    ERROR() << "Scanning for a short word showed the wrong tasks." << endl;
+    return false;
+  }
+  if (!project.RunQuery("-filler -deploy", time(NULL)) ||
+      !project.IsShown(docs) || project.IsShown(typo) ||
+      project.NumFilteredRoots() != 1) {
+    ERROR() << "Negated words showed the wrong tasks." << endl;
+    return false;
+  }
+  // What passes is kept by id, and edits test just the tasks they change.
+  typo->SetStatus(COMPLETED);
+  project.TaskEdited(typo);
+  if (!project.RunQuery("status:completed", time(NULL)) ||
+      !project.IsShown(typo) || project.IsShown(site)) {
+    ERROR() << "Querying a status showed the wrong tasks." << endl;
+    return false;
+  }
+  site->SetStatus(COMPLETED);
+  project.TaskEdited(site);
+  typo->SetStatus(PAUSED);
+  project.TaskEdited(typo);
+  if (!project.IsShown(site) || project.IsShown(typo) ||
+      project.NumFilteredRoots() != 1) {
+    ERROR() << "Edited tasks weren't tested again." << endl;
+    return false;
+  }
+  // Looked up by completion time, from one query to the next.
+  if (!project.RunQuery("completed<-1h", time(NULL)) ||
+      project.IsShown(site) ||
+      !project.RunQuery("completed>-1h", time(NULL) + 2 * 60 * 60) ||
+      project.IsShown(site)) {
+    ERROR() << "Completion times were looked up wrong." << endl;
+    return false;
+  }
+  project.ShowCompletedLastWeek();
+  if (!project.IsShown(site) || project.IsShown(docs)) {
+    ERROR() << "Last week's completions were shown wrong." << endl;
+    return false;
+  }
+  if (project.RunQuery("status:", time(NULL)) ||
+      project.NumFilteredRoots() != 1) {
+    ERROR() << "A bad query changed the filter." << endl;
+    return false;
+  }
+  // Views left are saved until the project changes.
+  project.ShowAllTasks();
+  project.ShowCompletedLastWeek();
+  if (!project.IsShown(site) || project.NumFilteredRoots() != 1) {
+    ERROR() << "Going back to a view showed the wrong tasks." << endl;
+    return false;
+  }
+  project.RunQuery("status:completed", time(NULL));
+  project.ShowAllTasks();
+  site->SetStatus(IN_PROGRESS);
+  project.TaskEdited(site);
+  project.RunQuery("status:completed", time(NULL));
+  if (project.IsShown(site) || project.NumFilteredRoots() != 0) {
+    ERROR() << "A view saved before an edit was shown." << endl;
+    return false;
+  }
+  return true;
+}
+
+bool TestViews() {
+  cout << "Testing saved views" << endl;
+  Project project("TaskQueryTest");
+  if (!project.AddView("Open", "-status:completed") ||
+      project.AddView("Open", "deploy") || project.AddView("Bad", "(")) {
+    ERROR() << "The wrong views were added." << endl;
+    return false;
+  }
+  // Tasks added and edited after the view are kept up to date in it.
+  Task* site = project.AddTaskNamed("Deploy the site");
+  Task* docs = project.AddTaskNamed("Write docs");
+  Task* typo = new Task("Fix typo", "");
+  project.AttachTask(typo, docs, 0);
+  site->SetStatus(COMPLETED);
+  project.TaskEdited(site);
+  if (!project.ShowView("Open") || project.IsShown(site) ||
+      !project.IsShown(typo) || project.ShowView("Closed")) {
+    ERROR() << "A view showed the wrong tasks." << endl;
+    return false;
+  }
+  // Each view has its own collapsed tasks.
+  docs->ToggleExpanded();
+  project.ShowAllTasks();
+  docs->ToggleExpanded();
+  project.ShowView("Open");
+  if (docs->ShouldExpand()) {
+    ERROR() << "A view forgot its collapsed tasks." << endl;
+    return false;
+  }
+  // And the ones it left expanded.
+  docs->ToggleExpanded();
+  project.ShowAllTasks();
+  docs->ToggleExpanded();
+  project.ShowView("Open");
+  if (!docs->ShouldExpand()) {
+    ERROR() << "A view forgot its expanded tasks." << endl;
+    return false;
+  }
+  Task* parent;
+  int index;
+  project.DetachTask(typo, &parent, &index);
+  delete typo;
+  project.ShowAllTasks();
+  project.ShowView("Open");
+  if (!project.IsShown(docs) || project.NumFilteredRoots() != 1) {
+    ERROR() << "A task taken out was left in a view." << endl;
+    return false;
+  }
+  // A task the view only shows for its subtasks still moves when it's
+  // renamed.
+  project.AddView("Stripes", "stripes");
+  project.SetSortOrder(SORT_BY_TITLE);
+  Task* zebra = project.AddTaskNamed("Zebra");
+  project.AttachTask(new Task("Fix the stripes", ""), zebra, 0);
+  Task* mango = project.AddTaskNamed("Mango");
+  project.AttachTask(new Task("Count the stripes", ""), mango, 0);
+  project.ShowView("Stripes");
+  project.ShowAllTasks();
+  zebra->SetListText("Aardvark");
+  project.TaskEdited(zebra);
+  project.ShowView("Stripes");
+  if (project.NumFilteredRoots() != 2 || project.FilteredRoot(0) != zebra) {
+    ERROR() << "A view kept a renamed task where it used to sort." << endl;
+    return false;
+  }
+  return true;
+}
+
+int main() {
+  bool success =
+      TestQueries() && TestErrors() && TestRunQuery() && TestViews();
+  cout << errors << " errors." << endl;
+  return !success;
+}
@@ -1,27 +1,45 @@
 #include "task.h"
 #include <assert.h>
+#include <ctype.h>
 #include <algorithm>
+#include <functional>
+#include <limits>
 #include <string>
+#include "constants.h"
 #include "file-versions.h"
 #include "note.h"
 #include "serializer.h"
+#include "snapshot.h"
+#include "thread-pool.h"
 #include "utils.h"
 
+using std::sort;
 using std::string;
 
 Task::Task(const string& title, const string& description)
-    : parent_(NULL),
+    : id_(0),
+      completion_key_(0),
+      matches_search_(false),
+      parent_(NULL),
+      sibling_node_(NULL),
+      observer_(NULL),
       status_(CREATED),
+      filtered_lists_(NULL),
       title_(title),
-      description_(description) {
+      description_(description),
+      sort_key_order_(SORT_BY_POSITION),
+      sort_key_stale_(true),
+      sort_number_(0) {
   creation_date_.SetToNow();
   start_date_.SetToEmptyTime();
   completion_date_.SetToEmptyTime();
 }
 
 Task::~Task() {
-  for (int i = 0; i < subtasks_.size(); ++i) {
-    delete subtasks_[i];
+  for (Task* c = FirstChild(); c != NULL;) {
+    Task* next = c->NextSibling();
+    delete c;
+    c = next;
   }
 }
 
@@ -33,7 +51,62 @@ Task* Task::NewTaskFromSerializer(Serializer* s) {
   return t;
 }
 
-void Task::AddNote(const string& note) { notes_.push_back(new Note(note)); }
+Task* Task::Clone(bool keep_status) {
+  Task* copy = new Task(title_, description_);
+  copy->notes_.reserve(notes_.size());
+  for (int i = 0; i < notes_.size(); ++i) {
+    copy->notes_.push_back(new Note(*notes_[i]));
+  }
+  if (keep_status) {
+    copy->status_ = status_;
+    copy->start_date_ = start_date_;
+    copy->completion_date_ = completion_date_;
+    copy->status_changes_ = status_changes_;
+  }
+
+  // Nobody can be watching the copy yet, so there's nothing to mark changed.
+  for (Task* c = FirstChild(); c != NULL; c = c->NextSibling()) {
+    Task* child = c->Clone(keep_status);
+    child->parent_ = copy;
+    child->sibling_node_ = copy->subtasks_.PushBack(child);
+  }
+  return copy;
+}
+
+void Task::AssignIds(int* next_id) {
+  if (id_ == 0) {
+    id_ = (*next_id)++;
+    snapshot_.reset();
+  }
+  for (Task* c = FirstChild(); c != NULL; c = c->NextSibling()) {
+    c->AssignIds(next_id);
+  }
+}
+
+shared_ptr<const TaskSnapshot> Task::Snapshot() {
+  shared_ptr<const TaskSnapshot> snapshot = snapshot_.lock();
+  if (!snapshot) {
+    snapshot.reset(new TaskSnapshot(this));
+    snapshot_ = snapshot;
+  }
+  return snapshot;
+}
+
+void Task::MarkChanged() {
+  Task* root = this;
+  for (Task* t = this; t != NULL; t = t->parent_) {
+    t->snapshot_.reset();
+    root = t;
+  }
+  if (root->observer_ != NULL) {
+    root->observer_->TaskChanged(this);
+  }
+}
+
+void Task::AddNote(const string& note) {
+  notes_.push_back(new Note(note));
+  MarkChanged();
+}
 
 bool Task::HasNotes() { return !notes_.empty(); }
 
@@ -49,9 +122,32 @@ void Task::DeleteNote(const string& note) {
   }
   if (found) {
     notes_.erase(delete_it);
+    MarkChanged();
   }
 }
 
+int Task::FindNote(const string& note) {
+  int found = -1;
+  for (int i = 0; i < notes_.size(); ++i) {
+    if (notes_[i]->GetText().compare(note) == 0) {
+      found = i;
+    }
+  }
+  return found;
+}
+
+Note* Task::DetachNote(int i) {
+  Note* n = notes_[i];
+  notes_.erase(notes_.begin() + i);
+  MarkChanged();
+  return n;
+}
+
+void Task::AttachNote(int i, Note* n) {
+  notes_.insert(notes_.begin() + i, n);
+  MarkChanged();
+}
+
 vector<string> Task::Notes() {
   vector<string> notes;
   for (int i = 0; i < notes_.size(); ++i) {
@@ -60,6 +156,17 @@ vector<string> Task::Notes() {
   return notes;
 }
 
+string Task::NotesTextGetter::operator()(Task* t) const {
+  string text;
+  for (int i = 0; i < t->notes_.size(); ++i) {
+    if (i > 0) {
+      text += '\n';
+    }
+    text += t->notes_[i]->GetText();
+  }
+  return text;
+}
+
 map<string, string> Task::MappedNotes() {
   map<string, string> mappedNotes;
   for (int i = 0; i < notes_.size(); ++i) {
@@ -68,112 +175,181 @@ map<string, string> Task::MappedNotes() {
   return mappedNotes;
 }
 
-void Task::ApplyFilter(FilterPredicate<Task>* filter) {
+void Task::ApplyFilter(const FilterProgram<Task>& filter, SortOrder order) {
+  UpdateSortKey(order);
+
   // It's important that we filter ourselves after our children because often
   // filters have an OrPredicate of "Has any filtered children" which wouldn't
   // if we filtered ourselves before our children.
-  for (int i = 0; i < NumChildren(); ++i) {
-    Child(i)->ApplyFilter(filter);
+  for (Task* c = FirstChild(); c != NULL; c = c->NextSibling()) {
+    c->ApplyFilter(filter, order);
   }
-  filtered_tasks_ = filter->FilterVector(subtasks_);
+  FilterSubtasks(filter, order);
 }
 
-void Task::AddSubTask(Task* subtask) {
-  subtask->SetParent(this);
-  subtasks_.push_back(subtask);
+void Task::ApplyFilterInParallel(const FilterProgram<Task>& filter,
+                                 SortOrder order, ThreadPool* pool) {
+  UpdateSortKey(order);
+  ApplyFilterToSiblings(FirstChild(), NumChildren(), filter, order, pool);
+  FilterSubtasks(filter, order);
 }
 
-void Task::RemoveSubtaskFromList(Task* t) {
-  for (int i = 0; i < subtasks_.size(); ++i) {
-    if (subtasks_[i] == t) {
-      subtasks_.erase(subtasks_.begin() + i);
-      return;
+static void ApplyFilterToChunk(Task* first, int count,
+                               const FilterProgram<Task>* filter,
+                               SortOrder order, ThreadPool* pool) {
+  Task* t = first;
+  for (int i = 0; i < count; ++i, t = t->NextSibling()) {
+    if (t->NumChildren() > Constants::kFilterChunkSize) {
+      t->ApplyFilterInParallel(*filter, order, pool);
+    } else {
+      t->ApplyFilter(*filter, order);
     }
   }
 }
 
-void Task::DeleteTask(Task* t) {
-  // Check if we're supposed to delete ourselves:
-  if (this == t) {
-    Delete();
-  } else {
-    for (int i = 0; i < NumChildren(); ++i) {
-      if (Child(i) == t) {
-        Child(i)->Delete();
-        return;
-      } else {
-        Child(i)->DeleteTask(t);
-      }
+void Task::ApplyFilterToSiblings(Task* first, int count,
+                                 const FilterProgram<Task>& filter,
+                                 SortOrder order, ThreadPool* pool) {
+  if (pool == NULL || count <= Constants::kFilterChunkSize) {
+    ApplyFilterToChunk(first, count, &filter, order, pool);
+    return;
+  }
+  int chunk_size = Constants::kFilterChunkSize;
+  ThreadPool::WorkGroup group;
+  Task* t = first;
+  for (int i = 0; i < count; i += chunk_size) {
+    int n = std::min(chunk_size, count - i);
+    pool->Fork(&group,
+               std::bind(ApplyFilterToChunk, t, n, &filter, order, pool));
+    for (int j = 0; j < n; ++j) {
+      t = t->NextSibling();
     }
   }
+  pool->Join(&group);
 }
 
-void Task::Delete() {
-  for (int i = 0; i < NumChildren(); ++i) {
-    Child(i)->Delete();
+void Task::FilterSubtasks(const FilterProgram<Task>& filter, SortOrder order) {
+  if (NumChildren() == 0 && !HasFilteredSubtasks()) {
+    return;
   }
-  if (Parent() != NULL) {
-    Parent()->RemoveSubtaskFromList(this);
+  // There's room for every subtask, so the list is claimed before any are
+  // tested.
+  Task** filtered = filtered_lists_->Claim(id_, NumChildren());
+  int size = 0;
+  for (Task* c = FirstChild(); c != NULL; c = c->NextSibling()) {
+    if (filter.ObjectPasses(c)) {
+      filtered[size++] = c;
+    }
+  }
+  filtered_lists_->SetSize(id_, size);
+  if (order != SORT_BY_POSITION) {
+    sort(filtered, filtered + size, SortsBefore);
   }
-  delete this;
 }
 
-void Task::SwapTasks(Task* a, Task* b) {
-  if (a == b) {
+void Task::UpdateSortKey(SortOrder order) {
+  if (!sort_key_stale_ && sort_key_order_ == order) {
     return;
   }
+  sort_key_order_ = order;
+  sort_key_stale_ = false;
+  sort_number_ = 0;
+  sort_text_.clear();
+  switch (order) {
+    case SORT_BY_TITLE:
+      // Case is ignored.  Lowering it here rather than in every comparison is
+      // the main point of caching keys.
+      sort_text_ = title_;
+      for (int i = 0; i < sort_text_.size(); ++i) {
+        sort_text_[i] = tolower(sort_text_[i]);
+      }
+      break;
+    case SORT_BY_CREATION_DATE:
+      sort_number_ = creation_date_.Time();
+      break;
+    case SORT_BY_COMPLETION_DATE:
+      // Unfinished tasks go last.
+      sort_number_ = completion_date_.Time() == 0
+                         ? std::numeric_limits<time_t>::max()
+                         : completion_date_.Time();
+      break;
+    case SORT_BY_STATUS:
+      sort_number_ = status_;
+      break;
+    case SORT_BY_POSITION:
+    case NUM_SORT_ORDERS:
+      break;
+  }
+}
 
-  // Find the indices of a and b.
-  vector<Task*>::iterator ait = find(subtasks_.begin(), subtasks_.end(), a);
-  vector<Task*>::iterator bit = find(subtasks_.begin(), subtasks_.end(), b);
-
-  assert(ait != subtasks_.end() || bit != subtasks_.end());
+bool Task::SortsBefore(Task* a, Task* b) {
+  if (a->sort_number_ != b->sort_number_) {
+    return a->sort_number_ < b->sort_number_;
+  }
+  int text_order = a->sort_text_.compare(b->sort_text_);
+  if (text_order != 0) {
+    return text_order < 0;
+  }
+  return a->SiblingIndex() < b->SiblingIndex();
+}
 
-  int ai = ait - subtasks_.begin();
-  int bi = bit - subtasks_.begin();
+void Task::AddSubTask(Task* subtask) {
+  subtask->SetParent(this);
+  subtask->sibling_node_ = subtasks_.PushBack(subtask);
+  MarkChanged();
+}
 
-  Task* tmp = a;
-  subtasks_[ai] = b;
-  subtasks_[bi] = tmp;
-  return;
+void Task::InsertSubTask(Task* subtask, int index) {
+  subtask->SetParent(this);
+  subtask->sibling_node_ = subtasks_.Insert(index, subtask);
+  MarkChanged();
 }
 
-void Task::MoveTaskUp(Task* t) {
-  // We can't move up the first task.
-  if (t == filtered_tasks_[0]) {
-    return;
-  }
+void Task::MoveSubTask(Task* subtask, int index) {
+  subtasks_.Move(subtask->sibling_node_, index);
+  MarkChanged();
+}
 
-  // Find the task in our filtered list:
-  vector<Task*>::iterator it =
-      find(filtered_tasks_.begin(), filtered_tasks_.end(), t);
-  --it;
-  SwapTasks(*it, t);
+void Task::RemoveSubtaskFromList(Task* t) {
+  subtasks_.Erase(t->sibling_node_);
+  t->sibling_node_ = NULL;
+  MarkChanged();
 }
 
-void Task::MoveTaskDown(Task* t) {
-  // We can't move down the last task.
-  if (t == filtered_tasks_[filtered_tasks_.size() - 1]) {
-    return;
-  }
+Task* Task::FirstChild() {
+  IndexedList<Task*>::Node* n = subtasks_.First();
+  return n == NULL ? NULL : n->Value();
+}
 
-  // Find the task in our filtered list:
-  vector<Task*>::iterator it =
-      find(filtered_tasks_.begin(), filtered_tasks_.end(), t);
-  ++it;
-  SwapTasks(t, *it);
+Task* Task::NextSibling() {
+  IndexedList<Task*>::Node* n = IndexedList<Task*>::Next(sibling_node_);
+  return n == NULL ? NULL : n->Value();
 }
 
-void Task::MoveUp() {
-  if (Parent()) {
-    Parent()->MoveTaskUp(this);
+int Task::SiblingIndex() { return IndexedList<Task*>::IndexOf(sibling_node_); }
+
+void Task::DeleteTask(Task* t) {
+  // Check if we're supposed to delete ourselves:
+  if (this == t) {
+    Delete();
+  } else {
+    for (Task* c = FirstChild(); c != NULL; c = c->NextSibling()) {
+      if (c == t) {
+        c->Delete();
+        return;
+      } else {
+        c->DeleteTask(t);
+      }
+    }
   }
 }
 
-void Task::MoveDown() {
-  if (Parent()) {
-    Parent()->MoveTaskDown(this);
+void Task::Delete() {
+  // Our destructor takes care of deleting all of our children.
+  if (Parent() != NULL) {
+    Parent()->RemoveSubtaskFromList(this);
   }
+  delete this;
 }
 
 void Task::Serialize(Serializer* s) {
@@ -208,10 +384,14 @@ void Task::Serialize(Serializer* s) {
     }
   }
 
+  if (s->Version() >= TASK_ID_VERSION) {
+    s->WriteInt32(id_);
+  }
+
   // Finally our parent pointer and then we move onto the children.
   s->WriteUint64((uint64)parent_);
-  for (int i = 0; i < subtasks_.size(); ++i) {
-    subtasks_[i]->Serialize(s);
+  for (Task* c = FirstChild(); c != NULL; c = c->NextSibling()) {
+    c->Serialize(s);
   }
 }
 
@@ -239,6 +419,10 @@ void Task::UnSerializeFromSerializer(Serializer* s) {
       status_changes_.push_back(StatusChange(d, status));
     }
   }
+
+  if (s->Version() >= TASK_ID_VERSION) {
+    id_ = s->ReadInt32();
+  }
 }
 
 void Task::SetStatus(TaskStatus t) {
@@ -256,24 +440,66 @@ void Task::SetStatus(TaskStatus t) {
   }
 
   status_ = t;
+  InvalidateSortKey();
 
   // Update the status record for this task.
   status_changes_.push_back(StatusChange(Date(), status_));
+  MarkChanged();
+}
+
+Task::StatusState Task::SaveStatusState() {
+  StatusState state;
+  state.status = status_;
+  state.start_date = start_date_;
+  state.completion_date = completion_date_;
+  state.num_status_changes = status_changes_.size();
+  return state;
+}
+
+void Task::RestoreStatusState(const StatusState& state) {
+  status_ = state.status;
+  start_date_ = state.start_date;
+  completion_date_ = state.completion_date;
+  if (state.num_status_changes < status_changes_.size()) {
+    status_changes_.erase(status_changes_.begin() + state.num_status_changes,
+                          status_changes_.end());
+  }
+  InvalidateSortKey();
+  MarkChanged();
+}
+
+void Task::SetListText(const string& text) {
+  title_ = text;
+  InvalidateSortKey();
+  MarkChanged();
 }
 
 int Task::NumOffspring() {
   int sum_from_children = 0;
-  for (int i = 0; i < subtasks_.size(); ++i) {
-    sum_from_children += 1 + subtasks_[i]->NumOffspring();
+  for (Task* c = FirstChild(); c != NULL; c = c->NextSibling()) {
+    sum_from_children += 1 + c->NumOffspring();
   }
 
   return sum_from_children;
 }
 
+size_t Task::MemoryUsage() {
+  size_t usage = sizeof(*this) + title_.capacity() + description_.capacity() +
+                 status_changes_.capacity() * sizeof(StatusChange) +
+                 subtasks_.Size() * sizeof(IndexedList<Task*>::Node);
+  for (int i = 0; i < notes_.size(); ++i) {
+    usage += sizeof(Note*) + sizeof(Note) + notes_[i]->GetText().size();
+  }
+  for (Task* c = FirstChild(); c != NULL; c = c->NextSibling()) {
+    usage += c->MemoryUsage();
+  }
+  return usage;
+}
+
 int Task::NumFilteredOffspring() {
   int sum_from_children = 0;
-  for (int i = 0; i < filtered_tasks_.size(); ++i) {
-    sum_from_children += 1 + filtered_tasks_[i]->NumFilteredOffspring();
+  for (int i = 0; i < NumFilteredChildren(); ++i) {
+    sum_from_children += 1 + FilteredChild(i)->NumFilteredOffspring();
   }
   return sum_from_children;
 }
@@ -293,9 +519,12 @@ int Task::ListColor() {
   return c;
 }
 
-int Task::NumFilteredChildren() { return filtered_tasks_.size(); }
-
-Task* Task::FilteredChild(int c) { return filtered_tasks_[c]; }
+ListItem* Task::ListParent() {
+  if (parent_ != NULL) {
+    return parent_;
+  }
+  return observer_ == NULL ? NULL : observer_->ListParentOfRoots();
+}
 
 void Task::ToStream(ostream& out, int depth) {
   const string marker = "- ";
@@ -1,25 +1,31 @@
 #ifndef TASK_H_
 #define TASK_H_
 
-// TODO: Swap(Task*, Task*) is still a bit flakey if the tasks are in the
-// "wrong" order.  Fix that.
-
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
 #include "date.h"
 #include "filter-predicate.h"
+#include "filtered-lists.h"
 #include "hierarchical-list.h"
+#include "indexed-list.h"
+#include "trigram-index.h"
 
 using std::map;
 using std::ofstream;
 using std::ostream;
+using std::shared_ptr;
 using std::string;
 using std::vector;
+using std::weak_ptr;
 
 class Note;
+class ThreadPool;
 class Serializer;
+class Task;
+class TaskSnapshot;
 
 typedef enum TaskStatus_ {
   CREATED,
@@ -29,57 +35,178 @@ typedef enum TaskStatus_ {
   NUM_STATUSES,
 } TaskStatus;
 
+// The orders a project can show tasks in.  Whatever the order, tasks keep
+// their stored positions among their siblings.
+typedef enum SortOrder_ {
+  SORT_BY_POSITION,
+  SORT_BY_TITLE,
+  SORT_BY_CREATION_DATE,
+  SORT_BY_COMPLETION_DATE,
+  SORT_BY_STATUS,
+  NUM_SORT_ORDERS,
+} SortOrder;
+
+// Whoever owns a tree of tasks can register as the observer of its root tasks
+// to hear about every change made anywhere in that tree.
+class TaskObserver {
+ public:
+  virtual ~TaskObserver() {}
+  virtual void TaskChanged(Task* t) = 0;
+  // What the root tasks hang from in a HierarchicalList, if anything.
+  virtual ListItem* ListParentOfRoots() { return NULL; }
+};
+
 class Task : public ListItem {
  public:
   Task(const string& title, const string& description);
   virtual ~Task();
   static Task* NewTaskFromSerializer(Serializer* s);
 
+  // Copies this task and all of its offspring, notes included, in one pass.
+  // The copy belongs to no project yet.  Unless keep_status is set the copies
+  // start out fresh, with no status history.
+  Task* Clone(bool keep_status);
+
+  // Handed out by the project the task belongs to, or 0 if it hasn't been
+  // given one yet.  Saved along with the task, so it never changes.
+  int Id() { return id_; }
+
+  // Returns an immutable snapshot of this task and all of its children.  While
+  // anyone holds on to it, the same snapshot is handed out again until this
+  // task or one of its offspring changes.
+  shared_ptr<const TaskSnapshot> Snapshot();
+
+  // Writes this task and all of its children straight from the live tree.
+  void Serialize(Serializer* s);
+
+  // Only root tasks need an observer.  Changes further down the tree are
+  // reported to the observer of their root.
+  void SetObserver(TaskObserver* o) { observer_ = o; }
+
   bool HasNotes();
   void AddNote(const string& note);
   void DeleteNote(const string& note);
   vector<string> Notes();
   map<string, string> MappedNotes();
 
-  string Title() { return title_; }
-  static string TitleWrapper(Task* t) { return t->Title(); }
-  string Description() { return description_; }
-  static string DescriptionWrapper(Task* t) { return t->Description(); }
+  // Lower level note access so notes can be taken out and put back unchanged,
+  // keeping their dates.  FindNote() returns the index DeleteNote() would
+  // remove, or -1.
+  int NumNotes() { return notes_.size(); }
+  int FindNote(const string& note);
+  Note* DetachNote(int i);
+  void AttachNote(int i, Note* n);
+
+  const string& Title() { return title_; }
+  const string& Description() { return description_; }
   Date CompletionDate() { return completion_date_; }
-  static time_t CompletionDateWrapper(Task* t) {
-    return t->CompletionDate().Time();
-  }
+  time_t CreationTime() { return creation_date_.Time(); }
+  time_t CompletionTime() { return completion_date_.Time(); }
+
+  // Getters for filter predicates.  Being types rather than functions, they
+  // get inlined, and the strings are never copied.
+  struct IdGetter {
+    int operator()(Task* t) const { return t->id_; }
+  };
+  struct TitleGetter {
+    const string& operator()(Task* t) const { return t->title_; }
+  };
+  struct DescriptionGetter {
+    const string& operator()(Task* t) const { return t->description_; }
+  };
+  struct CreationTimeGetter {
+    time_t operator()(Task* t) const { return t->creation_date_.Time(); }
+  };
+  struct CompletionTimeGetter {
+    time_t operator()(Task* t) const { return t->completion_date_.Time(); }
+  };
+  struct StatusGetter {
+    TaskStatus operator()(Task* t) const { return t->status_; }
+  };
+  struct HasFilteredSubtasksGetter {
+    bool operator()(Task* t) const { return t->HasFilteredSubtasks(); }
+  };
+  struct MatchesSearchGetter {
+    bool operator()(Task* t) const { return t->matches_search_; }
+  };
+  struct HasDescriptionGetter {
+    bool operator()(Task* t) const { return !t->description_.empty(); }
+  };
+  struct HasNotesGetter {
+    bool operator()(Task* t) const { return !t->notes_.empty(); }
+  };
+  // Every note's text, a line each.  Unlike the others this makes a copy.
+  struct NotesTextGetter {
+    string operator()(Task* t) const;
+  };
 
-  void ApplyFilter(FilterPredicate<Task>* filter);
+  // Filters the subtree and puts each task's filtered subtasks in |order|.
+  void ApplyFilter(const FilterProgram<Task>& filter, SortOrder order);
+  // The same, spreading the work over pool.
+  void ApplyFilterInParallel(const FilterProgram<Task>& filter, SortOrder order,
+                             ThreadPool* pool);
+  // Filters count siblings, starting with first, and all of their offspring.
+  // Each worker only writes the filtered lists of the tasks it was given, and
+  // the project has made room for them all, so nothing needs locking.
+  static void ApplyFilterToSiblings(Task* first, int count,
+                                    const FilterProgram<Task>& filter,
+                                    SortOrder order, ThreadPool* pool);
+
+  // Sort keys are computed once and cached until the task is edited.  An
+  // edited task's stale key is still what it's compared by, so whoever keeps
+  // a sorted list of tasks can find it there before calling UpdateSortKey()
+  // and moving it to its new place.
+  void UpdateSortKey(SortOrder order);
+  // Compares the cached keys, breaking ties by position among siblings, so a
+  // list sorted this way has exactly one place for every task.
+  static bool SortsBefore(Task* a, Task* b);
   void AddSubTask(Task* subtask);
+  void InsertSubTask(Task* subtask, int index);
+  // Moves subtask to position index, counted after it has been taken out.
+  void MoveSubTask(Task* subtask, int index);
   void SetParent(Task* p) { parent_ = p; }
   void RemoveSubtaskFromList(Task* t);
   void Delete();
   void DeleteTask(Task* t);
-  void SwapTasks(Task* a, Task* b);
-  void MoveTaskUp(Task* t);
-  void MoveTaskDown(Task* t);
-  void MoveUp();
-  void MoveDown();
 
   void SetStatus(TaskStatus t);
   TaskStatus Status() { return status_; }
-  static TaskStatus StatusWrapper(Task* t) { return t->Status(); }
 
-  // Serializes this task and all of its children.
-  void Serialize(Serializer* s);
+  // Everything SetStatus() changes, so that a status change can be undone.
+  struct StatusState {
+    TaskStatus status;
+    Date start_date;
+    Date completion_date;
+    int num_status_changes;
+  };
+  StatusState SaveStatusState();
+  void RestoreStatusState(const StatusState& state);
 
   // Returns the number of tasks below this task.
   int NumOffspring();
+
+  // Roughly how many bytes this task and all of its offspring take up.
+  size_t MemoryUsage();
   int NumFilteredOffspring();
-  static int NumFilteredOffspringWrapper(Task* t) {
-    return t->NumFilteredOffspring();
-  }
+  // Whether anything below this task passed the filter.  Subtasks are filtered
+  // before their parent, so while a task is being filtered this is already
+  // known for its whole subtree.
+  bool HasFilteredSubtasks() { return NumFilteredChildren() > 0; }
 
-  int NumChildren() { return subtasks_.size(); }
-  Task* Child(int i) { return subtasks_[i]; }
-  int NumFilteredChildren();
-  Task* FilteredChild(int c);
+  // Subtasks are kept in an IndexedList, so these are all O(log n) in the
+  // number of siblings.  Walk every child with FirstChild() and NextSibling()
+  // instead of Child(i), which is linear overall.
+  int NumChildren() { return subtasks_.Size(); }
+  Task* Child(int i) { return subtasks_.At(i); }
+  vector<Task*> Children() { return subtasks_.ToVector(); }
+  Task* FirstChild();
+  // Works for root tasks too, walking the project's list of roots.
+  Task* NextSibling();
+  int SiblingIndex();
+  int NumFilteredChildren() {
+    return filtered_lists_ == NULL ? 0 : filtered_lists_->Size(id_);
+  }
+  Task* FilteredChild(int c) { return filtered_lists_->At(id_, c); }
   Task* Parent() { return parent_; }
 
   // Functions required by list item
@@ -91,24 +218,55 @@ class Task : public ListItem {
       return completion_date_.ToString();
     }
     if (c == "N") return (notes_.size() ? "X" : "");
+    if (c == "Id") return std::to_string(id_);
     return "UNKNOWN";
   }
   int ListColor();
   int NumListChildren() { return NumFilteredChildren(); }
   Task* ListChild(int c) { return FilteredChild(c); }
-  Task* ListParent() { return Parent(); }
-  void SetListText(const string& text) { title_ = text; }
+  ListItem* ListParent();
+  void SetListText(const string& text);
 
   void ToStream(ostream& out, int depth);
 
  private:
   friend class Project;
+  friend class TaskSnapshot;
   void UnSerializeFromSerializer(Serializer* s);
+  // Refills this task's filtered list once the subtasks have been filtered.
+  void FilterSubtasks(const FilterProgram<Task>& filter, SortOrder order);
 
+  // Must be called after any change to this task.  Forgets the snapshots on
+  // the path to the root and tells the root's observer.
+  void MarkChanged();
+
+  // Gives every task in the subtree that doesn't have an id yet the next one,
+  // in pre-order, so a new subtree gets a contiguous range.
+  void AssignIds(int* next_id);
+
+  void InvalidateSortKey() { sort_key_stale_ = true; }
+
+  int id_;
+  // What the project's title index files this task under.
+  string title_key_;
+  // When the project's index has the task completed, or 0 if it isn't there.
+  time_t completion_key_;
+  // What the project's search index files this task under, and whether it
+  // matches the project's current search.
+  vector<TrigramIndex::Trigram> search_trigrams_;
+  bool matches_search_;
   Task* parent_;
+  // Where this task sits in its parent's subtasks, or the project's roots.
+  IndexedList<Task*>::Node* sibling_node_;
+  TaskObserver* observer_;
+  // Only a weak reference, so a snapshot nobody holds is freed rather than
+  // keeping a second copy of the task around.
+  weak_ptr<const TaskSnapshot> snapshot_;
   TaskStatus status_;
-  vector<Task*> subtasks_;
-  vector<Task*> filtered_tasks_;
+  IndexedList<Task*> subtasks_;
+  // The project's filtered lists, which hold this task's filtered subtasks,
+  // or NULL while it isn't in a project.
+  FilteredLists* filtered_lists_;
   string title_;
   string description_;
   Date creation_date_;
@@ -116,6 +274,13 @@ class Task : public ListItem {
   Date completion_date_;
   vector<Note*> notes_;
 
+  // What this task sorts by under sort_key_order_.  Only one of them is used
+  // for any given order.
+  SortOrder sort_key_order_;
+  bool sort_key_stale_;
+  time_t sort_number_;
+  string sort_text_;
+
   // Keep track of any changes to the status of a task.
   struct StatusChange {
     StatusChange(const Date& d, int s)
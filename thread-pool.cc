@@ -0,0 +1,175 @@
+#include "thread-pool.h"
+
+using std::lock_guard;
+using std::unique_lock;
+
+thread_local ThreadPool* ThreadPool::current_pool_ = NULL;
+thread_local int ThreadPool::current_worker_ = -1;
+
+ThreadPool::ThreadPool(int num_threads)
+    : num_queued_(0), num_unfinished_(0), num_sleeping_(0), stopping_(false) {
+  if (num_threads <= 0) {
+    num_threads = thread::hardware_concurrency();
+  }
+  if (num_threads <= 0) {
+    num_threads = 1;
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    worker_queues_.push_back(new WorkerQueue());
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.push_back(thread(&ThreadPool::RunWorker, this, i));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    unique_lock<mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_ready_.notify_all();
+  for (int i = 0; i < threads_.size(); ++i) {
+    threads_[i].join();
+  }
+  for (int i = 0; i < worker_queues_.size(); ++i) {
+    delete worker_queues_[i];
+  }
+}
+
+void ThreadPool::Schedule(const function<void()>& work) {
+  ++num_unfinished_;
+  {
+    unique_lock<mutex> lock(mutex_);
+    Work w = {work, NULL};
+    queue_.push_back(w);
+  }
+  WorkQueued();
+}
+
+void ThreadPool::Wait() {
+  unique_lock<mutex> lock(mutex_);
+  while (num_unfinished_ > 0) {
+    work_done_.wait(lock);
+  }
+}
+
+void ThreadPool::Fork(WorkGroup* group, const function<void()>& work) {
+  ++group->num_pending_;
+  ++num_unfinished_;
+  Work w = {work, group};
+  if (current_pool_ == this) {
+    WorkerQueue* queue = worker_queues_[current_worker_];
+    lock_guard<mutex> lock(queue->lock);
+    queue->work.push_back(w);
+  } else {
+    unique_lock<mutex> lock(mutex_);
+    queue_.push_back(w);
+  }
+  WorkQueued();
+}
+
+void ThreadPool::Join(WorkGroup* group) {
+  int index = current_pool_ == this ? current_worker_ : -1;
+  while (group->num_pending_ > 0) {
+    Work work;
+    if (TakeWork(index, &work)) {
+      RunWork(work);
+      continue;
+    }
+    // What's left of the group is running on other threads.
+    unique_lock<mutex> lock(mutex_);
+    if (group->num_pending_ > 0) {
+      work_done_.wait(lock);
+    }
+  }
+}
+
+void ThreadPool::RunWorker(int index) {
+  current_pool_ = this;
+  current_worker_ = index;
+  while (true) {
+    Work work;
+    if (TakeWork(index, &work)) {
+      RunWork(work);
+      continue;
+    }
+    // Whoever queues work after we've counted ourselves asleep sees that and
+    // takes mutex_ to wake us, so the wakeup can't slip in before the wait.
+    unique_lock<mutex> lock(mutex_);
+    ++num_sleeping_;
+    while (num_queued_ == 0 && !stopping_) {
+      work_ready_.wait(lock);
+    }
+    --num_sleeping_;
+    if (num_queued_ == 0) {
+      // Only stopping once there's nothing left to do.
+      return;
+    }
+  }
+}
+
+bool ThreadPool::TakeWork(int index, Work* work) {
+  if (num_queued_ == 0) {
+    return false;
+  }
+  // A worker's own newest work is the likeliest to still be in its cache.
+  if (index >= 0) {
+    WorkerQueue* queue = worker_queues_[index];
+    lock_guard<mutex> lock(queue->lock);
+    if (!queue->work.empty()) {
+      *work = queue->work.back();
+      queue->work.pop_back();
+      --num_queued_;
+      return true;
+    }
+  }
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (!queue_.empty()) {
+      *work = queue_.front();
+      queue_.pop_front();
+      --num_queued_;
+      return true;
+    }
+  }
+  // Steal the oldest work of another worker, which is usually the biggest.
+  for (int i = 0; i < worker_queues_.size(); ++i) {
+    if (i == index) {
+      continue;
+    }
+    WorkerQueue* queue = worker_queues_[i];
+    lock_guard<mutex> lock(queue->lock);
+    if (!queue->work.empty()) {
+      *work = queue->work.front();
+      queue->work.pop_front();
+      --num_queued_;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::WorkQueued() {
+  ++num_queued_;
+  if (num_sleeping_ > 0) {
+    // A worker counted asleep holds mutex_ until it's waiting.
+    { lock_guard<mutex> lock(mutex_); }
+    work_ready_.notify_one();
+  }
+}
+
+void ThreadPool::RunWork(const Work& work) {
+  work.run();
+  // The group may be gone as soon as its last work is counted.
+  bool group_done = work.group != NULL && --work.group->num_pending_ == 0;
+  bool all_done = --num_unfinished_ == 0;
+  if (group_done || all_done) {
+    WakeWaiters();
+  }
+}
+
+void ThreadPool::WakeWaiters() {
+  // Anyone who saw the old counts is waiting by the time we get mutex_.
+  { lock_guard<mutex> lock(mutex_); }
+  work_done_.notify_all();
+}
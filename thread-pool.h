@@ -0,0 +1,114 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+// A fixed set of worker threads that run whatever work is scheduled on them,
+// in the order it was scheduled:
+//
+//   ThreadPool pool(0);
+//   for (int i = 0; i < paths.size(); ++i) {
+//     pool.Schedule(std::bind(LoadProject, paths[i], &projects[i]));
+//   }
+//   pool.Wait();
+//
+// Work can also be forked into a WorkGroup and joined, from inside other work
+// or not.  Each worker keeps the work it forks in a deque of its own, with its
+// own lock, running the newest first, and only takes work from the others
+// when it runs out.  A thread waiting in Join() runs pending work rather than
+// sleeping:
+//
+//   ThreadPool::WorkGroup group;
+//   pool->Fork(&group, std::bind(FilterSubtree, left));
+//   pool->Fork(&group, std::bind(FilterSubtree, right));
+//   pool->Join(&group);
+//
+// Work must not touch curses, which isn't thread safe.
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::atomic;
+using std::condition_variable;
+using std::deque;
+using std::function;
+using std::mutex;
+using std::thread;
+using std::vector;
+
+class ThreadPool {
+ public:
+  // Starts num_threads workers, or one per processor if num_threads is 0.
+  explicit ThreadPool(int num_threads);
+  // Finishes everything scheduled before stopping the workers.
+  ~ThreadPool();
+
+  int NumThreads() { return threads_.size(); }
+  void Schedule(const function<void()>& work);
+  // Blocks until everything scheduled so far has run.  Must not be called
+  // from a worker.
+  void Wait();
+
+  // Work forked together, to be joined together.
+  class WorkGroup {
+   public:
+    WorkGroup() : num_pending_(0) {}
+
+   private:
+    friend class ThreadPool;
+    atomic<int> num_pending_;
+  };
+  void Fork(WorkGroup* group, const function<void()>& work);
+  // Runs pending work until everything forked into group has run.
+  void Join(WorkGroup* group);
+
+ private:
+  // Not copyable.
+  ThreadPool(const ThreadPool&);
+  ThreadPool& operator=(const ThreadPool&);
+
+  struct Work {
+    function<void()> run;
+    WorkGroup* group;  // NULL for scheduled work.
+  };
+
+  // The work one worker forked, and the lock that guards only it.
+  struct WorkerQueue {
+    mutex lock;
+    deque<Work> work;
+  };
+
+  void RunWorker(int index);
+  // Takes the next work for worker index (-1 for other threads) to run,
+  // locking one queue at a time.
+  bool TakeWork(int index, Work* work);
+  // Counts newly queued work and wakes a sleeping worker, if there is one.
+  void WorkQueued();
+  void RunWork(const Work& work);
+  // Wakes the threads in Wait() and Join() to check whether they're done.
+  void WakeWaiters();
+
+  // The worker the calling thread is, if it's one of this pool's.
+  static thread_local ThreadPool* current_pool_;
+  static thread_local int current_worker_;
+
+  vector<thread> threads_;
+  // Guards queue_ and stopping_, and is what threads sleep on.  Workers only
+  // take it for their own work to go to sleep, or to wake others.
+  mutex mutex_;
+  condition_variable work_ready_;
+  condition_variable work_done_;
+  deque<Work> queue_;
+  vector<WorkerQueue*> worker_queues_;
+  // Work waiting in any queue, work not finished running yet, and workers
+  // asleep waiting for work.
+  atomic<int> num_queued_;
+  atomic<int> num_unfinished_;
+  atomic<int> num_sleeping_;
+  bool stopping_;
+};
+
+#endif  // THREAD_POOL_H_
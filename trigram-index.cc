@@ -0,0 +1,145 @@
+#include "trigram-index.h"
+#include <ctype.h>
+#include <limits.h>
+#include <algorithm>
+
+using std::lower_bound;
+using std::min;
+using std::sort;
+using std::unique;
+
+void TrigramIndex::AddTrigrams(const string& text, vector<Trigram>* trigrams) {
+  Trigram trigram = 0;
+  for (int i = 0; i < text.size(); ++i) {
+    unsigned char c = tolower(static_cast<unsigned char>(text[i]));
+    trigram = ((trigram << 8) | c) & 0xffffff;
+    if (i >= 2) {
+      trigrams->push_back(trigram);
+    }
+  }
+}
+
+void TrigramIndex::SortTrigrams(vector<Trigram>* trigrams) {
+  sort(trigrams->begin(), trigrams->end());
+  trigrams->erase(unique(trigrams->begin(), trigrams->end()), trigrams->end());
+}
+
+void TrigramIndex::Update(int id, const vector<Trigram>& old_trigrams,
+                          const vector<Trigram>& new_trigrams) {
+  // Both are sorted, so a merge finds the differences.
+  int i = 0;
+  int j = 0;
+  while (i < old_trigrams.size() || j < new_trigrams.size()) {
+    if (j == new_trigrams.size() ||
+        (i < old_trigrams.size() && old_trigrams[i] < new_trigrams[j])) {
+      Remove(old_trigrams[i++], id);
+    } else if (i == old_trigrams.size() || new_trigrams[j] < old_trigrams[i]) {
+      Add(new_trigrams[j++], id);
+    } else {
+      ++i;
+      ++j;
+    }
+  }
+}
+
+void TrigramIndex::Add(Trigram trigram, int id) {
+  vector<int>& ids = postings_[trigram];
+  if (ids.empty() || ids.back() < id) {
+    ids.push_back(id);
+    return;
+  }
+  vector<int>::iterator it = lower_bound(ids.begin(), ids.end(), id);
+  if (*it != id) {
+    ids.insert(it, id);
+  }
+}
+
+void TrigramIndex::Remove(Trigram trigram, int id) {
+  unordered_map<Trigram, vector<int> >::iterator posting =
+      postings_.find(trigram);
+  if (posting == postings_.end()) {
+    return;
+  }
+  vector<int>& ids = posting->second;
+  vector<int>::iterator it = lower_bound(ids.begin(), ids.end(), id);
+  if (it != ids.end() && *it == id) {
+    ids.erase(it);
+  }
+  if (ids.empty()) {
+    postings_.erase(posting);
+  }
+}
+
+static bool IsShorter(const vector<int>* a, const vector<int>* b) {
+  return a->size() < b->size();
+}
+
+bool TrigramIndex::Candidates(const string& needle, vector<int>* ids) const {
+  ids->clear();
+  vector<Trigram> trigrams;
+  AddTrigrams(needle, &trigrams);
+  if (trigrams.empty()) {
+    return false;
+  }
+  SortTrigrams(&trigrams);
+
+  // Intersect the shortest postings first, so the candidates only shrink.
+  vector<const vector<int>*> postings;
+  for (int i = 0; i < trigrams.size(); ++i) {
+    unordered_map<Trigram, vector<int> >::const_iterator posting =
+        postings_.find(trigrams[i]);
+    if (posting == postings_.end()) {
+      return true;
+    }
+    postings.push_back(&posting->second);
+  }
+  sort(postings.begin(), postings.end(), IsShorter);
+
+  *ids = *postings[0];
+  for (int i = 1; i < postings.size() && !ids->empty(); ++i) {
+    // Each candidate is searched for past where the last one was found.
+    const vector<int>& other = *postings[i];
+    vector<int>::const_iterator from = other.begin();
+    int kept = 0;
+    for (int j = 0; j < ids->size(); ++j) {
+      from = lower_bound(from, other.end(), (*ids)[j]);
+      if (from == other.end()) {
+        break;
+      }
+      if (*from == (*ids)[j]) {
+        (*ids)[kept++] = (*ids)[j];
+      }
+    }
+    ids->resize(kept);
+  }
+  return true;
+}
+
+int TrigramIndex::MaxCandidates(const string& needle) const {
+  vector<Trigram> trigrams;
+  AddTrigrams(needle, &trigrams);
+  if (trigrams.empty()) {
+    return -1;
+  }
+  int most = INT_MAX;
+  for (int i = 0; i < trigrams.size(); ++i) {
+    unordered_map<Trigram, vector<int> >::const_iterator posting =
+        postings_.find(trigrams[i]);
+    if (posting == postings_.end()) {
+      return 0;
+    }
+    most = min(most, static_cast<int>(posting->second.size()));
+  }
+  return most;
+}
+
+size_t TrigramIndex::MemoryUsage() const {
+  // Each entry is a node in its bucket's list, besides the bucket itself.
+  size_t usage = sizeof(*this) + postings_.bucket_count() * sizeof(void*);
+  for (unordered_map<Trigram, vector<int> >::const_iterator it =
+           postings_.begin();
+       it != postings_.end(); ++it) {
+    usage += sizeof(void*) + sizeof(*it) + it->second.capacity() * sizeof(int);
+  }
+  return usage;
+}
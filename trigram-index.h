@@ -0,0 +1,75 @@
+#ifndef TRIGRAM_INDEX_H_
+#define TRIGRAM_INDEX_H_
+
+// An inverted index from every run of three characters in some texts to the
+// ids of the texts they appear in, for finding substrings without scanning
+// every text:
+//
+//   vector<TrigramIndex::Trigram> trigrams;
+//   TrigramIndex::AddTrigrams(title, &trigrams);
+//   TrigramIndex::AddTrigrams(description, &trigrams);
+//   TrigramIndex::SortTrigrams(&trigrams);
+//   index.Update(id, vector<TrigramIndex::Trigram>(), trigrams);
+//   ...
+//   vector<int> ids;
+//   if (index.Candidates(needle, &ids)) {
+//     // Only the texts in ids can contain needle.
+//   }
+//
+// The index doesn't keep the texts, so whoever updates it has to remember
+// which trigrams each id was filed under.  Case is ignored, so candidates
+// still have to be checked.
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+class TrigramIndex {
+ public:
+  // Three characters folded to lower case, packed into the low three bytes.
+  typedef uint32_t Trigram;
+
+  TrigramIndex() {}
+
+  // Appends the trigrams of text.  They don't run across separate texts.
+  static void AddTrigrams(const string& text, vector<Trigram>* trigrams);
+  // Sorts trigrams and drops repeats, which Update() and Candidates() expect.
+  static void SortTrigrams(vector<Trigram>* trigrams);
+
+  // Refiles id from the sorted trigrams it was filed under to the sorted
+  // trigrams it has now.  Only the trigrams that differ are touched.
+  void Update(int id, const vector<Trigram>& old_trigrams,
+              const vector<Trigram>& new_trigrams);
+
+  // Sets ids to the ids filed under every trigram of needle, in increasing
+  // order.  Returns false instead if needle is too short to have trigrams, in
+  // which case every id is a candidate.
+  bool Candidates(const string& needle, vector<int>* ids) const;
+  // The most candidates needle can have, which is quick to find: the length
+  // of the shortest list Candidates() would intersect.  Returns -1 if needle
+  // is too short to have trigrams.
+  int MaxCandidates(const string& needle) const;
+
+  int NumTrigrams() const { return postings_.size(); }
+  // Roughly how many bytes the index takes up.
+  size_t MemoryUsage() const;
+
+ private:
+  // Not copyable, since it's usually big.
+  TrigramIndex(const TrigramIndex&);
+  TrigramIndex& operator=(const TrigramIndex&);
+
+  void Add(Trigram trigram, int id);
+  void Remove(Trigram trigram, int id);
+
+  // The ids filed under each trigram, in increasing order.  New texts usually
+  // get the highest ids yet, so they're appended.
+  unordered_map<Trigram, vector<int> > postings_;
+};
+
+#endif  // TRIGRAM_INDEX_H_
@@ -0,0 +1,106 @@
+#include "trigram-index.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static int errors = 0;
+
+ostream& ERROR() {
+  ++errors;
+  cout << "Error: ";
+  return cout;
+}
+
+typedef TrigramIndex::Trigram Trigram;
+
+vector<Trigram> TrigramsOf(const string& title, const string& description) {
+  vector<Trigram> trigrams;
+  TrigramIndex::AddTrigrams(title, &trigrams);
+  TrigramIndex::AddTrigrams(description, &trigrams);
+  TrigramIndex::SortTrigrams(&trigrams);
+  return trigrams;
+}
+
+// Checks the candidates for needle are the ids listed in expected, which is
+// a string of digits so the cases read easily.
+bool CandidatesAre(const TrigramIndex& index, const string& needle,
+                   const string& expected) {
+  vector<int> ids;
+  string found;
+  if (index.Candidates(needle, &ids)) {
+    for (int i = 0; i < ids.size(); ++i) {
+      found += '0' + ids[i];
+    }
+  } else {
+    found = "all";
+  }
+  if (found != expected) {
+    ERROR() << "Candidates for \"" << needle << "\" are " << found
+            << " instead of " << expected << "." << endl;
+    return false;
+  }
+  return true;
+}
+
+bool TestCandidates() {
+  cout << "Testing finding candidates" << endl;
+  TrigramIndex index;
+  vector<Trigram> none;
+  index.Update(3, none, TrigramsOf("Buy milk", "From the shop"));
+  index.Update(1, none, TrigramsOf("Fix the bike", ""));
+  index.Update(2, none, TrigramsOf("Shopping", "Milk, eggs"));
+
+  if (index.MaxCandidates("mi") != -1 || index.MaxCandidates("MILK") != 2 ||
+      index.MaxCandidates("fix the") != 1 || index.MaxCandidates("zzz") != 0) {
+    ERROR() << "The most candidates there can be are wrong." << endl;
+    return false;
+  }
+
+  // Case is ignored, and trigrams don't run from one text into the next.
+  return CandidatesAre(index, "mi", "all") &&
+         CandidatesAre(index, "MILK", "23") &&
+         CandidatesAre(index, "the", "13") &&
+         CandidatesAre(index, "shop", "23") &&
+         CandidatesAre(index, "kfr", "") && CandidatesAre(index, "zzz", "");
+}
+
+bool TestUpdates() {
+  cout << "Testing updating the index" << endl;
+  TrigramIndex index;
+  vector<Trigram> none;
+  vector<Trigram> old_trigrams = TrigramsOf("Call the bank", "");
+  index.Update(1, none, old_trigrams);
+  index.Update(2, none, TrigramsOf("Bank holiday", ""));
+  int num_trigrams = index.NumTrigrams();
+
+  vector<Trigram> new_trigrams = TrigramsOf("Call the plumber", "");
+  index.Update(1, old_trigrams, new_trigrams);
+  if (!CandidatesAre(index, "bank", "2") ||
+      !CandidatesAre(index, "call", "1") ||
+      !CandidatesAre(index, "plumb", "1")) {
+    return false;
+  }
+
+  // Trigrams nothing is filed under any more are dropped.
+  index.Update(1, new_trigrams, old_trigrams);
+  if (index.NumTrigrams() != num_trigrams) {
+    ERROR() << "Updating back left " << index.NumTrigrams() << " trigrams "
+            << "instead of " << num_trigrams << "." << endl;
+    return false;
+  }
+  index.Update(1, old_trigrams, none);
+  index.Update(2, TrigramsOf("Bank holiday", ""), none);
+  if (index.NumTrigrams() != 0) {
+    ERROR() << "Removing everything left trigrams behind." << endl;
+    return false;
+  }
+  return true;
+}
+
+int main() {
+  bool success = TestCandidates() && TestUpdates();
+  cout << errors << " errors." << endl;
+  return !success;
+}
@@ -1,8 +1,10 @@
 #include "workspace.h"
 #include <ncurses.h>
 #include <stdlib.h>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include "command-log.h"
 #include "constants.h"
 #include "dialog-box.h"
 #include "doneyet-config.h"
@@ -11,13 +13,19 @@
 #include "info-box.h"
 #include "list-chooser.h"
 #include "project.h"
+#include "regex-matcher.h"
 #include "serializer.h"
+#include "task-query.h"
+#include "thread-pool.h"
 #include "utils.h"
 
 static bool do_resize;
 
 Workspace::Workspace()
     : menubar_(NULL),
+      view_menu_(NULL),
+      command_log_(NULL),
+      thread_pool_(NULL),
       project_(NULL),
       list_(NULL),
       notes_list_(NULL),
@@ -25,27 +33,36 @@ Workspace::Workspace()
   // Initialize the menu bar.
   InitializeMenuBar();
 
-  // Figure out which project we want to load.
+  // Everything the user edits is recorded so it can be undone.
+  command_log_ =
+      new CommandLog(DoneyetConfig::GlobalConfig()->UndoMemoryBudget());
+
+  // Every saved project is loaded at once, each on a thread of its own, so
+  // switching between them later costs nothing.
+  thread_pool_ = new ThreadPool(0);
   FileManager* fm = FileManager::DefaultFileManager();
-  if (fm->NumSavedProjects()) {
-    string project_name = ListChooser::GetChoice(fm->SavedProjectNames());
-    if (project_name.empty()) {
-      return;
-    } else {
-      project_ = Project::NewProjectFromFile(fm->ProjectDir() + project_name);
-    }
-  } else {
-    project_ = CreateNewProject();
-    if (project_ == NULL) {
+  vector<string> names = fm->SavedProjectNames();
+  sort(names.begin(), names.end());
+  if (!projects_.LoadProjects(fm->ProjectDir(), names, thread_pool_)) {
+    Project* p = CreateNewProject();
+    if (p == NULL) {
       return;
     }
+    projects_.AddProject(p);
+  }
+  project_ = projects_.ProjectAt(0);
+  // Big projects are also split up over the pool when they're filtered.
+  for (int i = 0; i < projects_.NumProjects(); ++i) {
+    projects_.ProjectAt(i)->SetThreadPool(thread_pool_);
+  }
+  const map<string, string>& views = DoneyetConfig::GlobalConfig()->Views();
+  for (map<string, string>::const_iterator it = views.begin();
+       it != views.end(); ++it) {
+    AddView(it->first, it->second);
   }
 
   InitializeLists();
 
-  // Unserialize our project.
-  if (project_) list_->SetDatasource(project_);
-
   // Enable catching sigwinch.
   struct sigaction sa;
   sa.sa_sigaction = SigWinchHandler;
@@ -56,7 +73,8 @@ Workspace::Workspace()
 }
 
 Workspace::~Workspace() {
-  delete project_;
+  delete command_log_;
+  delete thread_pool_;
   delete menubar_;
   delete list_;
   if (notes_list_ != NULL) {
@@ -75,15 +93,26 @@ Workspace::~Workspace() {
 //  - u: Up.
 //  - d: Down.
 // n: Add note to selected task.
+// o: Choose the order tasks are shown in.
 // v: View notes of selected task.
 // j: Select next task.
 // k: Select previous task.
 // e: Edit selected task.
 // d: Delete selected task.
 // c: Toggle collapsed state of selected task.
+// t: Toggle the mark on the selected task.
+// T: Mark every task from the last marked one to the selected one.
+// x: Cut selected task, or the marked tasks.
+// p: Paste the cut tasks under the selected task, or at root level.
+// D: Duplicate the selected task and its offspring.
+// u: Undo the last edit.
+// r: Redo the last undone edit.
 // R: Show only uncompleted tasks.
 // C: Show only tasks completed in the last week.
 // f: Search tasks.
+// g: Go to a task by id or title.
+// F: Go to a task by fuzzy finding its path.
+// w: Show the tasks that pass a query.
 // h: display help.
 // Esc: Select no item.
 // Spc: Toggle selected task status.
@@ -116,8 +145,13 @@ void Workspace::Run() {
       do_resize = false;
       continue;
     }
-    // Get the selected task in the list.
-    selected_task = static_cast<Task*>(list_->SelectedItem());
+    // Get the selected task in the list, and the project it belongs to.  A
+    // project's own line counts as selecting no task in that project.
+    ListItem* selected_item = list_->SelectedItem();
+    if (selected_item != NULL) {
+      project_ = projects_.ProjectOf(selected_item);
+    }
+    selected_task = ProjectSet::TaskOf(selected_item);
     switch (ch) {
       case 'a':  // Add task
         AddTask(selected_task);
@@ -132,6 +166,11 @@ void Workspace::Run() {
         ShowTasksCompletedLastWeek();
         break;
       case 'd': {  // Deleted selected task
+        if (list_->HasMarks()) {
+          DeleteMarkedTasks();
+          break;
+        }
+
         // If nothing is selected there's nothing to delete.
         if (selected_task == NULL) {
           break;
@@ -148,32 +187,30 @@ void Workspace::Run() {
           }
         }
 
-        bool first_task_selected = selected_task == project_->Root(0);
-
+        // There's always a line above a task, if only its project's.
         list_->SelectPrevItem();
-        project_->DeleteTask(selected_task);
-        PerformFullListUpdate();
-        if (first_task_selected) {
-          // If the top task was the one that we deleted, then the
-          // list_->SelectPrevItem() won't have actually done anything, leaving
-          // the list with the deleted item still selected.  So, we manually
-          // select the new top task.
-          list_->ScrollToTop();
-        }
-
-        // Also, this could have been the last task.  If it was, make sure no
-        // task is selected now.
-        if (project_->NumTasks() == 0) {
-          list_->SelectNoItem();
-        }
+        cut_tasks_.clear();
+        RunCommand(new DeleteTaskCommand(project_, selected_task));
         break;
       }
+      case 'D':  // Duplicate selected task
+        DuplicateTask(selected_task);
+        break;
       case 'e':  // Edit selected task
-        list_->EditSelectedItem();
+        EditTask(selected_task);
         break;
       case 'f':  // Filter on string
         RunFind();
         break;
+      case 'g':  // Go to task
+        JumpToTask();
+        break;
+      case 'F':  // Go to task by fuzzy find
+        FuzzyFindTask();
+        break;
+      case 'w':  // Filter with a query
+        RunQuery();
+        break;
       case 'h':  // Display help
         DisplayHelp();
         break;
@@ -192,7 +229,20 @@ void Workspace::Run() {
         ShowMenuBar(selected_task);
         break;
       case 'n':  // Add note to selected task
-        AddNote(selected_task);
+        if (list_->HasMarks()) {
+          AddNoteToMarkedTasks();
+        } else {
+          AddNote(selected_task);
+        }
+        break;
+      case 'o':  // Choose sort order
+        ChooseSortOrder();
+        break;
+      case 'p':  // Paste cut tasks
+        PasteTasks(selected_task);
+        break;
+      case 'r':  // Redo
+        Redo();
         break;
       case 'R':  // Show unfinished tasks
         ShowUnfinishedTasks();
@@ -200,20 +250,39 @@ void Workspace::Run() {
       case 'v':
         ViewNotes(selected_task);
         break;
-      case 'S':  // Save project.
-        SaveCurrentProject();
+      case 'S':  // Save projects.
+        SaveProjects();
+        break;
+      case 'u':  // Undo
+        Undo();
+        break;
+      case 't':  // Toggle mark
+        if (selected_task != NULL) {
+          list_->ToggleMarkOfSelectedItem();
+        }
+        break;
+      case 'T':  // Mark range
+        list_->MarkToSelectedItem();
+        break;
+      case 'x':  // Cut selected or marked tasks
+        CutTasks(selected_task);
         break;
       case ' ':  // Toggle task status
-        ToggleStatus(selected_task);
+        if (list_->HasMarks()) {
+          SetStatusOfMarkedTasks();
+        } else {
+          ToggleStatus(selected_task);
+        }
         break;
       case 27:  // Escape
         list_->SelectNoItem();
+        list_->ClearMarks();
         break;
       case 'q':
         Quit();
         break;
     }
-    DisplayNotes(static_cast<Task*>(list_->SelectedItem()));
+    DisplayNotes(ProjectSet::TaskOf(list_->SelectedItem()));
     list_->Draw();
     if (notes_list_ != NULL) {
       notes_list_->Draw();
@@ -236,10 +305,10 @@ void Workspace::InitializeLists() {
                         : Constants::kNoteViewSize;
 
   string name = "";
-  ColumnSpec spec("Task:X,N:1,Created:24,Completed:24", false);
+  ColumnSpec spec("Task:X,N:1,Id:6,Created:24,Completed:24", false);
   list_ = new HierarchicalList(name, info.height, info.width - notes_width, 0,
                                0, spec);
-  list_->SetDatasource(project_);
+  list_->SetDatasource(&projects_);
 
   if (notes_width) {
     ColumnSpec notes_spec("Notes:X", false);
@@ -258,63 +327,87 @@ void Workspace::AddTask(Task* t) {
                               CursesUtils::winheight() / 3);
   if (text.empty()) return;
 
-  if (t == NULL) {
-    // We add a task to the root level list if no task is selected.
-    project_->AddTaskNamed(text);
-  } else {
-    // Add the task as a subtask of the selected task.
-    t->AddSubTask(new Task(text, ""));
-  }
-  PerformFullListUpdate();
+  // We add a task to the root level list if no task is selected, otherwise
+  // it becomes a subtask of the selected task.
+  RunCommand(new AddTaskCommand(project_, t, text));
 }
 
 void Workspace::DisplayHelp() {
-  InfoBox::ShowFullScreen("Help: key commands in doneyet:", __HELPTEXT__,
-                          CursesUtils::winwidth(), CursesUtils::winheight());
+  size_t index_bytes = 0;
+  for (int i = 0; i < projects_.NumProjects(); ++i) {
+    index_bytes += projects_.ProjectAt(i)->SearchIndexMemoryUsage();
+  }
+  string title = "Help: key commands in doneyet (search indexes use " +
+                 std::to_string(index_bytes / 1024) + " KB):";
+  InfoBox::ShowFullScreen(title, __HELPTEXT__, CursesUtils::winwidth(),
+                          CursesUtils::winheight());
   return;
 }
 
 void Workspace::MoveTask(Task* t) {
-  if (t == NULL || t->Parent() == NULL) return;
+  if (t == NULL) return;
+  // Moving a task only shows while tasks are in their stored order.
+  if (project_->CurrentSortOrder() != SORT_BY_POSITION) {
+    beep();
+    return;
+  }
+  Task* parent = t->Parent();
+  int start_index = t->SiblingIndex();
 
-  // Now we get characters until they hit return.
-  int amount_moved = 0;
+  // Now we get characters until they hit return.  A number typed first moves
+  // the task that many places.
+  int count = 0;
   bool done = false;
   while (!done) {
     int ch = getch();
+    if (ch >= '0' && ch <= '9') {
+      // Compared rather than passed to std::min(), which would need the
+      // constant to have a definition of its own.
+      count = count * 10 + ch - '0';
+      if (count > Constants::kMaxMoveCount) {
+        count = Constants::kMaxMoveCount;
+      }
+      continue;
+    }
+    int places = std::max(count, 1);
+    count = 0;
+
     switch (ch) {
       case KEY_UP:
       case 'k':
       case 'u':
-        t->MoveUp();
-        ++amount_moved;
+        PlaceTask(t, project_->SiblingIndexAfterMoving(t, -places));
         break;
       case KEY_DOWN:
       case 'j':
       case 'd':
-        t->MoveDown();
-        --amount_moved;
+        PlaceTask(t, project_->SiblingIndexAfterMoving(t, places));
+        break;
+      case KEY_HOME:
+      case 'g':
+        PlaceTask(t, 0);
+        break;
+      case KEY_END:
+      case 'G':
+        PlaceTask(t, project_->NumSiblings(t) - 1);
         break;
       case 27:
         // We want to put the task where it started.
-        while (amount_moved > 0) {
-          t->MoveDown();
-          project_->FilterTasks();
-          --amount_moved;
-        }
-        while (amount_moved < 0) {
-          t->MoveUp();
-          project_->FilterTasks();
-          ++amount_moved;
-        }
+        PlaceTask(t, start_index);
         done = true;
         break;
-      case '\r':
+      case '\r': {
+        // Record the move so it can be undone.  The log wants to make the move
+        // itself, so put the task back first.
+        int end_index = t->SiblingIndex();
+        if (end_index != start_index) {
+          PlaceTask(t, start_index);
+          RunCommand(new MoveTaskCommand(project_, t, parent, end_index));
+        }
         done = true;
         break;
+      }
     }
-    project_->FilterTasks();
-    list_->Update();
     list_->Draw();
     doupdate();
   }
@@ -364,7 +457,7 @@ void Workspace::AddNote(Task* t) {
   if (t == NULL) return;
   string note = DialogBox::RunCenteredWithWidth("Add Note", "",
                                                 CursesUtils::winwidth() / 3);
-  if (!note.empty()) t->AddNote(note);
+  if (!note.empty()) RunCommand(new AddNoteCommand(project_, t, note));
 }
 
 void Workspace::ViewNotes(Task* t) {
@@ -377,11 +470,13 @@ void Workspace::ViewNotes(Task* t) {
             "Please Edit Note", selected_note, CursesUtils::winwidth() / 3,
             CursesUtils::winheight() / 3);
         if (answer.empty()) {
-          t->DeleteNote(selected_note);
+          RunCommand(new DeleteNoteCommand(project_, t, selected_note));
         } else if (answer.compare(selected_note) != 0) {
           // note altered
-          t->DeleteNote(selected_note);
-          t->AddNote(answer);
+          CompoundCommand* edit = new CompoundCommand();
+          edit->AddCommand(new DeleteNoteCommand(project_, t, selected_note));
+          edit->AddCommand(new AddNoteCommand(project_, t, answer));
+          RunCommand(edit);
         }
         // else nothing changed
       }
@@ -397,7 +492,7 @@ void Workspace::HandleMenuInput(const string& input) {
   } else if (input == "Open") {
     OpenProject();
   } else if (input == "Save") {
-    SaveCurrentProject();
+    SaveProjects();
   } else if (input == "Quit") {
     Quit();
   } else if (input == "All Tasks") {
@@ -406,16 +501,29 @@ void Workspace::HandleMenuInput(const string& input) {
     ShowTasksCompletedLastWeek();
   } else if (input == "Incomplete Tasks") {
     ShowUnfinishedTasks();
+  } else if (input == "Sort By...") {
+    ChooseSortOrder();
   } else if (input == "Find...") {
     RunFind();
     list_->ScrollToTop();
+  } else if (input == "Query...") {
+    RunQuery();
+  } else if (input == "Save View...") {
+    SaveQueryAsView();
+  } else if (input == "Save As Template") {
+    SaveAsTemplate(ProjectSet::TaskOf(list_->SelectedItem()));
+  } else if (input == "Use Template") {
+    InstantiateTemplate(ProjectSet::TaskOf(list_->SelectedItem()));
   } else if (input == "Plain Text") {
     const char* path = "/tmp/snippet.txt";
     std::ofstream out(path, std::ios::out);
     if (out.fail()) {
       beep();
     } else {
-      out << (*project_);
+      for (int i = 0; i < projects_.NumProjects(); ++i) {
+        out << projects_.ProjectAt(i)->Name() << std::endl;
+        out << *projects_.ProjectAt(i);
+      }
       endwin();
       int ret = system("less /tmp/snippet.txt");
       if (ret != 0) {
@@ -424,84 +532,579 @@ void Workspace::HandleMenuInput(const string& input) {
       list_->Draw();
       doupdate();
     }
+  } else if (views_.count(input)) {
+    ShowView(input);
   }
   list_->ScrollToTop();
 }
 
+// The list follows the search term as it's typed.
 void Workspace::RunFind() {
-  string tmp_str = DialogBox::RunCenteredWithWidth(
-      "Enter Search Term:", "", CursesUtils::winwidth(stdscr) / 3);
-  if (!tmp_str.empty()) {
-    project_->RunSearchFilter(tmp_str);
+  string needle = DialogBox::RunCenteredLive(
+      "Enter Search Term:", CursesUtils::winwidth(stdscr) / 3,
+      std::bind(&Workspace::ShowSearchResults, this, std::placeholders::_1));
+  string error;
+  if (!needle.empty() && needle[0] == '/' &&
+      !RegexMatcher::Compiled(needle.substr(1), &error)) {
+    beep();
+  }
+}
+
+// Shows everything again once the search term is emptied.  A term that starts
+// with "/" is a regular expression, and the list is left alone while it isn't
+// a whole one.
+void Workspace::ShowSearchResults(const string& needle) {
+  shown_query_.clear();
+  if (needle.empty()) {
+    ShowAllTasks();
+  } else if (needle[0] == '/') {
+    string error;
+    shared_ptr<const RegexMatcher> regex =
+        RegexMatcher::Compiled(needle.substr(1), &error);
+    if (!regex) {
+      return;
+    }
+    projects_.ForEachProject(std::bind(&Project::RunRegexFilter,
+                                       std::placeholders::_1, regex),
+                             thread_pool_);
+    list_->Update();
+    list_->ScrollToTop();
+  } else {
+    projects_.ForEachProject(std::bind(&Project::RunSearchFilter,
+                                       std::placeholders::_1, needle),
+                             thread_pool_);
     list_->Update();
     list_->ScrollToTop();
   }
+  list_->Draw();
+}
+
+// Like RunFind(), the list follows the query as it's typed.
+void Workspace::RunQuery() {
+  string query = DialogBox::RunCenteredLive(
+      "Enter Query:", CursesUtils::winwidth(stdscr) / 2,
+      std::bind(&Workspace::ShowQueryResults, this, std::placeholders::_1));
+  string error;
+  FilterPredicate<Task>* parsed =
+      TaskQuery::Parse(query, time(NULL), TaskQuery::Indexes(), &error);
+  if (parsed == NULL && !query.empty()) {
+    beep();
+  }
+  delete parsed;
+}
+
+// The list is left alone while the query isn't a whole one.  Every project is
+// given the same time, so they agree on what "-7d" means.
+void Workspace::ShowQueryResults(const string& query) {
+  if (query.empty()) {
+    ShowAllTasks();
+  } else {
+    time_t now = time(NULL);
+    string error;
+    FilterPredicate<Task>* parsed =
+        TaskQuery::Parse(query, now, TaskQuery::Indexes(), &error);
+    if (parsed == NULL) {
+      return;
+    }
+    delete parsed;
+    projects_.ForEachProject(
+        std::bind(&Project::RunQuery, std::placeholders::_1, query, now),
+        thread_pool_);
+    shown_query_ = query;
+    list_->Update();
+    list_->ScrollToTop();
+  }
+  list_->Draw();
+}
+
+// Every project keeps what passes each view up to date from now on.
+void Workspace::AddView(const string& name, const string& query) {
+  projects_.ForEachProject(
+      std::bind(&Project::AddView, std::placeholders::_1, name, query),
+      thread_pool_);
+  views_[name] = query;
+  view_menu_->AddMenuItem(name);
+}
+
+// Saves the query shown under a name, which is added to the views file for
+// next time.  The file keeps names up to the first "=".
+void Workspace::SaveQueryAsView() {
+  if (shown_query_.empty()) {
+    beep();
+    return;
+  }
+  string name = DialogBox::RunCentered("Save View As:", "");
+  if (name.empty()) {
+    return;
+  }
+  if (views_.count(name) || name.find('=') != string::npos ||
+      name[0] == '#' || name[0] == '[') {
+    beep();
+    return;
+  }
+  FileManager* fm = FileManager::DefaultFileManager();
+  bool exists = fm->FileExists(fm->ViewsFilePath());
+  std::ofstream out(fm->ViewsFilePath().c_str(), std::ios::app);
+  if (out.fail()) {
+    beep();
+    return;
+  }
+  if (!exists) {
+    out << "[VIEWS]" << std::endl;
+  }
+  out << name << " = " << shown_query_ << std::endl;
+  AddView(name, shown_query_);
+}
+
+void Workspace::ShowView(const string& name) {
+  projects_.ForEachProject(
+      std::bind(&Project::ShowView, std::placeholders::_1, name),
+      thread_pool_);
+  shown_query_ = views_[name];
+  list_->Update();
+  list_->ScrollToTop();
+}
+
+// Asks for a task's id or the start of its title, and selects that task.  Ids
+// are looked up in the current project, titles in every project.
+void Workspace::JumpToTask() {
+  string answer = DialogBox::RunCentered("Go To Task (Id Or Title):", "");
+  if (answer.empty()) return;
+
+  vector<Task*> found;
+  if (answer.find_first_not_of("0123456789") == string::npos) {
+    Task* t = project_->TaskWithId(atoi(answer.c_str()));
+    if (t != NULL) {
+      found.push_back(t);
+    }
+  } else {
+    for (int i = 0; i < projects_.NumProjects() &&
+                    found.size() < Constants::kMaxJumpChoices;
+         ++i) {
+      vector<Task*> matches = projects_.ProjectAt(i)->TasksWithTitlePrefix(
+          answer, Constants::kMaxJumpChoices - found.size());
+      found.insert(found.end(), matches.begin(), matches.end());
+    }
+  }
+
+  if (found.empty()) {
+    beep();
+    return;
+  }
+  Task* t = found[0];
+  if (found.size() > 1) {
+    vector<string> choices;
+    for (int i = 0; i < found.size(); ++i) {
+      choices.push_back("#" + std::to_string(found[i]->Id()) + " " +
+                        found[i]->Title() + " [" +
+                        projects_.ProjectOf(found[i])->Name() + "]");
+    }
+    string choice = ListChooser::GetChoice(choices);
+    if (choice.empty()) return;
+    t = found[find(choices.begin(), choices.end(), choice) - choices.begin()];
+  }
+  RevealTask(t);
+}
+
+// Asks for letters a task's path contains in order, and selects whichever of
+// the tasks that fit them best is chosen.
+void Workspace::FuzzyFindTask() {
+  string pattern = DialogBox::RunCentered("Fuzzy Find Task:", "");
+  if (pattern.empty()) return;
+
+  vector<Task*> found = projects_.FindFuzzy(
+      pattern, Constants::kMaxFuzzyFindChoices, thread_pool_);
+  if (found.empty()) {
+    beep();
+    return;
+  }
+  vector<string> choices;
+  for (int i = 0; i < found.size(); ++i) {
+    choices.push_back("#" + std::to_string(found[i]->Id()) + " " +
+                      ProjectSet::TaskPath(found[i]) + " [" +
+                      projects_.ProjectOf(found[i])->Name() + "]");
+  }
+  string choice = ListChooser::GetChoice(choices);
+  if (choice.empty()) return;
+  RevealTask(
+      found[find(choices.begin(), choices.end(), choice) - choices.begin()]);
+}
+
+// Selects t, first showing every task if the current filter hides it and
+// expanding whatever it's collapsed under.
+void Workspace::RevealTask(Task* t) {
+  Project* p = projects_.ProjectOf(t);
+  if (!p->IsShown(t)) {
+    ShowAllTasks();
+  }
+  ListItem* collapsed = NULL;
+  for (ListItem* item = t->ListParent(); item != NULL;
+       item = item->ListParent()) {
+    if (!item->ShouldExpand()) {
+      item->ToggleExpanded();
+      collapsed = item;
+    }
+  }
+  if (collapsed != NULL) {
+    list_->UpdateItem(collapsed);
+  }
+  project_ = p;
+  list_->ScrollToItem(t);
 }
 
 void Workspace::ToggleStatus(Task* t) {
   if (t != NULL && !t->NumChildren()) {
+    TaskStatus status = CREATED;
     switch (t->Status()) {
       case CREATED:
-        t->SetStatus(IN_PROGRESS);
+        status = IN_PROGRESS;
         break;
       case IN_PROGRESS:
-        t->SetStatus(COMPLETED);
+        status = COMPLETED;
         break;
       case COMPLETED:
-        t->SetStatus(PAUSED);
+        status = PAUSED;
         break;
       case PAUSED:
-        t->SetStatus(CREATED);
+        status = CREATED;
         break;
       case NUM_STATUSES:  // Here to appease the compiler.
         break;
     }
-    project_->RecomputeNodeStatus();
+    RunCommand(new SetStatusCommand(project_, t, status));
   }
 }
 
-void Workspace::NewProject() {
-  SaveCurrentProject();
-  Project* p = CreateNewProject();
-  if (p != NULL) {
-    delete project_;
-    project_ = p;
-    list_->SetDatasource(project_);
-    project_->ShowAllTasks();
-    list_->Update();
+void Workspace::ChooseSortOrder() {
+  // In the same order as SortOrder.
+  vector<string> choices;
+  choices.push_back("Stored Order");
+  choices.push_back("Title");
+  choices.push_back("Creation Date");
+  choices.push_back("Completion Date");
+  choices.push_back("Status");
+  string choice = ListChooser::GetChoice(choices);
+  if (choice.empty()) return;
+  SortOrder order = static_cast<SortOrder>(
+      find(choices.begin(), choices.end(), choice) - choices.begin());
+  projects_.ForEachProject(
+      std::bind(&Project::SetSortOrder, std::placeholders::_1, order),
+      thread_pool_);
+  list_->Update();
+}
+
+void Workspace::EditTask(Task* t) {
+  if (t == NULL) return;
+  string answer = DialogBox::RunMultiLine("Please Edit Task", t->Title(),
+                                          CursesUtils::winwidth() / 3,
+                                          CursesUtils::winheight() / 3);
+  if (!answer.empty() && answer != t->Title()) {
+    RunCommand(new SetTextCommand(project_, t, answer));
   }
 }
 
-void Workspace::OpenProject() {
-  SaveCurrentProject();
-  string new_project = ListChooser::GetChoice(fm->SavedProjectNames());
-  if (!new_project.empty()) {
-    delete project_;
-    project_ = Project::NewProjectFromFile(fm->ProjectDir() + new_project);
-    list_->SetDatasource(project_);
-    project_->ShowAllTasks();
-    list_->Update();
+// Moves t to position index among its siblings while it's being moved around,
+// without recording anything for undoing.
+void Workspace::PlaceTask(Task* t, int index) {
+  if (index == t->SiblingIndex()) return;
+  Task* parent;
+  int old_index;
+  vector<Task*> changed;
+  project_->MoveTask(t, t->Parent(), index, &parent, &old_index, &changed);
+  UpdateChangedItems(changed);
+}
+
+// Returns the marked tasks in list order.  Marked project lines are skipped.
+vector<Task*> Workspace::MarkedTasks() {
+  vector<ListItem*> marked = list_->MarkedItems();
+  vector<Task*> tasks;
+  for (int i = 0; i < marked.size(); ++i) {
+    Task* t = ProjectSet::TaskOf(marked[i]);
+    if (t != NULL) {
+      tasks.push_back(t);
+    }
+  }
+  return tasks;
+}
+
+// Returns the marked tasks in list order, leaving out any that are below
+// another marked task since working on that one takes care of them.
+vector<Task*> Workspace::TopMostMarkedTasks() {
+  vector<Task*> marked = MarkedTasks();
+  vector<Task*> tasks;
+  for (int i = 0; i < marked.size(); ++i) {
+    Task* t = marked[i];
+    bool below_marked = false;
+    for (Task* p = t->Parent(); p != NULL && !below_marked; p = p->Parent()) {
+      below_marked = list_->IsMarked(p);
+    }
+    if (!below_marked) {
+      tasks.push_back(t);
+    }
+  }
+  return tasks;
+}
+
+void Workspace::CutTasks(Task* t) {
+  cut_tasks_.clear();
+  if (list_->HasMarks()) {
+    cut_tasks_ = TopMostMarkedTasks();
+    list_->ClearMarks();
+  } else if (t != NULL) {
+    cut_tasks_.push_back(t);
+  }
+}
+
+// Moves the cut tasks and all of their offspring to the end of t's subtasks,
+// or to the end of the current project's root tasks if t is NULL.  Tasks can't
+// be moved between projects, so any cut from another project stay put.
+void Workspace::PasteTasks(Task* t) {
+  BatchCommand* batch = new BatchCommand(project_);
+  int num_children = t == NULL ? project_->NumRootTasks() : t->NumChildren();
+  for (int i = 0; i < cut_tasks_.size(); ++i) {
+    Task* cut = cut_tasks_[i];
+
+    // A task can't be pasted under itself.
+    bool under_itself = false;
+    for (Task* p = t; p != NULL && !under_itself; p = p->Parent()) {
+      under_itself = p == cut;
+    }
+    if (under_itself || projects_.ProjectOf(cut) != project_) continue;
+
+    // The index counts from after the task has been taken out.
+    if (cut->Parent() == t) {
+      --num_children;
+    }
+    batch->AddCommand(new MoveTaskCommand(project_, cut, t, num_children++));
+  }
+  cut_tasks_.clear();
+
+  if (batch->Empty()) {
+    delete batch;
+  } else {
+    RunCommand(batch);
   }
 }
 
-void Workspace::SaveCurrentProject() {
-  // Serialize the current project to its file.
-  if (project_ == NULL) {
+// Puts a copy of t and all of its offspring right after it.
+void Workspace::DuplicateTask(Task* t) {
+  if (t == NULL) return;
+  bool keep_status = ListChooser::GetYesNo(
+      "Should the copies keep the statuses of the originals?", false);
+  RunCommand(new AddTaskCommand(project_, t->Parent(), t->SiblingIndex() + 1,
+                                t->Clone(keep_status)));
+}
+
+// Saves a copy of t and its offspring as a template, so it can be copied into
+// any project later on.  The name is the template's file name, so it can't
+// lead out of the templates directory, and replacing a template is asked
+// about first.
+void Workspace::SaveAsTemplate(Task* t) {
+  if (t == NULL) {
+    beep();
+    return;
+  }
+  string name =
+      DialogBox::RunCentered("Please Enter a Template Name", t->Title());
+  if (name.empty()) return;
+  if (!FileManager::IsPlainFileName(name)) {
+    beep();
+    return;
+  }
+  FileManager* fm = FileManager::DefaultFileManager();
+  vector<string> names = fm->SavedTemplateNames();
+  if (std::find(names.begin(), names.end(), name) != names.end() &&
+      !ListChooser::GetYesNo(
+          "There's a template called " + name + " already.  Replace it?",
+          false)) {
     return;
   }
 
-  string filename =
-      FileManager::DefaultFileManager()->ProjectDir() + project_->Name();
-  Serializer s("", filename);
-  s.SetVersion(NOTES_VERSION);
-  project_->Serialize(&s);
+  Project template_project(name);
+  template_project.AttachTask(t->Clone(false), NULL, 0);
+  Serializer s("", fm->TemplateDir() + name);
+  s.SetVersion(TASK_ID_VERSION);
+  template_project.Serialize(&s);
   s.CloseAll();
 }
 
-void Workspace::PerformFullListUpdate() {
-  project_->RecomputeNodeStatus();
-  project_->FilterTasks();
+// Copies the tasks of a saved template to the end of t's subtasks, or to the
+// end of the root tasks if t is NULL.
+void Workspace::InstantiateTemplate(Task* t) {
+  FileManager* fm = FileManager::DefaultFileManager();
+  string name = ListChooser::GetChoice(fm->SavedTemplateNames());
+  if (name.empty()) return;
+  Project* template_project =
+      Project::NewProjectFromFile(fm->TemplateDir() + name);
+  if (template_project == NULL) {
+    beep();
+    return;
+  }
+
+  BatchCommand* batch = new BatchCommand(project_);
+  int index = t == NULL ? project_->NumRootTasks() : t->NumChildren();
+  for (Task* root = template_project->FirstRootTask(); root != NULL;
+       root = root->NextSibling()) {
+    batch->AddCommand(
+        new AddTaskCommand(project_, t, index++, root->Clone(false)));
+  }
+  delete template_project;
+
+  if (batch->Empty()) {
+    delete batch;
+  } else {
+    RunCommand(batch);
+  }
+}
+
+void Workspace::DeleteMarkedTasks() {
+  vector<Task*> tasks = TopMostMarkedTasks();
+  DoneyetConfig* config = DoneyetConfig::GlobalConfig();
+  if (config->PromptOnDeleteTask() &&
+      !ListChooser::GetYesNo(
+          "Are you sure you want to delete the marked tasks?", false)) {
+    return;
+  }
+
+  BatchCommand* batch = new BatchCommand(project_);
+  for (int i = 0; i < tasks.size(); ++i) {
+    Project* p = projects_.ProjectOf(tasks[i]);
+    batch->AddProject(p);
+    batch->AddCommand(new DeleteTaskCommand(p, tasks[i]));
+  }
+  list_->ClearMarks();
+  list_->SelectNoItem();
+  cut_tasks_.clear();
+  if (batch->Empty()) {
+    delete batch;
+  } else {
+    RunCommand(batch);
+  }
+}
+
+void Workspace::SetStatusOfMarkedTasks() {
+  vector<string> choices;
+  choices.push_back("Unstarted");
+  choices.push_back("Paused");
+  choices.push_back("In Progress");
+  choices.push_back("Completed");
+  string choice = ListChooser::GetChoice(choices);
+  if (choice.empty()) return;
+  TaskStatus status = static_cast<TaskStatus>(
+      find(choices.begin(), choices.end(), choice) - choices.begin());
+
+  // Only tasks without subtasks have a status of their own.
+  vector<Task*> marked = MarkedTasks();
+  BatchCommand* batch = new BatchCommand(project_);
+  for (int i = 0; i < marked.size(); ++i) {
+    Task* t = marked[i];
+    if (!t->NumChildren() && t->Status() != status) {
+      Project* p = projects_.ProjectOf(t);
+      batch->AddProject(p);
+      batch->AddCommand(new SetStatusCommand(p, t, status));
+    }
+  }
+  list_->ClearMarks();
+  if (batch->Empty()) {
+    delete batch;
+  } else {
+    RunCommand(batch);
+  }
+}
+
+void Workspace::AddNoteToMarkedTasks() {
+  string note = DialogBox::RunCenteredWithWidth("Add Note To Marked Tasks", "",
+                                                CursesUtils::winwidth() / 3);
+  if (note.empty()) return;
+
+  vector<Task*> marked = MarkedTasks();
+  BatchCommand* batch = new BatchCommand(project_);
+  for (int i = 0; i < marked.size(); ++i) {
+    Project* p = projects_.ProjectOf(marked[i]);
+    batch->AddProject(p);
+    batch->AddCommand(new AddNoteCommand(p, marked[i], note));
+  }
+  list_->ClearMarks();
+  if (batch->Empty()) {
+    delete batch;
+  } else {
+    RunCommand(batch);
+  }
+}
+
+void Workspace::Undo() {
+  // Cut and marked tasks may be going away.
+  cut_tasks_.clear();
+  list_->ClearMarks();
+  vector<Task*> changed;
+  command_log_->Undo(&changed);
+  UpdateChangedItems(changed);
+}
+
+void Workspace::Redo() {
+  cut_tasks_.clear();
+  list_->ClearMarks();
+  vector<Task*> changed;
+  command_log_->Redo(&changed);
+  UpdateChangedItems(changed);
+}
+
+void Workspace::NewProject() {
+  Project* p = CreateNewProject();
+  if (p == NULL) {
+    return;
+  }
+  if (projects_.FindProject(p->Name()) != NULL) {
+    // It would overwrite the other one's file.
+    beep();
+    delete p;
+    return;
+  }
+  p->SetThreadPool(thread_pool_);
+  p->SetSortOrder(project_->CurrentSortOrder());
+  for (map<string, string>::iterator it = views_.begin(); it != views_.end();
+       ++it) {
+    p->AddView(it->first, it->second);
+  }
+  projects_.AddProject(p);
+  project_ = p;
   list_->Update();
+  list_->ScrollToItem(projects_.ItemForProject(p));
+}
+
+// Every project is already loaded, so opening one just jumps to it.
+void Workspace::OpenProject() {
+  string name = ListChooser::GetChoice(projects_.ProjectNames());
+  Project* p = projects_.FindProject(name);
+  if (p != NULL) {
+    project_ = p;
+    list_->ScrollToItem(projects_.ItemForProject(p));
+  }
+}
+
+void Workspace::SaveProjects() {
+  projects_.SaveProjects(FileManager::DefaultFileManager()->ProjectDir(),
+                         thread_pool_);
+}
+
+// Runs c through the undo log.  Commands keep the project's statuses and filter
+// results up to date themselves, so only the changed lines of the list need
+// updating.
+void Workspace::RunCommand(Command* c) {
+  vector<Task*> changed;
+  command_log_->Execute(c, &changed);
+  UpdateChangedItems(changed);
+}
+
+void Workspace::UpdateChangedItems(const vector<Task*>& changed) {
+  if (find(changed.begin(), changed.end(), static_cast<Task*>(NULL)) !=
+      changed.end()) {
+    list_->Update();
+    return;
+  }
+  for (int i = 0; i < changed.size(); ++i) {
+    list_->UpdateItem(changed[i]);
+  }
 }
 
 void Workspace::DisplayNotes(Task* t) {
@@ -522,16 +1125,25 @@ void Workspace::InitializeMenuBar() {
 
   m = menubar_->AddMenu("View");
   m->AddMenuItem("Find...");
+  m->AddMenuItem("Query...");
+  m->AddMenuItem("Save View...");
   m->AddMenuItem("All Tasks");
   m->AddMenuItem("Completed Tasks");
   m->AddMenuItem("Incomplete Tasks");
+  m->AddMenuItem("Sort By...");
+  // The saved views follow, as they're added.
+  view_menu_ = m;
+
+  m = menubar_->AddMenu("Templates");
+  m->AddMenuItem("Save As Template");
+  m->AddMenuItem("Use Template");
 
   m = menubar_->AddMenu("Generate");
   m->AddMenuItem("Plain Text");
 }
 
 void Workspace::Quit() {
-  SaveCurrentProject();
+  SaveProjects();
   done_ = true;
 }
 
@@ -545,19 +1157,22 @@ Project* Workspace::CreateNewProject() {
 }
 
 void Workspace::ShowAllTasks() {
-  project_->ShowAllTasks();
+  shown_query_.clear();
+  projects_.ForEachProject(&Project::ShowAllTasks, thread_pool_);
   list_->Update();
   list_->ScrollToTop();
 }
 
 void Workspace::ShowTasksCompletedLastWeek() {
-  project_->ShowCompletedLastWeek();
+  shown_query_.clear();
+  projects_.ForEachProject(&Project::ShowCompletedLastWeek, thread_pool_);
   list_->Update();
   list_->ScrollToTop();
 }
 
 void Workspace::ShowUnfinishedTasks() {
-  project_->ArchiveCompletedTasks();
+  shown_query_.clear();
+  projects_.ForEachProject(&Project::ArchiveCompletedTasks, thread_pool_);
   list_->Update();
   list_->ScrollToTop();
 }
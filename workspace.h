@@ -3,17 +3,24 @@
 
 #include <assert.h>
 #include <signal.h>
+#include <map>
 #include <string>
 #include <vector>
 #include "curses-menu.h"
 #include "hierarchical-list.h"
+#include "project-set.h"
 
+using std::map;
 using std::string;
 using std::vector;
 
+class Command;
+class CommandLog;
 class Task;
 class Project;
+class Menu;
 class MenuBar;
+class ThreadPool;
 
 #define __HELPTEXT__                                                         \
   "* A - Apply the Show All Tasks filter.\n"                                 \
@@ -24,24 +31,46 @@ class MenuBar;
   "  * l and h - Change menu.\n"                                             \
   "  * Return - Select the selected menu item.\n"                            \
   "  * Escape - Hide the menu bar.\n"                                        \
-  "* m - Move the currently selected task. Note this doesn't work for root " \
-  "level tasks yet.\n"                                                       \
+  "* m - Move the currently selected task among its siblings.  Only works "  \
+  "while tasks are shown in their stored order.\n"                           \
   "  * k/u/Up Arrow - Move selected task up.\n"                              \
   "  * j/d/Down Arrow - Move selected task down.\n"                          \
+  "  * A number followed by one of the above - Move that many places.\n"     \
+  "  * g/Home and G/End - Move selected task to the top or bottom.\n"        \
   "  * Return - Place task at current position.\n"                           \
   "  * Escape - Place task to where it was originally.\n"                    \
   "* n - Add a note to the selected task.\n"                                 \
+  "* o - Choose the order tasks are shown in, without moving them.\n"        \
   "* v - View the notes of the selected task.\n"                             \
   "* j - Selected next task.\n"                                              \
   "* k - Select previous task.\n"                                            \
-  "* Escape - Select no task.\n"                                             \
+  "* Escape - Select no task and clear the marks.\n"                         \
   "* e - Edit selected task.\n"                                              \
   "* d - Delete selected task.\n"                                            \
   "* c - Toggle collapsed state of selected task.\n"                         \
+  "* t - Mark or unmark the selected task.\n"                                \
+  "* T - Mark every task from the last marked task to the selected one.\n"   \
+  "  Space, d, n and x work on all of the marked tasks at once.\n"           \
+  "* x - Cut the selected task, or the marked tasks.\n"                      \
+  "* D - Duplicate the selected task and all of its subtasks.\n"             \
+  "* p - Paste the cut tasks under the selected task, or at root level if "  \
+  "no task is selected.\n"                                                   \
+  "* u - Undo the last edit.\n"                                              \
+  "* r - Redo the last undone edit.\n"                                       \
   "* R - Apply the Show Uncompleted Tasks filter.\n"                         \
   "* C - Apply the Show Completed Tasks filter.\n"                           \
-  "* f - Apply the Find Tasks filter.\n"                                     \
-  "* S - Save the project.\n"                                                \
+  "* f - Apply the Find Tasks filter, which searches titles, descriptions "  \
+  "and notes as you type.  Start with / to find a regular expression in "   \
+  "titles and descriptions.\n"                                               \
+  "* g - Go to a task by its id (the Id column) in the current project, or " \
+  "by the start of its title in any project.\n"                              \
+  "* F - Go to a task in any project by some of the letters of its title "   \
+  "and its parents' titles, in order, choosing from the best matches.\n"     \
+  "* w - Show the tasks that pass a query, such as status:in_progress "     \
+  "completed>-7d title:\"deploy\" has:notes.  The README has the rest.\n"    \
+  "  'Save View...' in the View menu saves the query shown as a view, "      \
+  "which the View menu then shows straight away.\n"                          \
+  "* S - Save every project.\n"                                              \
   "* Space - Toggle the status of the selected item. White is unstarted, "   \
   "green is in progress, blue is completed and red is paused.\n"             \
   "* h - Shows and closes this help dialog.\n"                               \
@@ -106,22 +135,47 @@ class Workspace {
  private:
   void NewProject();
   void OpenProject();
-  void SaveCurrentProject();
+  void SaveProjects();
 
   void InitializeLists();
 
   // UI Actions
   void AddTask(Task* t);
   void MoveTask(Task* t);
+  void PlaceTask(Task* t, int index);
   void ShowMenuBar(Task* t);
   void AddNote(Task* t);
   void ViewNotes(Task* t);
   void ToggleStatus(Task* t);
+  void EditTask(Task* t);
+  void ChooseSortOrder();
+  void CutTasks(Task* t);
+  void PasteTasks(Task* t);
+  void DuplicateTask(Task* t);
+  void SaveAsTemplate(Task* t);
+  void InstantiateTemplate(Task* t);
+  void DeleteMarkedTasks();
+  void SetStatusOfMarkedTasks();
+  void AddNoteToMarkedTasks();
+  void Undo();
+  void Redo();
 
   // UI Helper Functions
   void HandleMenuInput(const string& input);
   void RunFind();
-  void PerformFullListUpdate();
+  void ShowSearchResults(const string& needle);
+  void RunQuery();
+  void ShowQueryResults(const string& query);
+  void AddView(const string& name, const string& query);
+  void SaveQueryAsView();
+  void ShowView(const string& name);
+  void JumpToTask();
+  void FuzzyFindTask();
+  void RevealTask(Task* t);
+  void RunCommand(Command* c);
+  void UpdateChangedItems(const vector<Task*>& changed);
+  vector<Task*> MarkedTasks();
+  vector<Task*> TopMostMarkedTasks();
   void DisplayNotes(Task* t);
   void DisplayHelp();
 
@@ -138,6 +192,15 @@ class Workspace {
                               void* signal_ucontext);
 
   MenuBar* menubar_;
+  Menu* view_menu_;
+  // Every saved view's query, by name, and the query shown, if any.
+  map<string, string> views_;
+  string shown_query_;
+  CommandLog* command_log_;
+  vector<Task*> cut_tasks_;
+  ThreadPool* thread_pool_;
+  // Every open project, and the one the selected line belongs to.
+  ProjectSet projects_;
   Project* project_;
   HierarchicalList* list_;
   HierarchicalList* notes_list_;